@@ -0,0 +1,214 @@
+/*  -*- C++ -*-
+ * alias_table.h -- sampling from a discrete distribution in constant time
+ * 	using Walker's alias method (with Vose's construction)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+#ifndef ALIAS_TABLE_H
+#define ALIAS_TABLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+
+/* uniform random integer in [0,n) using the top bits of a 64-bit
+ * random number (Lemire's method); this is exact, the rejection step
+ * is only needed with a probability of n / 2^64 */
+template<class RNG>
+static inline uint64_t uniform_index(RNG& rng, uint64_t n) {
+	__uint128_t m = (__uint128_t)rng() * n;
+	uint64_t l = (uint64_t)m;
+	if(l < n) {
+		uint64_t t = (-n) % n;
+		while(l < t) {
+			m = (__uint128_t)rng() * n;
+			l = (uint64_t)m;
+		}
+	}
+	return (uint64_t)(m >> 64);
+}
+
+
+/* alias table for sampling from an arbitrary discrete distribution
+ * 
+ * each bucket is stored as a 32-bit threshold and a 32-bit alias index,
+ * so one draw uses one 64-bit random number and accesses one 8-byte entry:
+ * the bucket is selected by the upper bits of (r * n), the next 32 bits
+ * are compared to the threshold to decide between the bucket and its alias
+ * 
+ * note: RNG is expected to produce uniform 64-bit numbers (e.g. mt19937_64) */
+class alias_table {
+	public:
+		struct entry {
+			uint32_t thr; /* probability of selecting this bucket, scaled to 2^32 */
+			uint32_t alias; /* index to select otherwise */
+		};
+		
+	protected:
+		std::vector<entry> t;
+		const entry* tp; /* table actually used: either t.data() or external memory */
+		size_t n;
+		const static uint64_t file_id = 0x5f3a8c21d4e6b097UL;
+		
+	public:
+		alias_table() : tp(0), n(0) { }
+		template<class it> alias_table(it begin, it end) : tp(0), n(0) { create(begin,end); }
+		alias_table(const alias_table& a) : t(a.t), tp(a.t.size() ? t.data() : a.tp), n(a.n) { }
+		alias_table& operator = (const alias_table& a) {
+			t = a.t;
+			tp = a.t.size() ? t.data() : a.tp;
+			n = a.n;
+			return *this;
+		}
+		
+		size_t size() const { return n; }
+		bool empty() const { return n == 0; }
+		/* memory allocated (zero if external memory is used) */
+		size_t memory_usage() const { return t.capacity() * sizeof(entry); }
+		void clear() { t.clear(); tp = 0; n = 0; }
+		
+		/* access the raw table, e.g. to save it as part of a larger file */
+		const entry* data() const { return tp; }
+		/* use a table stored elsewhere (e.g. in a memory mapped file);
+		 * the memory has to stay valid while this object is used */
+		void attach(const entry* p, size_t n_) { t.clear(); tp = p; n = n_; }
+		
+		/* create the table from the given (non-negative) weights
+		 * returns false if there are no weights or they are all zero */
+		template<class it> bool create(it begin, it end) {
+			std::vector<double> p(begin,end);
+			clear();
+			size_t n = p.size();
+			if(n == 0 || n > UINT32_MAX) return false;
+			double sum = 0.0;
+			size_t last_pos = n;
+			for(size_t i=0;i<n;i++) {
+				sum += p[i];
+				if(p[i] > 0.0) last_pos = i;
+			}
+			if(!(sum > 0.0)) return false;
+			
+			t.resize(n);
+			std::vector<uint32_t> small;
+			std::vector<uint32_t> large;
+			for(size_t i=0;i<n;i++) {
+				p[i] *= n / sum;
+				if(p[i] < 1.0) small.push_back(i);
+				else large.push_back(i);
+			}
+			while(small.size() && large.size()) {
+				uint32_t s = small.back();
+				small.pop_back();
+				uint32_t l = large.back();
+				t[s].thr = to_thr(p[s]);
+				t[s].alias = l;
+				p[l] = (p[l] + p[s]) - 1.0;
+				if(p[l] < 1.0) {
+					large.pop_back();
+					small.push_back(l);
+				}
+			}
+			/* remaining buckets are full (apart from numerical errors);
+			 * make sure that zero weights are never selected though */
+			for(uint32_t l : large) { t[l].thr = UINT32_MAX; t[l].alias = l; }
+			for(uint32_t s : small) {
+				t[s].thr = UINT32_MAX;
+				t[s].alias = s;
+				if(*(begin + s) == 0) { t[s].thr = 0; t[s].alias = last_pos; }
+			}
+			tp = t.data();
+			this->n = n;
+			return true;
+		}
+		
+		/* draw one index according to the weights */
+		template<class RNG> size_t operator () (RNG& rng) const {
+			__uint128_t m = (__uint128_t)rng() * n;
+			size_t i = (size_t)(m >> 64);
+			uint32_t r = (uint32_t)(((uint64_t)m) >> 32);
+			const entry& e = tp[i];
+			return (r < e.thr) ? i : e.alias;
+		}
+		
+		/* save to / load from a binary file; hash is an arbitrary value
+		 * identifying the weights the table was created from and is checked
+		 * when loading (use e.g. weights_hash() below) */
+		bool write(FILE* f, uint64_t hash) const {
+			uint64_t n1 = n;
+			uint64_t id = file_id;
+			if(fwrite(&id,8,1,f) != 1 || fwrite(&n1,8,1,f) != 1 ||
+				fwrite(&hash,8,1,f) != 1) return false;
+			if(n && fwrite(tp,sizeof(entry),n,f) != n) return false;
+			return true;
+		}
+		bool read(FILE* f, uint64_t hash) {
+			uint64_t tmp[3];
+			clear();
+			if(fread(tmp,8,3,f) != 3) return false;
+			if(tmp[0] != file_id || tmp[2] != hash || tmp[1] > UINT32_MAX) return false;
+			t.resize(tmp[1]);
+			if(tmp[1] && fread(t.data(),sizeof(entry),tmp[1],f) != tmp[1]) {
+				t.clear();
+				return false;
+			}
+			tp = t.data();
+			n = tmp[1];
+			return true;
+		}
+		
+		/* hash of a list of weights (FNV-1a over their binary representation) */
+		template<class it> static uint64_t weights_hash(it begin, it end) {
+			uint64_t h = 0xcbf29ce484222325UL;
+			for(;begin != end;++begin) {
+				double x = *begin;
+				const unsigned char* c = (const unsigned char*)&x;
+				for(size_t j=0;j<sizeof(double);j++) {
+					h ^= c[j];
+					h *= 0x100000001b3UL;
+				}
+			}
+			return h;
+		}
+	
+	protected:
+		static uint32_t to_thr(double p) {
+			if(!(p > 0.0)) return 0;
+			double x = p * 4294967296.0;
+			if(x >= 4294967295.0) return UINT32_MAX;
+			return (uint32_t)x;
+		}
+};
+
+#endif /* ALIAS_TABLE_H */
+
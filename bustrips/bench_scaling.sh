@@ -0,0 +1,99 @@
+#!/bin/bash
+
+######################################################################################
+# script to measure how the programs here scale with the size of the input, using
+# synthetic networks, buildings, bus stops and bus trips (created by synthetic_city)
+#
+# usage: bash bench_scaling.sh [results.csv] (in this directory)
+#
+# for each network size and program, one line is added to the results (default:
+# bench_scaling.csv) with the columns: number of nodes, program, number of threads,
+# wall time (seconds), number of items processed, items per second, peak memory
+# (MB, the largest peak RSS reported by the program with -M) and status (ok or
+# failed); items are nodes for synthetic_city, buildings for match_nodes, distances
+# for nodes_distances and dist_matrix, records for extract_trips and trips for
+# the others
+#
+# parameters can be changed with environment variables (defaults in brackets):
+#   SIZES -- number of nodes in the networks to test [10000 30000 100000 300000 1000000]
+#   THREADS -- number of threads to use [number of processors]
+#   WORKDIR -- directory for the generated files [bench_scaling_data]
+#   TRIPS -- number of trips to generate, relative to the number of nodes [0.5]
+#   MAX_MATRIX -- largest network where distances among all buildings are calculated
+#     with nodes_distances and stored in a matrix with dist_matrix [30000]
+#   MAX_ONDEMAND -- largest network where trips are processed by shareability,
+#     min_fleet and fleet_sim (using the distance matrix if it was created, or
+#     calculating the distances on demand) [30000]
+#   GEN_ARGS -- extra parameters for synthetic_city (e.g. "-m grid") []
+######################################################################################
+
+SIZES=${SIZES:-"10000 30000 100000 300000 1000000"}
+THREADS=${THREADS:-$(nproc)}
+WORKDIR=${WORKDIR:-bench_scaling_data}
+TRIPS=${TRIPS:-0.5}
+MAX_MATRIX=${MAX_MATRIX:-30000}
+MAX_ONDEMAND=${MAX_ONDEMAND:-30000}
+out=${1:-bench_scaling.csv}
+
+# 0. compile C++ code used in this script
+for p in syn:synthetic_city mn:match_nodes nd:nodes_distances dm:dist_matrix et:extract_trips st3:sample_trips3 sn:shareability mf:min_fleet fsim:fleet_sim; do
+	g++ -o ${p%%:*} ${p#*:}.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz || exit 1
+done
+
+mkdir -p $WORKDIR
+[ -f $out ] || echo "nodes,program,threads,wall_s,items,items_per_s,peak_rss_mb,status" > $out
+
+# run one program and add a line to the results; parameters: number of nodes,
+# program name, number of items (or a file whose lines are counted after the
+# run, minus the given number of header lines) and the command to run (with
+# its input and output given in the command, stderr is saved in a log file)
+run() {
+	local n=$1 name=$2 items=$3 skip=$4
+	shift 4
+	local log=$WORKDIR/n"$n"_$name.log
+	local start=$(date +%s.%N)
+	bash -c "$*" 2> $log
+	local res=$?
+	local end=$(date +%s.%N)
+	local status=ok
+	[ $res -eq 0 ] || status=failed
+	[ -f "$items" ] && items=$(( $(wc -l < "$items") - skip ))
+	local mem=$(grep -o "peak RSS: [0-9.]* MB" $log | awk '{if($3 > m) m = $3} END {print m+0}')
+	echo "$n $name $THREADS $start $end $items $mem $status" | \
+		awk '{t = $5 - $4; printf "%s,%s,%s,%.3f,%s,%.1f,%s,%s\n", $1, $2, $3, t, $6, (t > 0) ? $6 / t : 0, $7, $8}' | tee -a $out
+}
+
+for n in $SIZES; do
+	d=$WORKDIR/n$n
+	nt=$(awk -v n=$n -v f=$TRIPS 'BEGIN {printf "%d", n * f}')
+	nveh=$(( nt / 20 + 1 ))
+
+	# 1. network, buildings, bus stops and bus trips; buildings are matched to
+	# the network again (giving the same nodes as in the _buildings_nodes.csv file)
+	run $n synthetic_city $n 0 ./syn -n $n -o $d -R -M $GEN_ARGS
+	run $n match_nodes ${d}_buildings.csv 1 ./mn -n ${d}_nodes.dat -i ${d}_buildings.csv -d , -H -c 2,0,1 -C -o ${d}_mn.csv -t $THREADS -M
+
+	# 2. bus trips aggregated from the original format
+	run $n extract_trips ${d}_od_raw.csv 1 ./et -i ${d}_od_raw.csv -s ${d}_busstops.csv -d WEEKDAY -o ${d}_od_et.dat -t $THREADS -M
+
+	# 3. distances among the nodes of the buildings (each node is given as a
+	# point with distance 0) and the distance matrix (only for smaller networks)
+	dargs="--edges ${d}_edges.dat --dist-cache 1024"
+	if [ $n -le $MAX_MATRIX ]; then
+		tail -n +2 ${d}_buildings_nodes.csv | cut -d , -f 2 | sort -u | awk '{print $1"\t"$1"\t0"}' > ${d}_points.dat
+		run $n nodes_distances ${d}_dists.dat 0 "./nd -p ${d}_points.dat -n ${d}_edges.dat -t $THREADS -M | cut -f 1,2,3 > ${d}_dists.dat"
+		run $n dist_matrix ${d}_dists.dat 0 "./dm -i ${d}_dists.dat -o ${d}_dists.bin -t $THREADS -M > ${d}_dists_ids.dat"
+		run $n sample_trips3 $nt 0 ./st3 -N $nt -D 2000 -s 1 -d ${d}_dists.bin -I ${d}_dists_ids.dat -i ${d}_od.dat -b ${d}_buildings_busstops.csv -B ${d}_buildings.csv -n ${d}_buildings_nodes.csv -t $THREADS -M -o ${d}_trips.dat
+		dargs="-d ${d}_dists.bin -I ${d}_dists_ids.dat"
+	fi
+
+	# 4. trips with distances calculated on demand (limited to 2 km)
+	run $n sample_trips3_ondemand $nt 0 ./st3 -N $nt -D 2000 -s 1 -i ${d}_od.dat --edges ${d}_edges.dat --dist-cache 1024 -b ${d}_buildings_busstops.csv -B ${d}_buildings.csv -n ${d}_buildings_nodes.csv -t $THREADS -M -o ${d}_trips2.dat
+
+	# 5. shareability network, minimum fleet size and simulation of the trips
+	if [ $n -le $MAX_ONDEMAND ]; then
+		run $n shareability $nt 0 ./sn -i ${d}_trips2.dat $dargs -v 20 -T 300 -b ${d}_share.bin -t $THREADS -M
+		run $n min_fleet $nt 0 ./mf -i ${d}_trips2.dat $dargs -v 20 -R 900 -t $THREADS -M "> /dev/null"
+		run $n fleet_sim $nt 0 ./fsim -i ${d}_trips2.dat $dargs -n $nveh -v 20 -s 1 -M
+	fi
+done
@@ -0,0 +1,203 @@
+/*
+ * bike_store.cpp -- convert bike trips (bike_trips2_nodes_distances_*.dat)
+ * 	to a columnar binary store, merge multiple files (e.g. days) and
+ * 	extract trips in a time window
+ * 
+ * inputs (-i, can be given multiple times) are either TSV files in the
+ * original format or stores created by this program (detected by their
+ * file ID); each input is sorted by start time (then trip ID) and all of
+ * them are merged into one sorted list (k-way merge)
+ * 
+ * output is either a new store (-b) or text in the original format (-o,
+ * or stdout), optionally with only the columns given by -c; only trips
+ * starting in the time window given by -s and -e are kept
+ * 
+ * if the only input is a store and the output is text, trips are read
+ * directly from the store, only touching the time window and the columns
+ * that are needed (see bike_trips.h for the file format)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include "bike_trips.h"
+#include "write_table.h"
+#include "mem_stats.h"
+
+
+int main(int argc, char **argv)
+{
+	std::vector<const char*> inputs; /* input files (stdin if not given) */
+	const char* fout = 0; /* text output file (stdout if not given) */
+	const char* store_fn = 0; /* binary output */
+	const char* cols_str = 0; /* columns to output in text format */
+	int64_t ts1 = std::numeric_limits<int64_t>::min(); /* time window (start times in [ts1,ts2)) */
+	int64_t ts2 = std::numeric_limits<int64_t>::max();
+	size_t block_size = 1024; /* number of trips in one block of the time index */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use for parsing the input */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'i':
+				inputs.push_back(argv[i+1]);
+				i++;
+				break;
+			case 'o':
+				fout = argv[i+1];
+				i++;
+				break;
+			case 'b':
+				store_fn = argv[i+1];
+				i++;
+				break;
+			case 'c':
+				cols_str = argv[i+1];
+				i++;
+				break;
+			case 's':
+				ts1 = strtoll(argv[i+1],0,10);
+				i++;
+				break;
+			case 'e':
+				ts2 = strtoll(argv[i+1],0,10);
+				i++;
+				break;
+			case 'B':
+				block_size = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	std::vector<unsigned int> cols;
+	for(unsigned int i=0;i<BT_NCOLUMNS;i++) cols.push_back(i);
+	if(cols_str) {
+		if(store_fn) {
+			fprintf(stderr,"Error: -c can only be used with text output!\n");
+			return 1;
+		}
+		if(!bike_trip_parse_columns(cols_str,cols)) {
+			fprintf(stderr,"Error: invalid list of columns: %s!\n",cols_str);
+			return 1;
+		}
+	}
+	if(block_size == 0) {
+		fprintf(stderr,"Error: invalid block size!\n");
+		return 1;
+	}
+	
+	/* text output directly from one store */
+	if(!store_fn && inputs.size() == 1 && bike_trips_store::is_store(inputs[0])) {
+		bike_trips_store st;
+		if(!st.open(inputs[0])) return 1;
+		unsigned int mask = 0;
+		for(unsigned int c : cols) mask |= (1U << c);
+		write_table w(fout,stdout);
+		bool ok = true;
+		st.for_each_time(ts1,ts2,mask,[&w,&cols,&ok](const bike_trip& t) {
+			if(ok) ok = bike_trip_write(w,t,cols);
+		});
+		if(!ok || !w.close()) {
+			fprintf(stderr,"Error writing output!\n");
+			return 1;
+		}
+		stats.add_mapped("trip store",st.mapped_data(),st.mapped_size());
+		stats.report("writing the trips");
+		return 0;
+	}
+	
+	/* read all inputs, sort them separately */
+	std::vector<std::vector<bike_trip> > parts;
+	if(inputs.empty()) inputs.push_back(0);
+	for(const char* fn : inputs) {
+		parts.emplace_back();
+		std::vector<bike_trip>& p = parts.back();
+		if(fn && bike_trips_store::is_store(fn)) {
+			bike_trips_store st;
+			if(!st.open(fn)) return 1;
+			st.read(ts1,ts2,p);
+		}
+		else {
+			if(!read_bike_trips(fn,stdin,nthreads,p)) return 1;
+			p.erase(std::remove_if(p.begin(),p.end(),[ts1,ts2](const bike_trip& t) {
+				return t.start_ts < ts1 || t.start_ts >= ts2; }),p.end());
+			std::sort(p.begin(),p.end());
+		}
+	}
+	stats.add("input trips",parts);
+	stats.report("reading the input");
+	
+	std::vector<bike_trip> trips;
+	if(parts.size() == 1) trips.swap(parts[0]);
+	else merge_bike_trips(parts,trips);
+	parts.clear();
+	fprintf(stderr,"%lu trips\n",trips.size());
+	stats.add("trips",trips);
+	stats.report("merging the trips");
+	
+	if(store_fn) {
+		if(!bike_trips_store::write(store_fn,trips,block_size)) return 1;
+	}
+	else {
+		write_table w(fout,stdout);
+		for(const bike_trip& t : trips) if(!bike_trip_write(w,t,cols)) {
+			fprintf(stderr,"Error writing output!\n");
+			return 1;
+		}
+		if(!w.close()) {
+			fprintf(stderr,"Error writing output!\n");
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
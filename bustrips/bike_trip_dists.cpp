@@ -0,0 +1,296 @@
+/*
+ * bike_trip_dists.cpp -- recalculate the shortest path distance (trip_dist)
+ * 	of bike trips in the network and compare with the existing values
+ * 
+ * inputs (-i, can be given multiple times) are bike trip files, either in
+ * the original TSV format or stores created by bike_store; for each input,
+ * an output file can be given (-o, in the same order), which is written
+ * in the same format and order as the input, with the new distances
+ * 
+ * distances are calculated for all distinct pairs of start and end nodes:
+ * pairs are grouped by the start node, and one search is run from each
+ * start node, which stops when all end nodes in its group are reached
+ * (or at the distance limit given by -D); searches are run in parallel
+ * 
+ * trips where either node is not in the network or the end cannot be
+ * reached keep their original distance (these are counted separately);
+ * for the others, the distribution of the difference between the new and
+ * the original distance is written to stderr (or the file given by -r)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+#include "bike_trips.h"
+
+
+/* write the distribution of the deviations (new - original distance) */
+static void report_deviations(FILE* f, std::vector<double>& dev, size_t ntrips, size_t not_found, double tol) {
+	fprintf(f,"%lu trips, %lu with nodes not in the network or not reached (these are unchanged)\n",ntrips,not_found);
+	if(dev.empty()) return;
+	size_t n = dev.size();
+	size_t shorter = 0, longer = 0;
+	double sum = 0.0, sum_abs = 0.0;
+	for(double& x : dev) {
+		if(x < -tol) shorter++;
+		if(x > tol) longer++;
+		sum += x;
+		x = fabs(x);
+		sum_abs += x;
+	}
+	std::sort(dev.begin(),dev.end());
+	fprintf(f,"deviation of the new distances from the original:\n");
+	fprintf(f,"\tmean: %f m, mean absolute: %f m\n",sum / n,sum_abs / n);
+	fprintf(f,"\tshorter: %lu, longer: %lu, same (within %g m): %lu\n",shorter,longer,tol,n - shorter - longer);
+	fprintf(f,"\tquantiles of the absolute deviation:\n");
+	const double qs[] = {0.5, 0.9, 0.99, 0.999, 1.0};
+	for(double q : qs) {
+		size_t i = (size_t)ceil(q*n);
+		if(i > 0) i--;
+		fprintf(f,"\t\t%6.1f%% %14.6f m\n",100.0*q,dev[i]);
+	}
+	fprintf(f,"\tnumber of trips by absolute deviation:\n");
+	double lim = tol;
+	size_t i = 0;
+	for(;i<n && lim <= 1e6;lim *= 10.0) {
+		size_t j = std::upper_bound(dev.begin() + i,dev.end(),lim) - dev.begin();
+		fprintf(f,"\t\t<= %-12g %10lu\n",lim,j - i);
+		i = j;
+	}
+	if(i < n) fprintf(f,"\t\t>  %-12g %10lu\n",lim / 10.0,n - i);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char* network_fn = 0; /* network (with distances for each edge; symmetrized when reading) */
+	std::vector<const char*> inputs; /* bike trip files */
+	std::vector<const char*> outputs; /* updated files (optional, for the inputs in the same order) */
+	const char* report_fn = 0; /* report of the deviations (default: stderr) */
+	double max_dist = 0.0; /* if > 0, searches stop at this distance */
+	double tol = 0.001; /* deviations below this are counted as the same */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'n':
+				network_fn = argv[i+1];
+				i++;
+				break;
+			case 'i':
+				inputs.push_back(argv[i+1]);
+				i++;
+				break;
+			case 'o':
+				outputs.push_back(argv[i+1]);
+				i++;
+				break;
+			case 'r':
+				report_fn = argv[i+1];
+				i++;
+				break;
+			case 'D':
+				max_dist = atof(argv[i+1]);
+				i++;
+				break;
+			case 'e':
+				tol = atof(argv[i+1]);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!network_fn) {
+		fprintf(stderr,"Error: no network given!\n");
+		return 1;
+	}
+	if(inputs.empty()) {
+		fprintf(stderr,"Error: no input files given!\n");
+		return 1;
+	}
+	if(outputs.size() > inputs.size()) {
+		fprintf(stderr,"Error: more output files than inputs given!\n");
+		return 1;
+	}
+	if(nthreads == 0) nthreads = 1;
+	
+	/* read the network */
+	network net;
+	if(!net.read_edges(network_fn,0,nthreads)) return 1;
+	net.freeze();
+	stats.add("network",net);
+	stats.report("reading the network");
+	
+	/* read the trips */
+	std::vector<std::vector<bike_trip> > trips(inputs.size());
+	std::vector<char> is_store(inputs.size(),0);
+	size_t ntrips = 0;
+	for(size_t i=0;i<inputs.size();i++) {
+		if(bike_trips_store::is_store(inputs[i])) {
+			bike_trips_store st;
+			if(!st.open(inputs[i])) return 1;
+			st.read(trips[i]);
+			is_store[i] = 1;
+		}
+		else if(!read_bike_trips(inputs[i],0,nthreads,trips[i])) return 1;
+		ntrips += trips[i].size();
+	}
+	stats.add("trips",trips);
+	stats.report("reading the trips");
+	
+	/* distinct pairs of nodes, grouped by the start node (sorted) */
+	std::vector<std::pair<uint64_t,uint64_t> > pairs;
+	pairs.reserve(ntrips);
+	for(const auto& v : trips) for(const bike_trip& t : v)
+		if(net.has_node(t.start_node) && net.has_node(t.end_node))
+			pairs.push_back(std::make_pair(t.start_node,t.end_node));
+	std::sort(pairs.begin(),pairs.end());
+	pairs.erase(std::unique(pairs.begin(),pairs.end()),pairs.end());
+	std::vector<size_t> groups; /* start of each group in pairs */
+	for(size_t i=0;i<pairs.size();i++) if(i == 0 || pairs[i].first != pairs[i-1].first) groups.push_back(i);
+	size_t nsources = groups.size();
+	groups.push_back(pairs.size());
+	fprintf(stderr,"%lu trips, %lu distinct pairs of nodes, %lu start nodes\n",ntrips,pairs.size(),nsources);
+	
+	/* one search from each start node (in parallel) */
+	std::vector<double> dists(pairs.size(),NAN);
+	std::atomic<size_t> next(0);
+	std::atomic<bool> error(false);
+	std::vector<network_search_state> states(nthreads);
+	auto worker = [&](unsigned int j) {
+		network_search_state& s = states[j];
+		while(!error) {
+			size_t g = next++;
+			if(g >= nsources) break;
+			const auto* first = pairs.data() + groups[g];
+			const auto* last = pairs.data() + groups[g+1];
+			size_t need = last - first;
+			size_t found = 0;
+			bool ok = net.search(first->first,s,[&](uint64_t current, double d, double) {
+				if(max_dist > 0.0 && d > max_dist) return false;
+				const auto* it = std::lower_bound(first,last,std::make_pair(first->first,current));
+				if(it != last && it->second == current) {
+					dists[it - pairs.data()] = d;
+					found++;
+				}
+				return found < need;
+			});
+			if(!ok) error = true;
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int j=1;j<nthreads && j<nsources;j++) threads.emplace_back(worker,j);
+	worker(0);
+	for(auto& t : threads) t.join();
+	if(error) return 1;
+	stats.add("network",net);
+	stats.add("node pairs",pairs);
+	stats.add("search states",states);
+	stats.report("the searches");
+	states.clear();
+	
+	/* update the trips */
+	std::vector<double> dev;
+	dev.reserve(ntrips);
+	size_t not_found = 0;
+	for(auto& v : trips) for(bike_trip& t : v) {
+		auto it = std::lower_bound(pairs.begin(),pairs.end(),std::make_pair(t.start_node,t.end_node));
+		double d = NAN;
+		if(it != pairs.end() && it->first == t.start_node && it->second == t.end_node) d = dists[it - pairs.begin()];
+		if(std::isnan(d)) not_found++;
+		else {
+			dev.push_back(d - t.trip_dist);
+			t.trip_dist = d;
+		}
+	}
+	
+	/* write the results */
+	for(size_t i=0;i<outputs.size();i++) {
+		if(is_store[i]) {
+			if(!bike_trips_store::write(outputs[i],trips[i])) return 1;
+			continue;
+		}
+		std::vector<unsigned int> cols;
+		for(unsigned int c=0;c<BT_NCOLUMNS;c++) cols.push_back(c);
+		write_table w(outputs[i]);
+		bool ok = true;
+		for(const bike_trip& t : trips[i]) if(!bike_trip_write(w,t,cols)) {
+			ok = false;
+			break;
+		}
+		if(!w.close() || !ok) {
+			fprintf(stderr,"Error writing output file %s!\n",outputs[i]);
+			return 1;
+		}
+	}
+	
+	FILE* fr = stderr;
+	if(report_fn) {
+		fr = fopen(report_fn,"w");
+		if(!fr) {
+			fprintf(stderr,"Error opening file %s!\n",report_fn);
+			return 1;
+		}
+	}
+	report_deviations(fr,dev,ntrips,not_found,tol);
+	if(report_fn && fclose(fr)) {
+		fprintf(stderr,"Error writing file %s!\n",report_fn);
+		return 1;
+	}
+	return 0;
+}
+
@@ -0,0 +1,564 @@
+/*  -*- C++ -*-
+ * bike_trips.h -- bike trips matched to the OSM network (the files
+ * 	bike_trips2_nodes_distances_2017091?.dat), read from the original TSV
+ * 	format or from a compact columnar binary store
+ * 
+ * the binary store contains the trips sorted by their start time, with
+ * each column in a separate array:
+ * 	- start timestamps are delta-encoded (varints, relative to the
+ * 	previous trip), end timestamps are stored as the trip duration
+ * 	(zigzag varints); both are split into blocks of a fixed number of
+ * 	trips, with a sparse index giving the first start time and the offset
+ * 	of each block, so a time window can be found with a binary search
+ * 	- node IDs are replaced by indices into a sorted dictionary (32-bit)
+ * 	- trip and bike IDs are stored as 32-bit integers
+ * 	- distances are stored as doubles, so the text output is exactly the
+ * 	same as the original
+ * the file is memory mapped without readahead, so a query only reads the
+ * parts of the columns that it actually uses
+ * 
+ * multiple files (e.g. several days) are merged into one store with a
+ * k-way merge of the individually sorted inputs
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef BIKE_TRIPS_H
+#define BIKE_TRIPS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+#include "write_table.h"
+
+
+/* one trip, with the columns of the original files */
+struct bike_trip {
+	uint64_t trip_id;
+	uint64_t bike_id;
+	int64_t start_ts;
+	int64_t end_ts;
+	uint64_t start_node;
+	double start_dist; /* distance of the start point from start_node */
+	uint64_t end_node;
+	double end_dist; /* distance of the end point from end_node */
+	double trip_dist; /* shortest path distance between start_node and end_node */
+	
+	/* order used in the store: by start time, then trip ID */
+	bool operator < (const bike_trip& t) const {
+		return start_ts < t.start_ts || (start_ts == t.start_ts && trip_id < t.trip_id);
+	}
+};
+
+/* columns (in the order of the original files) */
+enum bike_trip_column { BT_TRIP_ID = 0, BT_BIKE_ID, BT_START_TS, BT_END_TS, BT_START_NODE,
+	BT_START_DIST, BT_END_NODE, BT_END_DIST, BT_TRIP_DIST, BT_NCOLUMNS };
+static const char* const bike_trip_column_names[BT_NCOLUMNS] = { "trip_id", "bike_id",
+	"start_ts", "end_ts", "start_node", "start_dist", "end_node", "end_dist", "trip_dist" };
+static const unsigned int bike_trip_all_columns = (1U << BT_NCOLUMNS) - 1U;
+
+/* parse a comma-separated list of column names; returns false if a name
+ * is not known */
+static inline bool bike_trip_parse_columns(const char* str, std::vector<unsigned int>& cols) {
+	cols.clear();
+	while(*str) {
+		const char* end = strchr(str,',');
+		size_t len = end ? (size_t)(end - str) : strlen(str);
+		unsigned int i = 0;
+		for(;i<BT_NCOLUMNS;i++)
+			if(strlen(bike_trip_column_names[i]) == len && !strncmp(str,bike_trip_column_names[i],len)) break;
+		if(i == BT_NCOLUMNS) return false;
+		cols.push_back(i);
+		str += len;
+		if(*str) str++;
+	}
+	return cols.size() > 0;
+}
+
+/* format x at p in buf (of the given size), first writing out the
+ * contents of buf to w if there is not enough space for it */
+template<class T>
+static inline bool bike_trip_write_field(write_table& w, char* buf, size_t size, char*& p, const T& x) {
+	if((size_t)(p - buf) + write_table_max_len(x) + 2 > size) {
+		if(!w.write_data(buf,p - buf)) return false;
+		p = buf;
+	}
+	p = write_table_format(p,x);
+	return true;
+}
+
+/* write the given columns of t as one line of text (same format as the
+ * original files if all columns are given in order) */
+static inline bool bike_trip_write(write_table& w, const bike_trip& t, const std::vector<unsigned int>& cols) {
+	char buf[BT_NCOLUMNS*32 + 320]; /* rows longer than this (only with huge distances) are written in parts */
+	char* p = buf;
+	bool ok = true;
+	for(size_t i=0;i<cols.size() && ok;i++) {
+		if(i) *(p++) = '\t';
+		switch(cols[i]) {
+			case BT_TRIP_ID: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.trip_id); break;
+			case BT_BIKE_ID: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.bike_id); break;
+			case BT_START_TS: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.start_ts); break;
+			case BT_END_TS: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.end_ts); break;
+			case BT_START_NODE: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.start_node); break;
+			case BT_START_DIST: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.start_dist); break;
+			case BT_END_NODE: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.end_node); break;
+			case BT_END_DIST: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.end_dist); break;
+			case BT_TRIP_DIST: ok = bike_trip_write_field(w,buf,sizeof(buf),p,t.trip_dist); break;
+		}
+	}
+	if(!ok) return false;
+	*(p++) = '\n';
+	return w.write_data(buf,p - buf);
+}
+
+
+/* read trips from a TSV file (or f if fn == 0), parsing it in parallel
+ * with nthreads; trips are appended to out in the order of the file */
+static inline bool read_bike_trips(const char* fn, FILE* f, unsigned int nthreads, std::vector<bike_trip>& out) {
+	typedef read_table_schema<uint64_t,uint64_t,int64_t,int64_t,uint64_t,double,uint64_t,double,double> schema;
+	read_table_parallel rt(fn,f,nthreads);
+	rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
+	std::vector<schema> parts;
+	if(!rt.read_all_rows(parts)) {
+		fprintf(stderr,"Error reading bike trips:\n");
+		rt.write_error(stderr);
+		return false;
+	}
+	size_t n = out.size();
+	for(const auto& p : parts) n += p.size();
+	out.reserve(n);
+	for(auto& p : parts) {
+		for(size_t i=0;i<p.size();i++) out.push_back(bike_trip{p.col<0>()[i], p.col<1>()[i],
+			p.col<2>()[i], p.col<3>()[i], p.col<4>()[i], p.col<5>()[i], p.col<6>()[i],
+			p.col<7>()[i], p.col<8>()[i]});
+		p = schema();
+	}
+	return true;
+}
+
+/* merge the sorted lists of trips in parts into out (k-way merge) */
+static inline void merge_bike_trips(const std::vector<std::vector<bike_trip> >& parts, std::vector<bike_trip>& out) {
+	size_t n = 0;
+	for(const auto& p : parts) n += p.size();
+	out.clear();
+	out.reserve(n);
+	/* heap of the next trip from each part (smallest on top) */
+	typedef std::pair<const bike_trip*, size_t> item;
+	auto cmp = [](const item& a, const item& b) { return *b.first < *a.first; };
+	std::priority_queue<item, std::vector<item>, decltype(cmp)> q(cmp);
+	std::vector<size_t> pos(parts.size(),0);
+	for(size_t i=0;i<parts.size();i++) if(parts[i].size()) q.push(item(parts[i].data(),i));
+	while(!q.empty()) {
+		size_t i = q.top().second;
+		q.pop();
+		out.push_back(parts[i][pos[i]]);
+		pos[i]++;
+		if(pos[i] < parts[i].size()) q.push(item(parts[i].data() + pos[i],i));
+	}
+}
+
+
+/* varint encoding used in the store (LEB128) */
+static inline void bike_trips_put_varint(std::vector<uint8_t>& out, uint64_t x) {
+	while(x >= 0x80) {
+		out.push_back((uint8_t)(x | 0x80));
+		x >>= 7;
+	}
+	out.push_back((uint8_t)x);
+}
+/* decoding stops at end (so that a corrupted file is not read past the
+ * end of its section) and after 10 bytes (the longest 64-bit value) */
+static inline uint64_t bike_trips_get_varint(const uint8_t*& p, const uint8_t* end) {
+	uint64_t x = 0;
+	for(unsigned int s = 0;p < end && s < 64;s += 7) {
+		uint8_t c = *(p++);
+		x |= ((uint64_t)(c & 0x7f)) << s;
+		if(!(c & 0x80)) return x;
+	}
+	return x;
+}
+static inline uint64_t bike_trips_zigzag(int64_t x) { return (((uint64_t)x) << 1) ^ (uint64_t)(x >> 63); }
+static inline int64_t bike_trips_unzigzag(uint64_t x) { return (int64_t)(x >> 1) ^ -(int64_t)(x & 1); }
+
+
+/* columnar store of bike trips, memory mapped from a file */
+class bike_trips_store {
+	public:
+		const static uint64_t file_id = 0x3b8e51f2c64a9d07UL;
+		
+		/* sections of the file (each starts at a multiple of 8 bytes) */
+		enum { S_NODES = 0, S_INDEX, S_START_TS, S_DURATION, S_TRIP_ID, S_BIKE_ID,
+			S_START_NODE, S_END_NODE, S_START_DIST, S_END_DIST, S_TRIP_DIST, S_N };
+		
+		struct header {
+			uint64_t file_id;
+			uint64_t ntrips;
+			uint64_t nnodes;
+			uint64_t block_size; /* number of trips in one block of the index */
+			uint64_t nblocks;
+			uint64_t offsets[S_N+1]; /* start of the sections, the last is the file size */
+		};
+		/* one entry in the sparse time index */
+		struct block {
+			int64_t start_ts; /* start time of the first trip in the block */
+			uint64_t ts_offset; /* offset of the block in the start time section */
+			uint64_t duration_offset; /* offset of the block in the duration section */
+		};
+	
+	protected:
+		void* map;
+		size_t map_size;
+		const header* h;
+		const uint64_t* nodes;
+		const block* index;
+		const uint8_t* start_ts;
+		const uint8_t* start_ts_end;
+		const uint8_t* duration;
+		const uint8_t* duration_end;
+		const uint32_t* trip_ids;
+		const uint32_t* bike_ids;
+		const uint32_t* start_nodes;
+		const uint32_t* end_nodes;
+		const double* start_dists;
+		const double* end_dists;
+		const double* trip_dists;
+		
+		template<class T> const T* section(unsigned int s) const {
+			return (const T*)(((const char*)map) + h->offsets[s]);
+		}
+		
+		/* write one column of the trips, converted to T by f */
+		template<class T, class F>
+		static bool write_column(write_table& w, size_t& pos, const std::vector<bike_trip>& trips, F f) {
+			for(const bike_trip& t : trips) {
+				T x = f(t);
+				if(!w.write_data(&x,sizeof(T))) return false;
+			}
+			pos += trips.size()*sizeof(T);
+			return true;
+		}
+		
+		/* check that section s has room for n elements of size sz
+		 * (note: n is from the file, so n*sz could overflow) */
+		bool check_section(unsigned int s, uint64_t n, size_t sz) const {
+			return h->offsets[s] <= h->offsets[s+1] && n <= (h->offsets[s+1] - h->offsets[s]) / sz;
+		}
+		uint64_t section_size(unsigned int s) const { return h->offsets[s+1] - h->offsets[s]; }
+		
+		/* check the contents of the index and the node columns (called after
+		 * the sections were checked): index offsets have to be non-decreasing
+		 * and inside their section, nodes have to be in the dictionary */
+		bool check_contents() const {
+			const block* idx = section<block>(S_INDEX);
+			for(uint64_t b=0;b<h->nblocks;b++) {
+				if(idx[b].ts_offset >= section_size(S_START_TS) ||
+					idx[b].duration_offset >= section_size(S_DURATION)) return false;
+				if(b && (idx[b].ts_offset < idx[b-1].ts_offset ||
+					idx[b].duration_offset < idx[b-1].duration_offset)) return false;
+			}
+			const uint32_t* n1 = section<uint32_t>(S_START_NODE);
+			const uint32_t* n2 = section<uint32_t>(S_END_NODE);
+			for(uint64_t i=0;i<h->ntrips;i++)
+				if(n1[i] >= h->nnodes || n2[i] >= h->nnodes) return false;
+			return true;
+		}
+		
+	public:
+		bike_trips_store() : map(MAP_FAILED), map_size(0), h(0) { }
+		~bike_trips_store() { clear(); }
+		bike_trips_store(const bike_trips_store&) = delete;
+		bike_trips_store& operator = (const bike_trips_store&) = delete;
+		
+		void clear() {
+			if(map != MAP_FAILED) munmap(map,map_size);
+			map = MAP_FAILED;
+			map_size = 0;
+			h = 0;
+		}
+		
+		/* check if fn is a store (i.e. starts with the right file ID); only
+		 * regular files are checked, since reading the start of a pipe would
+		 * consume it (a store cannot be read from a pipe anyway) */
+		static bool is_store(const char* fn) {
+			FILE* f = fopen(fn,"r");
+			if(!f) return false;
+			struct stat st;
+			if(fstat(fileno(f),&st) || !S_ISREG(st.st_mode)) {
+				fclose(f);
+				return false;
+			}
+			uint64_t id = 0;
+			bool ret = (fread(&id,8,1,f) == 1 && id == file_id);
+			fclose(f);
+			return ret;
+		}
+		
+		bool open(const char* fn) {
+			clear();
+			int f = ::open(fn,O_RDONLY | O_CLOEXEC);
+			if(f == -1) {
+				fprintf(stderr,"bike_trips_store::open(): Error opening file %s!\n",fn);
+				return false;
+			}
+			struct stat st;
+			if(fstat(f,&st)) {
+				fprintf(stderr,"bike_trips_store::open(): Error with stat() on file %s!\n",fn);
+				close(f);
+				return false;
+			}
+			map_size = st.st_size;
+			if(map_size < sizeof(header)) {
+				fprintf(stderr,"bike_trips_store::open(): file %s is too short!\n",fn);
+				close(f);
+				return false;
+			}
+			map = mmap(0,map_size,PROT_READ,MAP_SHARED,f,0);
+			close(f);
+			if(map == MAP_FAILED) {
+				fprintf(stderr,"bike_trips_store::open(): error with mmap()!\n");
+				return false;
+			}
+			/* only the parts actually used should be read */
+			madvise(map,map_size,MADV_RANDOM);
+			
+			h = (const header*)map;
+			if(h->file_id != file_id) {
+				fprintf(stderr,"bike_trips_store::open(): unexpected file ID!\n");
+				clear();
+				return false;
+			}
+			uint64_t n = h->ntrips;
+			bool ok = h->offsets[S_N] == map_size && h->block_size > 0 &&
+				h->nblocks == n / h->block_size + (n % h->block_size ? 1 : 0) &&
+				h->nnodes <= (uint64_t)UINT32_MAX + 1 && h->offsets[0] >= sizeof(header);
+			for(unsigned int s=0;ok && s<S_N;s++) ok = (h->offsets[s] % 8 == 0) && h->offsets[s] <= h->offsets[s+1];
+			ok = ok && check_section(S_NODES,h->nnodes,sizeof(uint64_t)) &&
+				check_section(S_INDEX,h->nblocks,sizeof(block)) &&
+				check_section(S_START_TS,n,1) && check_section(S_DURATION,n,1) &&
+				check_section(S_TRIP_ID,n,sizeof(uint32_t)) && check_section(S_BIKE_ID,n,sizeof(uint32_t)) &&
+				check_section(S_START_NODE,n,sizeof(uint32_t)) && check_section(S_END_NODE,n,sizeof(uint32_t)) &&
+				check_section(S_START_DIST,n,sizeof(double)) && check_section(S_END_DIST,n,sizeof(double)) &&
+				check_section(S_TRIP_DIST,n,sizeof(double)) && check_contents();
+			if(!ok) {
+				fprintf(stderr,"bike_trips_store::open(): invalid file structure!\n");
+				clear();
+				return false;
+			}
+			
+			nodes = section<uint64_t>(S_NODES);
+			index = section<block>(S_INDEX);
+			start_ts = section<uint8_t>(S_START_TS);
+			start_ts_end = start_ts + section_size(S_START_TS);
+			duration = section<uint8_t>(S_DURATION);
+			duration_end = duration + section_size(S_DURATION);
+			trip_ids = section<uint32_t>(S_TRIP_ID);
+			bike_ids = section<uint32_t>(S_BIKE_ID);
+			start_nodes = section<uint32_t>(S_START_NODE);
+			end_nodes = section<uint32_t>(S_END_NODE);
+			start_dists = section<double>(S_START_DIST);
+			end_dists = section<double>(S_END_DIST);
+			trip_dists = section<double>(S_TRIP_DIST);
+			return true;
+		}
+		
+		size_t size() const { return h ? h->ntrips : 0; }
+		size_t nnodes() const { return h ? h->nnodes : 0; }
+		/* all node IDs that appear in the trips (sorted) */
+		const uint64_t* node_ids() const { return nodes; }
+		size_t mapped_size() const { return (map != MAP_FAILED) ? map_size : 0; }
+		const void* mapped_data() const { return (map != MAP_FAILED) ? map : 0; }
+		
+		/* index of the first trip that starts at or after ts */
+		size_t lower_bound(int64_t ts) const {
+			if(!size()) return 0;
+			size_t b = std::lower_bound(index,index + h->nblocks,ts,
+				[](const block& x, int64_t t) { return x.start_ts < t; }) - index;
+			if(b == 0) return 0;
+			/* the answer is in the previous block, or it is the start of block b */
+			b--;
+			size_t i = b*h->block_size;
+			size_t end = std::min(i + h->block_size,size());
+			const uint8_t* p = start_ts + index[b].ts_offset;
+			int64_t t = index[b].start_ts;
+			for(;i<end;i++) {
+				t += bike_trips_get_varint(p,start_ts_end);
+				if(t >= ts) break;
+			}
+			return i;
+		}
+		
+		/* call f(const bike_trip& t) for the trips with indices in [i1,i2);
+		 * only the columns in the bitmask cols (1U << BT_...) are filled in
+		 * (others are left as zero), so the rest of the file is not read */
+		template<class F> void for_each(size_t i1, size_t i2, unsigned int cols, F&& f) const {
+			if(i2 > size()) i2 = size();
+			if(i1 >= i2) return;
+			bool need_ts = (cols & ((1U << BT_START_TS) | (1U << BT_END_TS)));
+			bool need_duration = (cols & (1U << BT_END_TS));
+			/* timestamps are decoded from the start of the block */
+			size_t b = i1 / h->block_size;
+			size_t i = b*h->block_size;
+			const uint8_t* p = start_ts + index[b].ts_offset;
+			const uint8_t* pd = duration + index[b].duration_offset;
+			bike_trip t{0,0,index[b].start_ts,0,0,0.0,0,0.0,0.0};
+			if(need_ts) for(;i<i1;i++) {
+				t.start_ts += bike_trips_get_varint(p,start_ts_end);
+				if(need_duration) bike_trips_get_varint(pd,duration_end);
+			}
+			for(i=i1;i<i2;i++) {
+				if(need_ts) {
+					if(i % h->block_size == 0) t.start_ts = index[i / h->block_size].start_ts; /* deltas restart in each block */
+					t.start_ts += bike_trips_get_varint(p,start_ts_end);
+					/* note: added as unsigned, a corrupted duration should not overflow */
+					if(need_duration) t.end_ts = (int64_t)((uint64_t)t.start_ts +
+						(uint64_t)bike_trips_unzigzag(bike_trips_get_varint(pd,duration_end)));
+				}
+				if(cols & (1U << BT_TRIP_ID)) t.trip_id = trip_ids[i];
+				if(cols & (1U << BT_BIKE_ID)) t.bike_id = bike_ids[i];
+				if(cols & (1U << BT_START_NODE)) t.start_node = nodes[start_nodes[i]];
+				if(cols & (1U << BT_START_DIST)) t.start_dist = start_dists[i];
+				if(cols & (1U << BT_END_NODE)) t.end_node = nodes[end_nodes[i]];
+				if(cols & (1U << BT_END_DIST)) t.end_dist = end_dists[i];
+				if(cols & (1U << BT_TRIP_DIST)) t.trip_dist = trip_dists[i];
+				f(t);
+			}
+		}
+		/* the same for trips starting in [ts1,ts2) */
+		template<class F> void for_each_time(int64_t ts1, int64_t ts2, unsigned int cols, F&& f) const {
+			if(ts2 <= ts1) return;
+			for_each(lower_bound(ts1),lower_bound(ts2),cols,f);
+		}
+		
+		/* append trips starting in [ts1,ts2) to out (all columns) */
+		void read(int64_t ts1, int64_t ts2, std::vector<bike_trip>& out) const {
+			size_t i1 = lower_bound(ts1);
+			size_t i2 = lower_bound(ts2);
+			if(i2 > i1) out.reserve(out.size() + (i2 - i1));
+			for_each(i1,i2,bike_trip_all_columns,[&out](const bike_trip& t) { out.push_back(t); });
+		}
+		void read(std::vector<bike_trip>& out) const {
+			out.reserve(out.size() + size());
+			for_each(0,size(),bike_trip_all_columns,[&out](const bike_trip& t) { out.push_back(t); });
+		}
+		
+		
+		/* write trips (which have to be sorted) to a new store in the file fn */
+		static bool write(const char* fn, const std::vector<bike_trip>& trips, size_t block_size = 1024) {
+			size_t n = trips.size();
+			if(!std::is_sorted(trips.begin(),trips.end())) {
+				fprintf(stderr,"bike_trips_store::write(): trips are not sorted!\n");
+				return false;
+			}
+			for(const bike_trip& t : trips) if(t.trip_id > UINT32_MAX || t.bike_id > UINT32_MAX) {
+				fprintf(stderr,"bike_trips_store::write(): trip or bike ID too large (%lu, %lu)!\n",t.trip_id,t.bike_id);
+				return false;
+			}
+			
+			/* dictionary of nodes */
+			std::vector<uint64_t> node_ids;
+			node_ids.reserve(2*n);
+			for(const bike_trip& t : trips) {
+				node_ids.push_back(t.start_node);
+				node_ids.push_back(t.end_node);
+			}
+			std::sort(node_ids.begin(),node_ids.end());
+			node_ids.erase(std::unique(node_ids.begin(),node_ids.end()),node_ids.end());
+			if(node_ids.size() > UINT32_MAX) {
+				fprintf(stderr,"bike_trips_store::write(): too many nodes!\n");
+				return false;
+			}
+			auto node_idx = [&node_ids](uint64_t x) {
+				return (uint32_t)(std::lower_bound(node_ids.begin(),node_ids.end(),x) - node_ids.begin());
+			};
+			
+			/* timestamps and the index */
+			std::vector<block> idx;
+			std::vector<uint8_t> ts, dur;
+			for(size_t i=0;i<n;i++) {
+				const bike_trip& t = trips[i];
+				if(i % block_size == 0) idx.push_back(block{t.start_ts,ts.size(),dur.size()});
+				bike_trips_put_varint(ts,(uint64_t)(t.start_ts - (i % block_size ? trips[i-1].start_ts : t.start_ts)));
+				bike_trips_put_varint(dur,bike_trips_zigzag(t.end_ts - t.start_ts));
+			}
+			
+			header hd;
+			hd.file_id = file_id;
+			hd.ntrips = n;
+			hd.nnodes = node_ids.size();
+			hd.block_size = block_size;
+			hd.nblocks = idx.size();
+			size_t sizes[S_N] = { node_ids.size()*sizeof(uint64_t), idx.size()*sizeof(block),
+				ts.size(), dur.size(), n*sizeof(uint32_t), n*sizeof(uint32_t), n*sizeof(uint32_t),
+				n*sizeof(uint32_t), n*sizeof(double), n*sizeof(double), n*sizeof(double) };
+			hd.offsets[0] = (sizeof(header) + 7) & ~(size_t)7;
+			for(unsigned int s=0;s<S_N;s++) hd.offsets[s+1] = (hd.offsets[s] + sizes[s] + 7) & ~(size_t)7;
+			
+			write_table w(fn);
+			const char zero[8] = {0};
+			size_t pos = 0;
+			auto write = [&w,&pos](const void* data, size_t len) {
+				pos += len;
+				return w.write_data(data,len);
+			};
+			auto pad = [&write,&pos,&zero](size_t off) { return write(zero,off - pos); };
+			bool ok = write(&hd,sizeof(header)) &&
+				pad(hd.offsets[S_NODES]) && write(node_ids.data(),sizes[S_NODES]) &&
+				pad(hd.offsets[S_INDEX]) && write(idx.data(),sizes[S_INDEX]) &&
+				pad(hd.offsets[S_START_TS]) && write(ts.data(),ts.size()) &&
+				pad(hd.offsets[S_DURATION]) && write(dur.data(),dur.size()) &&
+				pad(hd.offsets[S_TRIP_ID]) && write_column<uint32_t>(w,pos,trips,[](const bike_trip& t) { return t.trip_id; }) &&
+				pad(hd.offsets[S_BIKE_ID]) && write_column<uint32_t>(w,pos,trips,[](const bike_trip& t) { return t.bike_id; }) &&
+				pad(hd.offsets[S_START_NODE]) && write_column<uint32_t>(w,pos,trips,[&node_idx](const bike_trip& t) { return node_idx(t.start_node); }) &&
+				pad(hd.offsets[S_END_NODE]) && write_column<uint32_t>(w,pos,trips,[&node_idx](const bike_trip& t) { return node_idx(t.end_node); }) &&
+				pad(hd.offsets[S_START_DIST]) && write_column<double>(w,pos,trips,[](const bike_trip& t) { return t.start_dist; }) &&
+				pad(hd.offsets[S_END_DIST]) && write_column<double>(w,pos,trips,[](const bike_trip& t) { return t.end_dist; }) &&
+				pad(hd.offsets[S_TRIP_DIST]) && write_column<double>(w,pos,trips,[](const bike_trip& t) { return t.trip_dist; }) &&
+				pad(hd.offsets[S_N]) && w.close();
+			if(!ok) fprintf(stderr,"bike_trips_store::write(): error writing file %s!\n",fn);
+			return ok;
+		}
+};
+
+#endif
+
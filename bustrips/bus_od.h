@@ -0,0 +1,263 @@
+/*  -*- C++ -*-
+ * bus_od.h -- bus trips from the origin-destination data of LTA DataMall,
+ * 	aggregated by pairs of bus stops and hours
+ * 
+ * only trips among a given list of bus stops are used; bus stops can be
+ * merged with their pair (e.g. stops on the opposite side of the road);
+ * the input is processed in chunks in parallel, each chunk is aggregated
+ * separately and the results are combined in the order of the chunks, so
+ * pairs of bus stops are listed in the order of their first appearance;
+ * counts are only stored for the pairs that appear in the input, so
+ * memory use does not depend on the square of the number of bus stops
+ * 
+ * the result can be written as a text file (hour, bus stop IDs, number of
+ * trips), or a binary weight table: file ID, number of pairs of bus
+ * stops, number of hours, the bus stop IDs for each pair and the weights
+ * for each pair and hour
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef BUS_OD_H
+#define BUS_OD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "read_table.h"
+#include "flat_hash_map.h"
+#include "write_table.h"
+#include "mem_stats.h"
+
+static const unsigned int hours = 24;
+
+/* file ID of binary weight tables */
+static const uint64_t weight_table_id = 0x9d2f4c1b83e6a507UL;
+
+/* maximum number of pairs of bus stops where the index of pairs is stored
+ * in a dense table (16 MB); a hash map is used for more pairs */
+static const size_t od_dense_max_pairs = 1UL << 22;
+
+/* trip counts collected from one chunk of the input (or the combined
+ * result); counts are only stored for pairs of bus stops that appear in
+ * the input, in the order of their first appearance */
+struct od_counts {
+	enum : uint32_t { no_pair = (uint32_t)-1 };
+	std::vector<uint32_t> order; /* pairs (as s1*nstops + s2) in the order of their first appearance */
+	std::vector<uint64_t> cnt; /* number of trips for each pair in order and hour */
+	std::vector<uint32_t> dense; /* position of each pair in order (if there are few bus stops) */
+	flat_hash_map<uint64_t,uint32_t> sparse; /* the same if there are many bus stops */
+	uint64_t lines; /* number of records used */
+	od_counts():lines(0) { }
+	
+	/* position of pair p in order, it is added if it was not seen yet */
+	uint32_t get(uint32_t p, size_t npairs) {
+		uint32_t x = order.size();
+		if(npairs <= od_dense_max_pairs) {
+			if(dense.empty()) dense.resize(npairs,no_pair);
+			if(dense[p] != no_pair) return dense[p];
+			dense[p] = x;
+		}
+		else {
+			auto res = sparse.insert(std::make_pair((uint64_t)p,x));
+			if(!res.second) return res.first->second;
+		}
+		order.push_back(p);
+		cnt.resize(cnt.size() + hours,0);
+		return x;
+	}
+	void add(uint32_t p, size_t npairs, unsigned int h, uint64_t c) {
+		cnt[(size_t)get(p,npairs)*hours + h] += c;
+	}
+	size_t memory_usage() const { return mem_size(cnt) + mem_size(order) + mem_size(dense) + mem_size(sparse); }
+};
+
+struct bus_od {
+	/* bus stops to use: stop_idx maps bus stop codes directly to a dense
+	 * index, after replacing it with its pair (if any); stop_ids has the
+	 * codes for each index */
+	enum : uint32_t { no_stop = (uint32_t)-1 };
+	std::vector<uint32_t> stop_idx;
+	std::vector<uint64_t> stop_ids;
+	size_t nstops;
+	std::vector<od_counts> parts; /* results for each chunk while reading */
+	od_counts total; /* combined result */
+	
+	bus_od():nstops(0) { }
+	
+	/* read the list of bus stops (CSV file with a header, stop code in the
+	 * first column); busstops_pairs has the stops to merge to their pair */
+	bool read_stops(const char* stops_fn, const flat_hash_map<uint64_t,uint64_t>& busstops_pairs) {
+		flat_hash_map<uint64_t,uint32_t> ids;
+		read_table2 rt(stops_fn);
+		rt.set_delim(',');
+		rt.read_line(); /* skip header */
+		while(rt.read_line()) {
+			uint64_t id;
+			if(!rt.read(read_bounds(id,0UL,100000000UL))) break;
+			auto it = busstops_pairs.find(id);
+			uint64_t id2 = (it == busstops_pairs.end()) ? id : it->second;
+			auto it2 = ids.find(id2);
+			uint32_t x = stop_ids.size();
+			if(it2 == ids.end()) {
+				ids.insert(std::make_pair(id2,x));
+				stop_ids.push_back(id2);
+			}
+			else x = it2->second;
+			if(id >= stop_idx.size()) stop_idx.resize(id+1,no_stop);
+			stop_idx[id] = x;
+		}
+		if(rt.get_last_error() != T_EOF) {
+			fprintf(stderr,"Error reading bus stops:\n");
+			rt.write_error(stderr);
+			return false;
+		}
+		nstops = stop_ids.size();
+		if(nstops == 0) {
+			fprintf(stderr,"No bus stops read!\n");
+			return false;
+		}
+		if(nstops > 65535) {
+			fprintf(stderr,"Too many bus stops (%lu)!\n",nstops);
+			return false;
+		}
+		return true;
+	}
+	
+	/* read the trips of the given day type (CSV file with a header), from
+	 * fn or f if fn is null; each chunk is aggregated separately in parts */
+	bool read_trips(const char* fn, FILE* f, const char* day_type, unsigned int nthreads) {
+		const size_t npairs = nstops*nstops;
+		read_table_parallel rt(fn,f,nthreads);
+		rt.set_delim(',');
+		rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
+		parts.clear();
+		parts.resize(rt.get_nchunks());
+		const size_t day_len = strlen(day_type);
+		bool res = rt.read_all([&](read_table2& r, unsigned int i) {
+			if(i == 0 && r.get_line() == 1) return true; /* skip header */
+			string_view_custom day;
+			unsigned int h;
+			uint64_t n1,n2,cnt;
+			if(!r.read(read_table_skip(),day,read_bounds(h,0U,hours-1),read_table_skip(),n1,n2,cnt)) return false;
+			if(day.len != day_len || memcmp(day.str,day_type,day_len)) return true;
+			if(n1 >= stop_idx.size() || n2 >= stop_idx.size()) return true;
+			uint32_t s1 = stop_idx[n1];
+			uint32_t s2 = stop_idx[n2];
+			if(s1 == no_stop || s2 == no_stop) return true;
+			
+			od_counts& c = parts[i];
+			c.add(s1*nstops + s2,npairs,h,cnt);
+			c.lines++;
+			return true;
+		});
+		if(!res) {
+			fprintf(stderr,"Error reading trips:\n");
+			rt.write_error(stderr);
+			return false;
+		}
+		return true;
+	}
+	
+	/* combine the results in the order of the chunks */
+	void combine() {
+		const size_t npairs = nstops*nstops;
+		total = od_counts();
+		for(od_counts& c : parts) {
+			for(size_t j=0;j<c.order.size();j++) {
+				size_t x = total.get(c.order[j],npairs);
+				for(unsigned int h=0;h<hours;h++) total.cnt[x*hours + h] += c.cnt[j*hours + h];
+			}
+			total.lines += c.lines;
+			c = od_counts();
+		}
+		parts.clear();
+		/* the index is not needed anymore */
+		total.dense = std::vector<uint32_t>();
+		total.sparse = flat_hash_map<uint64_t,uint32_t>();
+		fprintf(stderr,"%lu records used, %lu pairs of bus stops\n",total.lines,total.order.size());
+	}
+	
+	/* call f(h,n1,n2,cnt) for all nonzero counts in the combined result */
+	template<class F>
+	void for_each(F&& f) const {
+		for(size_t j=0;j<total.order.size();j++) {
+			uint32_t p = total.order[j];
+			for(unsigned int h=0;h<hours;h++) {
+				uint64_t x = total.cnt[j*hours + h];
+				if(x) f(h,stop_ids[p / nstops],stop_ids[p % nstops],x);
+			}
+		}
+	}
+	
+	/* write the result as a binary weight table */
+	bool write_binary(const char* fn) const {
+		write_table w(fn);
+		uint64_t header[3] = {weight_table_id, total.order.size(), hours};
+		w.write_data(header,sizeof(header));
+		for(uint32_t p : total.order) {
+			uint64_t ids[2] = {stop_ids[p / nstops], stop_ids[p % nstops]};
+			w.write_data(ids,sizeof(ids));
+		}
+		for(uint64_t x : total.cnt) {
+			double y = x;
+			w.write_data(&y,sizeof(double));
+		}
+		if(!w.close()) {
+			fprintf(stderr,"Error writing output file %s!\n",fn);
+			return false;
+		}
+		return true;
+	}
+	
+	/* write the result as text to fn, or f if fn is null */
+	bool write_text(const char* fn, FILE* f) const {
+		write_table w(fn,f);
+		for_each([&w](unsigned int h, uint64_t n1, uint64_t n2, uint64_t x) {
+			w.write_row(h,n1,n2,x);
+		});
+		if(!w.close()) {
+			fprintf(stderr,"Error writing output!\n");
+			return false;
+		}
+		return true;
+	}
+	
+	size_t memory_usage() const {
+		return mem_size(stop_idx) + mem_size(stop_ids) + mem_size(parts) + mem_size(total);
+	}
+};
+
+#endif
+
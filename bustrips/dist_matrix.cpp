@@ -37,52 +37,19 @@
 #include <stdint.h>
 #include <utility>
 #include <vector>
-#include <unordered_map>
+#include <thread>
 #include "read_table.h"
-
-/*-----------------------------------------------------------------------------
- * pair_hash: combine the hash of two 64-bit unsigned integers
- * 
- * adapted from Murmurhash, from
- * https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
- * MurmurHash2, 64-bit versions, by Austin Appleby
- * 64-bit hash for 64-bit platforms
- * 
- * MurmurHash2 was written by Austin Appleby, and is placed in the public
- * domain. The author hereby disclaims copyright to this source code.
-*/
-struct pair_hash {
-	uint64_t seed;
-	explicit pair_hash(uint64_t s = 0xe6573480bcc4fceaUL) : seed(s) { }
-	uint64_t operator () (const std::pair<uint64_t,uint64_t>& p) const {
-		
-		const uint64_t m = 0xc6a4a7935bd1e995UL;
-		const int r = 47;
-		uint64_t h = seed ^ (16UL * m); /* 16UL since we have 16 bytes in total */
-		
-		const std::array<uint64_t,2> a = {p.first, p.second};
-		for(uint64_t k : a) {
-			k *= m; 
-			k ^= k >> r; 
-			k *= m; 
-			
-			h ^= k;
-			h *= m; 
-		}
-		
-		h ^= h >> r;
-		h *= m;
-		h ^= h >> r;
-		
-		return h;
-	}
-};
+#include "flat_hash_map.h"
+#include "write_table.h"
+#include "mem_stats.h"
 
 
 int main(int argc, char **argv)
 {
 	char* fnin = 0;
 	char* matrix_fn = 0; /* for output */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use for parsing the input */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
 	for(int i=1;i<argc;i++) {
 		if(argv[i][0] == '-') switch(argv[i][1]) {
 			case 'i':
@@ -93,6 +60,13 @@ int main(int argc, char **argv)
 				matrix_fn = argv[i+1];
 				i++;
 				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
 			default:
 				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
 				break;
@@ -105,25 +79,38 @@ int main(int argc, char **argv)
 		return 1;
 	}
 	
-	std::unordered_map<std::pair<uint64_t,uint64_t>,double,pair_hash> dists;
+	flat_hash_map<std::pair<uint64_t,uint64_t>,double> dists;
 	
 	{
-		read_table2 rt(fnin,stdin);
-		while(rt.read_line()) {
-			uint64_t n1,n2;
-			double d;
-			if(!rt.read(n1,n2,d)) break;
-			dists.insert(std::make_pair(std::make_pair(n1,n2),d));
-			dists.insert(std::make_pair(std::make_pair(n2,n1),d));
-		}
-		if(rt.get_last_error() != T_EOF) {
+		/* parse the input in parallel, then insert in the original order */
+		read_table_parallel rt(fnin,stdin,nthreads);
+		rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
+		std::vector<read_table_schema<uint64_t,uint64_t,double> > parts;
+		if(!rt.read_all_rows(parts)) {
 			fprintf(stderr,"Error reading distances:\n");
 			rt.write_error(stderr);
 			return 1;
 		}
+		size_t nrows = 0;
+		for(const auto& p : parts) nrows += p.size();
+		dists.reserve(2*nrows);
+		stats.add("parsed rows",parts);
+		stats.report("parsing the input");
+		for(auto& p : parts) {
+			const auto& n1 = p.col<0>();
+			const auto& n2 = p.col<1>();
+			const auto& d = p.col<2>();
+			for(size_t j=0;j<p.size();j++) {
+				dists.insert(std::make_pair(std::make_pair(n1[j],n2[j]),d[j]));
+				dists.insert(std::make_pair(std::make_pair(n2[j],n1[j]),d[j]));
+			}
+			p = read_table_schema<uint64_t,uint64_t,double>();
+		}
 	}
+	stats.add("distances",dists);
+	stats.report("building the distance map");
 	
-	std::unordered_map<uint64_t,size_t> nids;
+	flat_hash_map<uint64_t,size_t> nids;
 	std::vector<uint64_t> nids2;
 	
 	for(const auto& x : dists) {
@@ -138,16 +125,15 @@ int main(int argc, char **argv)
 	}
 	
 	fprintf(stderr,"%lu nodes, %lu distances read\n",nids2.size(),dists.size());
+	stats.add("distances",dists);
+	stats.add("node IDs",nids);
+	stats.add("node list",nids2);
+	stats.report("creating node IDs");
 	
 	const uint64_t file_id = 0x47a9b290e72d9f21UL;
-	FILE* fout = fopen(matrix_fn,"w");
-	
-	if(fwrite(&file_id,8,1,fout) != 1UL) {
-		fprintf(stderr,"Error writing output file!\n");
-		return 1;
-	}
+	write_table fout(matrix_fn);
 	uint64_t n = nids2.size();
-	if(fwrite(&n,8,1,fout) != 1UL) {
+	if(!fout.write_data(&file_id,8) || !fout.write_data(&n,8)) {
 		fprintf(stderr,"Error writing output file!\n");
 		return 1;
 	}
@@ -155,16 +141,24 @@ int main(int argc, char **argv)
 	for(uint64_t i=0;i<n;i++) for(uint64_t j=0;j<n;j++) {
 		double dist = 0.0;
 		if(i != j) dist = dists.at(std::make_pair(nids2[i],nids2[j]));
-		if(fwrite(&dist,sizeof(double),1,fout)!=1UL) {
+		if(!fout.write_data(&dist,sizeof(double))) {
 			fprintf(stderr,"Error writing output file!\n");
 			return 1;
 		}
 	}
-	fclose(fout);
+	if(!fout.close()) {
+		fprintf(stderr,"Error writing output file!\n");
+		return 1;
+	}
+	stats.report("writing the matrix");
 	
 	/* write IDs in proper order to stdout */
-	fout = stdout;
-	for(uint64_t i=0;i<n;i++) fprintf(fout,"%lu\n",nids2[i]);
+	write_table fids(stdout);
+	for(uint64_t i=0;i<n;i++) fids.write_row(nids2[i]);
+	if(!fids.close()) {
+		fprintf(stderr,"Error writing output!\n");
+		return 1;
+	}
 	
 	return 0;
 }
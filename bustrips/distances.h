@@ -0,0 +1,739 @@
+/*  -*- C++ -*-
+ * distances.h -- distances among the nodes of the road network, stored
+ * 	in a matrix (memory mapped from a file created by dist_matrix,
+ * 	read from a list of distances or calculated from the network), or
+ * 	calculated on demand from the network, keeping a cache of rows
+ * 
+ * besides looking up one distance, queries can be given in batches; these
+ * are processed in the order of their position in the matrix (or grouped
+ * by rows for the on demand calculation), which is faster if there are
+ * many of them and the matrix is large (or needs to be read from disk)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef DISTANCES_H
+#define DISTANCES_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <utility>
+#include "read_table.h"
+#include "flat_hash_map.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+
+
+/* rows of the distance matrix calculated on demand with a search in the
+ * road network; rows are kept in memory in a cache of limited size, where
+ * the least recently used row is replaced if it is full; rows can be also
+ * saved in a file (cache_fn) and reused in later runs
+ * 
+ * as in the full matrix, the distance between two nodes is taken from the
+ * search started at the node with the smaller ID, so each row only has
+ * the distances to nodes with larger IDs; if max_dist > 0, searches stop
+ * at this distance, and INFINITY is returned for nodes farther away (or
+ * not reachable)
+ * 
+ * layout of the cache file: file ID, number of nodes, maximum distance,
+ * checksum of the node IDs, flags for the rows already calculated (padded
+ * to 8 bytes) and the rows (as a sparse file, only the calculated rows
+ * are written) */
+class dist_row_cache {
+	protected:
+		network net;
+		std::vector<uint64_t> nids; /* node IDs */
+		const flat_hash_map<uint64_t,size_t>& ids; /* index of each node */
+		std::vector<size_t> need; /* number of nodes with a larger ID for each row */
+		size_t n;
+		double max_dist;
+		
+		/* rows in the cache and a list of them in the order of last use
+		 * (using indices of the slots) */
+		enum : uint32_t { none = (uint32_t)-1 };
+		std::vector<double> data;
+		std::vector<uint32_t> slot_row; /* row stored in each slot */
+		std::vector<uint32_t> row_slot; /* slot of each row (or none) */
+		std::vector<uint32_t> prev, next;
+		uint32_t head, tail; /* most and least recently used slots */
+		size_t nslots, used;
+		std::mutex m;
+		
+		/* cache file */
+		int f;
+		std::vector<char> on_disk;
+		uint64_t rows_off;
+		const static uint64_t file_id = 0x6e1d3b8a95c7f024UL;
+		
+		/* statistics */
+		size_t ncomputed, nread, nhits;
+		
+		void unlink(uint32_t s) {
+			if(prev[s] != none) next[prev[s]] = next[s];
+			else head = next[s];
+			if(next[s] != none) prev[next[s]] = prev[s];
+			else tail = prev[s];
+		}
+		void push_front(uint32_t s) {
+			prev[s] = none;
+			next[s] = head;
+			if(head != none) prev[head] = s;
+			head = s;
+			if(tail == none) tail = s;
+		}
+		/* store a row in the cache, replacing the least recently used if needed */
+		uint32_t insert(size_t i, const std::vector<double>& row) {
+			uint32_t s;
+			if(used < nslots) s = used++;
+			else {
+				s = tail;
+				unlink(s);
+				row_slot[slot_row[s]] = none;
+			}
+			std::copy(row.begin(),row.end(),data.begin() + s*n);
+			slot_row[s] = i;
+			row_slot[i] = s;
+			push_front(s);
+			return s;
+		}
+		
+		void compute_row(size_t i, std::vector<double>& row) const {
+			std::fill(row.begin(),row.end(),INFINITY);
+			row[i] = 0.0;
+			if(!need[i]) return;
+			uint64_t start = nids[i];
+			size_t found = 0;
+			network_search_state s;
+			net.search(start,s,[&](uint64_t current, double d, double) {
+				if(max_dist > 0.0 && d > max_dist) return false;
+				if(current <= start) return true;
+				auto it = ids.find(current);
+				if(it != ids.end()) {
+					row[it->second] = d;
+					found++;
+				}
+				return found < need[i];
+			});
+		}
+		
+		uint64_t ids_hash() const {
+			uint64_t h = 0xcbf29ce484222325UL ^ n;
+			for(uint64_t x : nids) {
+				h ^= x;
+				h *= 0x100000001b3UL;
+				h ^= h >> 29;
+			}
+			return h;
+		}
+		
+		bool open_file(const char* cache_fn) {
+			f = open(cache_fn,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+			if(f == -1) {
+				fprintf(stderr,"dist_row_cache: error opening file %s!\n",cache_fn);
+				return false;
+			}
+			uint64_t header[4];
+			double tmp = max_dist;
+			header[0] = file_id;
+			header[1] = n;
+			memcpy(header + 2,&tmp,sizeof(double));
+			header[3] = ids_hash();
+			rows_off = (sizeof(header) + n + 7) & ~7UL;
+			on_disk.assign(n,0);
+			
+			struct stat st;
+			if(fstat(f,&st)) {
+				fprintf(stderr,"dist_row_cache: error with stat() on file %s!\n",cache_fn);
+				return false;
+			}
+			if(st.st_size == 0) {
+				/* new file */
+				if(pwrite(f,header,sizeof(header),0) != (ssize_t)sizeof(header) ||
+						ftruncate(f,rows_off + sizeof(double)*n*n)) {
+					fprintf(stderr,"dist_row_cache: error writing file %s!\n",cache_fn);
+					return false;
+				}
+				return true;
+			}
+			
+			uint64_t header2[4];
+			if((uint64_t)st.st_size != rows_off + sizeof(double)*n*n ||
+					pread(f,header2,sizeof(header2),0) != (ssize_t)sizeof(header2) ||
+					header2[0] != file_id || header2[1] != n || header2[3] != header[3]) {
+				fprintf(stderr,"dist_row_cache: file %s was created for a different set of nodes!\n",cache_fn);
+				return false;
+			}
+			/* rows calculated with a larger (or no) maximum distance can be used */
+			double max_dist2;
+			memcpy(&max_dist2,header2 + 2,sizeof(double));
+			if(max_dist2 > 0.0 && !(max_dist > 0.0 && max_dist <= max_dist2)) {
+				fprintf(stderr,"dist_row_cache: file %s was created with a smaller maximum distance (%g)!\n",cache_fn,max_dist2);
+				return false;
+			}
+			max_dist = max_dist2; /* new rows are calculated the same way */
+			if(pread(f,on_disk.data(),n,sizeof(header)) != (ssize_t)n) {
+				fprintf(stderr,"dist_row_cache: error reading file %s!\n",cache_fn);
+				return false;
+			}
+			return true;
+		}
+		
+		bool read_row(size_t i, std::vector<double>& row) const {
+			size_t len = sizeof(double)*n;
+			return pread(f,row.data(),len,rows_off + i*len) == (ssize_t)len;
+		}
+		void write_row(size_t i, const std::vector<double>& row) {
+			size_t len = sizeof(double)*n;
+			char flag = 1;
+			/* the flag is only set if the row was written successfully */
+			if(pwrite(f,row.data(),len,rows_off + i*len) == (ssize_t)len &&
+					pwrite(f,&flag,1,4*sizeof(uint64_t) + i) == 1) on_disk[i] = 1;
+		}
+	
+	public:
+		/* nodes are given in the order of their index in ids; the cache
+		 * uses at most cache_size bytes (but stores at least one row) */
+		dist_row_cache(network&& net_, const std::vector<uint64_t>& nids_,
+				const flat_hash_map<uint64_t,size_t>& ids_, double max_dist_, size_t cache_size) :
+				net(std::move(net_)), nids(nids_), ids(ids_), n(nids_.size()), max_dist(max_dist_),
+				head(none), tail(none), used(0), f(-1), rows_off(0), ncomputed(0), nread(0), nhits(0) {
+			std::vector<uint64_t> sorted(nids);
+			std::sort(sorted.begin(),sorted.end());
+			need.resize(n);
+			for(size_t i=0;i<n;i++)
+				need[i] = sorted.end() - std::upper_bound(sorted.begin(),sorted.end(),nids[i]);
+			nslots = n ? cache_size / (sizeof(double)*n) : 0;
+			if(nslots < 1) nslots = 1;
+			if(nslots > n) nslots = n;
+			data.resize(nslots*n);
+			slot_row.resize(nslots);
+			prev.resize(nslots);
+			next.resize(nslots);
+			row_slot.assign(n,none);
+		}
+		~dist_row_cache() { if(f != -1) close(f); }
+		
+		bool set_cache_file(const char* cache_fn) {
+			if(open_file(cache_fn)) return true;
+			if(f != -1) close(f);
+			f = -1;
+			return false;
+		}
+		
+		/* make sure that row i is in the cache and return it; this can be
+		 * called from multiple threads: rows are calculated without
+		 * holding the lock, which is locked on return (the row is valid
+		 * until it is released) */
+		const double* get_row(size_t i, std::unique_lock<std::mutex>& lock) {
+			lock = std::unique_lock<std::mutex>(m);
+			uint32_t s = row_slot[i];
+			if(s != none) {
+				nhits++;
+				if(s != head) {
+					unlink(s);
+					push_front(s);
+				}
+				return data.data() + s*n;
+			}
+			bool disk = (f != -1 && on_disk[i]);
+			lock.unlock();
+			
+			std::vector<double> row(n);
+			if(!(disk && read_row(i,row))) {
+				disk = false;
+				compute_row(i,row);
+			}
+			
+			lock.lock();
+			if(disk) nread++;
+			else {
+				ncomputed++;
+				if(f != -1 && !on_disk[i]) write_row(i,row);
+			}
+			s = row_slot[i];
+			if(s == none) s = insert(i,row); /* another thread could have added it meanwhile */
+			return data.data() + s*n;
+		}
+		
+		/* distance between nodes with indices i and j */
+		double get(size_t i, size_t j) {
+			if(i == j) return 0.0;
+			if(nids[i] > nids[j]) std::swap(i,j);
+			std::unique_lock<std::mutex> lock;
+			return get_row(i,lock)[j];
+		}
+		
+		/* distances for nq pairs of indices in q, written to out; queries
+		 * are grouped by the row they use, so each row is needed only once */
+		void get_many(const std::pair<size_t,size_t>* q, size_t nq, double* out) {
+			std::vector<std::pair<size_t,size_t> > qs(nq); /* row and query index */
+			for(size_t k=0;k<nq;k++) {
+				size_t i = q[k].first;
+				size_t j = q[k].second;
+				qs[k] = std::make_pair((nids[i] > nids[j]) ? j : i,k);
+			}
+			std::sort(qs.begin(),qs.end());
+			std::unique_lock<std::mutex> lock;
+			for(size_t k=0;k<nq;) {
+				size_t i = qs[k].first;
+				const double* row = get_row(i,lock);
+				for(;k<nq && qs[k].first == i;k++) {
+					const auto& x = q[qs[k].second];
+					out[qs[k].second] = (x.first == x.second) ? 0.0 : row[x.first + x.second - i];
+				}
+				lock.unlock();
+			}
+		}
+		
+		size_t memory_usage() const {
+			return mem_size(net) + mem_size(nids) + mem_size(need) + mem_size(data) + mem_size(slot_row) +
+				mem_size(row_slot) + mem_size(prev) + mem_size(next) + mem_size(on_disk);
+		}
+		void report(FILE* out = stderr) const {
+			fprintf(out,"distance rows: %lu calculated, %lu read from the cache file, %lu cache hits (cache size: %lu rows)\n",
+				ncomputed,nread,nhits,nslots);
+		}
+};
+
+
+/* look up matrix[i*n + j] for nq pairs of indices (i,j) in q, writing the
+ * results to out in the same order; queries are processed in chunks, and
+ * each chunk is first sorted by the position in the matrix (counting sort
+ * into 1024 buckets of consecutive elements), so that the matrix is
+ * accessed in increasing order, while the results of a chunk still fit
+ * in the cache; elements a few queries ahead are prefetched, and if the
+ * matrix is memory mapped, the kernel is also asked to read the parts not
+ * in memory yet ahead (once for each block of 64 kB) */
+static void gather_dists(const double* matrix, size_t n, const std::pair<size_t,size_t>* q,
+		size_t nq, double* out, bool mapped = false) {
+	if(nq < 64) {
+		for(size_t k=0;k<nq;k++) out[k] = matrix[q[k].first*n + q[k].second];
+		return;
+	}
+	const size_t chunk_size = 65536;
+	const unsigned int bits = 10;
+	const size_t nb = ((size_t)1) << bits;
+	uint64_t total = (uint64_t)n*n;
+	unsigned int total_bits = 64 - __builtin_clzll(total);
+	unsigned int shift = (total_bits > bits) ? (total_bits - bits) : 0;
+	
+	const size_t prefetch_dist = 16;
+	const size_t advise_dist = 256;
+	/* blocks of the matrix that have pages not in memory */
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t block_size = std::max((size_t)65536,page_size);
+	const uintptr_t base = ((uintptr_t)matrix) & ~(uintptr_t)(page_size - 1);
+	std::vector<char> advise;
+	if(mapped) {
+		uintptr_t end = (uintptr_t)(matrix + total);
+		std::vector<unsigned char> vec((end - base + page_size - 1) / page_size);
+		if(!mincore((void*)base,end - base,vec.data())) {
+			advise.resize((end - base + block_size - 1) / block_size,0);
+			for(size_t i=0;i<vec.size();i++) if(!(vec[i] & 1)) advise[i*page_size / block_size] = 1;
+		}
+	}
+	
+	std::vector<uint32_t> start(nb+1);
+	std::vector<uint64_t> pos(std::min(chunk_size,nq));
+	std::vector<std::pair<uint64_t,uint32_t> > sorted(pos.size()); /* position in the matrix and query index */
+	for(size_t c0=0;c0<nq;c0+=chunk_size) {
+		size_t c = std::min(chunk_size,nq-c0);
+		std::fill(start.begin(),start.end(),0);
+		for(size_t k=0;k<c;k++) {
+			pos[k] = q[c0+k].first*n + q[c0+k].second;
+			start[(pos[k] >> shift) + 1]++;
+		}
+		for(size_t b=0;b<nb;b++) start[b+1] += start[b];
+		for(size_t k=0;k<c;k++) sorted[start[pos[k] >> shift]++] = std::make_pair(pos[k],(uint32_t)k);
+		
+		double* out1 = out + c0;
+		for(size_t k=0;k<c;k++) {
+			if(advise.size() && k + advise_dist < c) {
+				size_t block = (((uintptr_t)(matrix + sorted[k + advise_dist].first)) - base) / block_size;
+				if(advise[block]) {
+					madvise((void*)(base + block*block_size),block_size,MADV_WILLNEED);
+					advise[block] = 0;
+				}
+			}
+			if(k + prefetch_dist < c) __builtin_prefetch(matrix + sorted[k + prefetch_dist].first);
+			out1[sorted[k].second] = matrix[sorted[k].first];
+		}
+	}
+}
+
+/* generic interface for distances -- store them in a matrix */
+class distances {
+	protected:
+		void* map;
+		double* matrix;
+		size_t n;
+		size_t map_size;
+		flat_hash_map<uint64_t,size_t> ids;
+		int f;
+		std::unique_ptr<dist_row_cache> rows; /* if distances are calculated on demand */
+		const static uint64_t file_id = 0x47a9b290e72d9f21UL;
+		
+		/* set the IDs of the given nodes (duplicates are skipped), which
+		 * have to be in the network; nids2 has the IDs in order */
+		bool set_nodes(const network& net, const std::vector<uint64_t>& nodes, std::vector<uint64_t>& nids2) {
+			ids.reserve(nodes.size());
+			for(uint64_t x : nodes) if(ids.count(x) == 0) {
+				if(!net.has_node(x)) {
+					fprintf(stderr,"distances: node %lu not in the network!\n",x);
+					ids.clear();
+					return false;
+				}
+				ids.insert(std::make_pair(x,nids2.size()));
+				nids2.push_back(x);
+			}
+			ids.freeze();
+			n = nids2.size();
+			return true;
+		}
+		
+	public:
+		distances():map(MAP_FAILED),matrix(0),n(0UL),map_size(0UL),f(-1) { }
+		~distances() { clear(); }
+		
+		void clear() {
+			if(map != MAP_FAILED) munmap(map,map_size);
+			else if(matrix) free(matrix);
+			map = MAP_FAILED;
+			matrix = 0;
+			n = 0;
+			map_size = 0;
+			ids.clear();
+			if(f != -1) close(f);
+			f = -1;
+			rows.reset();
+		}
+		
+		bool open_dists(const char* df, const char* fids) {
+			clear();
+			/* load ids first */
+			{
+				std::vector<uint64_t> vids;
+				read_table2 rt(fids);
+				while(rt.read_line()) {
+					uint64_t id;
+					if(!rt.read(id)) break;
+					vids.push_back(id);
+				}
+				if(rt.get_last_error() != T_EOF) {
+					fprintf(stderr,"distances::open_dists(): Error reading ids:\n");
+					rt.write_error(stderr);
+					return false;
+				}
+				
+				ids.reserve(vids.size());
+				for(size_t i=0;i<vids.size();i++) ids.insert(std::make_pair(vids[i],i));
+				ids.freeze();
+			}
+			n = ids.size();
+			/* try opening distances file */
+			f = open(df,O_RDONLY | O_CLOEXEC | O_NOATIME);
+			if(f == -1) {
+				fprintf(stderr,"distances::open_dists(): Error opening file %s!\n",df);
+				ids.clear();
+				return false;
+			}
+			{
+				struct stat st;
+				if(fstat(f,&st)) {
+					fprintf(stderr,"distances::open_dists(): Error with stat() on file %s!\n",df);
+					ids.clear();
+					close(f);
+					f = -1;
+					return false;
+				}
+				map_size = st.st_size;
+			}
+			if(map_size != 16 + sizeof(double)*n*n) {
+				fprintf(stderr,"distances::open_dists(): unexpected file size!\n");
+				ids.clear();
+				close(f);
+				f = -1;
+				return false;
+			}
+			map = mmap(0,map_size,PROT_READ,MAP_SHARED,f,0);
+			if(map == MAP_FAILED) {
+				fprintf(stderr,"distances::open_dists(): error with mmap()!\n");
+				ids.clear();
+				close(f);
+				f = -1;
+				return false;
+			}
+			
+			uint64_t* tmp = (uint64_t*)map;
+			if(tmp[0] != file_id) {
+				fprintf(stderr,"distances::open_dists(): unexpected file ID!\n");
+				clear();
+				return false;
+			}
+			if(tmp[1] != n) {
+				fprintf(stderr,"distances::open_dists(): unexpected size in file (%lu instead of %lu)!\n",tmp[1],n);
+				clear();
+				return false;
+			}
+			
+			matrix = (double*)(map+16);
+			return true;
+		}
+		
+		double get_dist(uint64_t n1, uint64_t n2) const {
+			return get_dist_idx(ids.at(n1),ids.at(n2));
+		}
+		/* distance between the nodes with the given indices */
+		double get_dist_idx(size_t i, size_t j) const {
+			if(matrix) return matrix[i*n+j];
+			return rows->get(i,j);
+		}
+		
+		/* calculate distances on demand among the given nodes from the
+		 * network, keeping the rows in a cache of cache_size bytes and
+		 * optionally in the file cache_fn (see dist_row_cache above) */
+		bool open_network(network&& net, const std::vector<uint64_t>& nodes, double max_dist,
+				size_t cache_size, const char* cache_fn) {
+			clear();
+			std::vector<uint64_t> nids2;
+			if(!set_nodes(net,nodes,nids2)) return false;
+			rows.reset(new dist_row_cache(std::move(net),nids2,ids,max_dist,cache_size));
+			if(cache_fn && !rows->set_cache_file(cache_fn)) {
+				clear();
+				return false;
+			}
+			return true;
+		}
+		bool is_on_demand() const { return rows != nullptr; }
+		
+		/* distances for nq pairs of node IDs in q, written to out (in the
+		 * same order); IDs are looked up first, then queries are processed
+		 * grouped by their place in the matrix (see gather_dists above) */
+		void get_dists(const std::pair<uint64_t,uint64_t>* q, size_t nq, double* out) const {
+			std::vector<std::pair<size_t,size_t> > idx(nq);
+			for(size_t k=0;k<nq;k++) idx[k] = std::make_pair(ids.at(q[k].first),ids.at(q[k].second));
+			get_dists_idx(idx.data(),nq,out);
+		}
+		/* the same with the indices of the nodes */
+		void get_dists_idx(const std::pair<size_t,size_t>* q, size_t nq, double* out) const {
+			if(matrix) gather_dists(matrix,n,q,nq,out,map != MAP_FAILED);
+			else rows->get_many(q,nq,out);
+		}
+		
+		/* remove the memory mapped matrix from memory (if the file is not
+		 * used by other processes), so that the next accesses read it
+		 * from the disk; used for benchmarking */
+		bool drop_cache() {
+			if(map == MAP_FAILED) return false;
+			if(madvise(map,map_size,MADV_DONTNEED)) return false;
+			return posix_fadvise(f,0,0,POSIX_FADV_DONTNEED) == 0;
+		}
+		/* size of the memory mapped matrix and the part in memory */
+		size_t mapped_size() const { return (map != MAP_FAILED) ? map_size : 0; }
+		size_t mapped_resident() const { return (map != MAP_FAILED) ? mem_stats::mapped_resident(map,map_size) : 0; }
+		void report_cache(FILE* out = stderr) const { if(rows) rows->report(out); }
+		
+		/* direct access to the matrix: index of a node, size and data */
+		bool has_node(uint64_t n1) const { return ids.count(n1) > 0; }
+		size_t get_index(uint64_t n1) const { return ids.at(n1); }
+		/* ID of the node with index i */
+		uint64_t get_id(size_t i) const { return ids.begin()[i].first; }
+		size_t size() const { return n; }
+		const double* get_matrix() const { return matrix; }
+		
+		void add_mem_stats(mem_stats& stats) const {
+			stats.add("distance matrix IDs",ids);
+			if(map != MAP_FAILED) stats.add_mapped("distance matrix",map,map_size);
+			else stats.add_bytes("distance matrix",matrix ? sizeof(double)*n*n : 0);
+			if(rows) stats.add("distance row cache",*rows);
+		}
+		
+		/* read a list of distances; the input is parsed with the number
+		 * of threads given when creating rt */
+		bool read_dists(read_table_parallel& rt) {
+			clear();
+			flat_hash_map<std::pair<uint64_t,uint64_t>,double> dists;
+			{
+				std::vector<read_table_schema<uint64_t,uint64_t,double> > parts;
+				if(!rt.read_all_rows(parts)) {
+					fprintf(stderr,"distances::read_dists(): Error reading distances:\n");
+					rt.write_error(stderr);
+					return false;
+				}
+				size_t nrows = 0;
+				for(const auto& p : parts) nrows += p.size();
+				dists.reserve(2*nrows);
+				for(auto& p : parts) {
+					const auto& n1 = p.col<0>();
+					const auto& n2 = p.col<1>();
+					const auto& d = p.col<2>();
+					for(size_t j=0;j<p.size();j++) {
+						dists.insert(std::make_pair(std::make_pair(n1[j],n2[j]),d[j]));
+						dists.insert(std::make_pair(std::make_pair(n2[j],n1[j]),d[j]));
+					}
+					p = read_table_schema<uint64_t,uint64_t,double>();
+				}
+			}
+			std::vector<uint64_t> nids2;
+	
+			for(const auto& x : dists) {
+				if(ids.count(x.first.first) == 0) {
+					ids[x.first.first] = nids2.size();
+					nids2.push_back(x.first.first);
+				}
+				if(ids.count(x.first.second) == 0) {
+					ids[x.first.second] = nids2.size();
+					nids2.push_back(x.first.second);
+				}
+			}
+			ids.freeze();
+			
+			n = nids2.size();
+			matrix = (double*)malloc(sizeof(double)*n*n);
+			if(!matrix) {
+				fprintf(stderr,"distances::read_dists(): Error allocating memory!\n");
+				ids.clear();
+				return false;
+			}
+			
+			for(uint64_t i=0;i<n;i++) for(uint64_t j=0;j<n;j++) {
+				double dist = 0.0;
+				if(i != j) dist = dists.at(std::make_pair(nids2[i],nids2[j]));
+				matrix[i*n+j] = dist;
+			}
+			return true;
+		}
+		bool read_dists(read_table_parallel&& rt) {
+			return read_dists(rt);
+		}
+		
+		/* calculate the distances among the given nodes with a search in
+		 * the network from each of them, using nthreads threads; each
+		 * pair is set from the search started at the node with the
+		 * smaller ID (as in the output of nodes_distances) */
+		bool compute_dists(const network& net, const std::vector<uint64_t>& nodes, unsigned int nthreads) {
+			clear();
+			std::vector<uint64_t> nids2;
+			if(!set_nodes(net,nodes,nids2)) return false;
+			matrix = (double*)malloc(sizeof(double)*n*n);
+			if(!matrix) {
+				fprintf(stderr,"distances::compute_dists(): Error allocating memory!\n");
+				ids.clear();
+				return false;
+			}
+			for(size_t i=0;i<n;i++) matrix[i*n+i] = 0.0;
+			
+			/* a search can stop after finding all nodes with larger IDs */
+			std::vector<uint64_t> sorted(nids2);
+			std::sort(sorted.begin(),sorted.end());
+			
+			std::atomic<size_t> next(0);
+			std::atomic<bool> error(false);
+			auto worker = [&]() {
+				network_search_state s;
+				while(!error) {
+					size_t i = next++;
+					if(i >= n) break;
+					uint64_t start = nids2[i];
+					size_t need = sorted.end() - std::upper_bound(sorted.begin(),sorted.end(),start);
+					size_t found = 0;
+					if(!need) continue;
+					bool ok = net.search(start,s,[&](uint64_t current, double d, double) {
+						if(current <= start) return true;
+						auto it = ids.find(current);
+						if(it != ids.end()) {
+							matrix[i*n + it->second] = d;
+							matrix[it->second*n + i] = d;
+							found++;
+						}
+						return found < need;
+					});
+					if(!ok) error = true;
+					else if(found < need) {
+						fprintf(stderr,"distances::compute_dists(): not all nodes can be reached from node %lu!\n",start);
+						error = true;
+					}
+				}
+			};
+			std::vector<std::thread> threads;
+			for(unsigned int j=1;j<nthreads && j<n;j++) threads.emplace_back(worker);
+			worker();
+			for(auto& t : threads) t.join();
+			if(error) {
+				clear();
+				return false;
+			}
+			return true;
+		}
+		
+		/* save the matrix to the binary file df and the node IDs to fids
+		 * (in the same format as dist_matrix, so it can be opened later) */
+		bool save_dists(const char* df, const char* fids) const {
+			if(!matrix) {
+				fprintf(stderr,"distances::save_dists(): the full distance matrix is not available!\n");
+				return false;
+			}
+			write_table w(df);
+			uint64_t header[2] = {file_id, n};
+			w.write_data(header,sizeof(header));
+			w.write_data(matrix,sizeof(double)*n*n);
+			if(!w.close()) {
+				fprintf(stderr,"distances::save_dists(): error writing file %s!\n",df);
+				return false;
+			}
+			write_table w2(fids);
+			for(const auto& x : ids) w2.write_row(x.first);
+			if(!w2.close()) {
+				fprintf(stderr,"distances::save_dists(): error writing file %s!\n",fids);
+				return false;
+			}
+			return true;
+		}
+};
+
+#endif
+
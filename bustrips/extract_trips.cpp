@@ -0,0 +1,162 @@
+/*
+ * extract_trips.cpp -- extract aggregated bus trips among a set of bus stops
+ * 	from the origin-destination data published by LTA DataMall
+ * 
+ * input: CSV file with the columns YEAR_MONTH, DAY_TYPE, TIME_PER_HOUR,
+ * 	PT_TYPE, ORIGIN_PT_CODE, DESTINATION_PT_CODE, TOTAL_TRIPS (with a
+ * 	header); with -DREAD_TABLE_ZLIB, the zip file can be given directly
+ * 
+ * only trips on the given day type (default: WEEKDAY) and with both ends
+ * among the given bus stops are kept; bus stops can be merged to their
+ * pairs (as in sample_trips3); trips are summed for each pair of bus stops
+ * and hour; output is either in the format that sample_trips3 reads (hour,
+ * origin, destination, number of trips) or a binary weight table (-b)
+ * 
+ * pairs are written in the order they first appear in the input, so
+ * sample_trips3 numbers them the same way as if the trips were given
+ * directly (the input is only used as "aggregated" there)
+ * 
+ * aggregation uses a dense table over all pairs of the bus stops and
+ * hours, so this is meant to be used with a limited set of bus stops
+ * (i.e. a few hundred at most)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include "read_table.h"
+#include "flat_hash_map.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "bus_od.h"
+
+
+int main(int argc, char **argv)
+{
+	const char* fnin = 0; /* input file (stdin if not given) */
+	const char* stops_fn = 0; /* list of bus stops to use */
+	const char* pairs_fn = 0; /* pairs of bus stops to merge */
+	const char* fout = 0; /* output file (stdout if not given) */
+	const char* binary_fn = 0; /* binary output */
+	const char* day_type = "WEEKDAY";
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use for parsing the input */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'i':
+				fnin = argv[i+1];
+				i++;
+				break;
+			case 's':
+				stops_fn = argv[i+1];
+				i++;
+				break;
+			case 'p':
+				pairs_fn = argv[i+1];
+				i++;
+				break;
+			case 'o':
+				fout = argv[i+1];
+				i++;
+				break;
+			case 'b':
+				binary_fn = argv[i+1];
+				i++;
+				break;
+			case 'd':
+				day_type = argv[i+1];
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!stops_fn) {
+		fprintf(stderr,"Error: no list of bus stops given!\n");
+		return 1;
+	}
+	
+	/* bus stops to merge to their pair */
+	flat_hash_map<uint64_t,uint64_t> busstops_pairs;
+	if(pairs_fn) {
+		read_table2 rt(pairs_fn);
+		while(rt.read_line()) {
+			uint64_t n1,n2;
+			if(!rt.read(n1,n2)) break;
+			busstops_pairs[n1] = n2;
+		}
+		if(rt.get_last_error() != T_EOF) {
+			fprintf(stderr,"Error reading bus stop pairs:\n");
+			rt.write_error(stderr);
+			return 1;
+		}
+	}
+	
+	/* bus stops to use */
+	bus_od od;
+	if(!od.read_stops(stops_fn,busstops_pairs)) return 1;
+	
+	/* read the trips, each chunk of the input is aggregated separately */
+	if(!od.read_trips(fnin,stdin,day_type,nthreads)) return 1;
+	stats.add("bus stop index",od.stop_idx);
+	stats.add("trip counts",od.parts);
+	stats.report("reading the trips");
+	
+	/* combine the results in the order of the chunks */
+	od.combine();
+	
+	if(binary_fn) {
+		if(!od.write_binary(binary_fn)) return 1;
+	}
+	else if(!od.write_text(fout,stdout)) return 1;
+	
+	stats.add("trip counts",od.total);
+	stats.report("writing the output");
+	
+	return 0;
+}
+
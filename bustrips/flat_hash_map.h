@@ -0,0 +1,326 @@
+/*  -*- C++ -*-
+ * flat_hash_map.h -- hash map with open addressing for 64-bit IDs and
+ * 	pairs of IDs
+ * 
+ * entries are stored in one array in the order they were inserted
+ * (iterating over the map follows this order); lookups use a separate
+ * index table with Robin Hood hashing, where each slot has 8 bytes (32
+ * bits of the hash and the position of the entry); compared to
+ * std::unordered_map, this avoids a memory allocation for each entry
+ * and most of the pointer chasing on lookups
+ * 
+ * differences from std::unordered_map:
+ *  - elements cannot be erased (only clear() is supported)
+ *  - inserting may invalidate iterators and references to elements
+ *  - at most 2^32 - 1 elements can be stored
+ * 
+ * after a map is built, freeze() can be called to release unused memory
+ * and mark it read-only; any later modification throws std::logic_error
+ * (read-only access is safe from multiple threads, as for std containers)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef FLAT_HASH_MAP_H
+#define FLAT_HASH_MAP_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+#include <array>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------
+ * pair_hash: combine the hash of two 64-bit unsigned integers
+ * 
+ * adapted from Murmurhash, from
+ * https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
+ * MurmurHash2, 64-bit versions, by Austin Appleby
+ * 64-bit hash for 64-bit platforms
+ * 
+ * MurmurHash2 was written by Austin Appleby, and is placed in the public
+ * domain. The author hereby disclaims copyright to this source code.
+*/
+struct pair_hash {
+	uint64_t seed;
+	explicit pair_hash(uint64_t s = 0xe6573480bcc4fceaUL) : seed(s) { }
+	uint64_t operator () (const std::pair<uint64_t,uint64_t>& p) const {
+		
+		const uint64_t m = 0xc6a4a7935bd1e995UL;
+		const int r = 47;
+		uint64_t h = seed ^ (16UL * m); /* 16UL since we have 16 bytes in total */
+		
+		const std::array<uint64_t,2> a = {p.first, p.second};
+		for(uint64_t k : a) {
+			k *= m; 
+			k ^= k >> r; 
+			k *= m; 
+			
+			h ^= k;
+			h *= m; 
+		}
+		
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+		
+		return h;
+	}
+};
+
+/* hash of one 64-bit integer: finalizer of MurmurHash3 (by Austin Appleby,
+ * public domain); this is needed since IDs are often sequential and the
+ * low bits of the hash are used to select a slot */
+struct id_hash {
+	uint64_t operator () (uint64_t k) const {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdUL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53UL;
+		k ^= k >> 33;
+		return k;
+	}
+};
+
+/* default hash functions for the supported key types */
+template<class K> struct flat_hash { };
+template<> struct flat_hash<uint64_t> : public id_hash { };
+template<> struct flat_hash<std::pair<uint64_t,uint64_t> > : public pair_hash { };
+
+
+template<class K, class V, class H = flat_hash<K> >
+class flat_hash_map {
+	public:
+		typedef K key_type;
+		typedef V mapped_type;
+		typedef std::pair<K,V> value_type; /* note: the key should not be modified */
+		typedef typename std::vector<value_type>::iterator iterator;
+		typedef typename std::vector<value_type>::const_iterator const_iterator;
+	
+	protected:
+		std::vector<value_type> entries; /* elements in the order of insertion */
+		/* index: each slot has the upper 32 bits of the hash and the
+		 * position of the entry + 1 in the lower 32 bits (0 for empty slots);
+		 * the preferred position of an entry is given by the hash bits */
+		std::vector<uint64_t> slots;
+		uint64_t mask; /* number of slots - 1 */
+		bool frozen;
+		H hash;
+		
+		/* maximum load factor: 7/8 */
+		static size_t max_elements(size_t nslots) { return nslots - nslots / 8; }
+		static uint32_t slot_hash(uint64_t h) { return (uint32_t)(h >> 32); }
+		
+		/* find the slot of a key; returns the index of the entry or -1 */
+		size_t find_index(const K& k, uint32_t h) const {
+			if(slots.empty()) return (size_t)-1;
+			uint64_t pos = h & mask;
+			for(uint64_t dist = 0;;dist++) {
+				uint64_t s = slots[pos];
+				if(!s) return (size_t)-1;
+				uint32_t h2 = (uint32_t)(s >> 32);
+				/* Robin Hood invariant: the key would have replaced any entry
+				 * that is closer to its preferred position */
+				if(((pos - h2) & mask) < dist) return (size_t)-1;
+				if(h2 == h) {
+					size_t i = (uint32_t)s - 1;
+					if(entries[i].first == k) return i;
+				}
+				pos = (pos + 1) & mask;
+			}
+		}
+		
+		/* add a slot for the entry at position i (it is not in the table yet) */
+		void insert_slot(uint32_t h, size_t i) {
+			uint64_t s = (((uint64_t)h) << 32) | (uint64_t)(i + 1);
+			uint64_t pos = h & mask;
+			for(uint64_t dist = 0;;dist++) {
+				uint64_t s2 = slots[pos];
+				if(!s2) {
+					slots[pos] = s;
+					return;
+				}
+				uint64_t dist2 = (pos - (s2 >> 32)) & mask;
+				if(dist2 < dist) {
+					/* take this slot, continue with the displaced one */
+					slots[pos] = s;
+					s = s2;
+					dist = dist2;
+				}
+				pos = (pos + 1) & mask;
+			}
+		}
+		
+		/* rebuild the index with the given number of slots (power of two) */
+		void rehash(size_t nslots) {
+			slots.assign(nslots,0);
+			mask = nslots - 1;
+			for(size_t i=0;i<entries.size();i++) insert_slot(slot_hash(hash(entries[i].first)),i);
+		}
+		
+		void check_frozen() const {
+			if(frozen) throw std::logic_error("flat_hash_map: modifying a frozen map");
+		}
+		
+		/* make sure that n elements fit in the index */
+		void grow(size_t n) {
+			if(n >= (size_t)UINT32_MAX) throw std::length_error("flat_hash_map: too many elements");
+			size_t nslots = slots.size() ? slots.size() : 16;
+			while(max_elements(nslots) < n) nslots *= 2;
+			if(nslots != slots.size()) rehash(nslots);
+		}
+		
+		/* add a new element without checking if it exists (h is the hash of k) */
+		template<class... Args>
+		iterator insert_new(uint32_t h, Args&&... args) {
+			grow(entries.size() + 1);
+			entries.emplace_back(std::forward<Args>(args)...);
+			insert_slot(h,entries.size() - 1);
+			return entries.end() - 1;
+		}
+		
+	public:
+		flat_hash_map():mask(0),frozen(false) { }
+		
+		size_t size() const { return entries.size(); }
+		bool empty() const { return entries.empty(); }
+		bool is_frozen() const { return frozen; }
+		
+		iterator begin() { return entries.begin(); }
+		iterator end() { return entries.end(); }
+		const_iterator begin() const { return entries.cbegin(); }
+		const_iterator end() const { return entries.cend(); }
+		const_iterator cbegin() const { return entries.cbegin(); }
+		const_iterator cend() const { return entries.cend(); }
+		
+		/* remove all elements (keeps the allocated memory for reuse) */
+		void clear() {
+			entries.clear();
+			std::fill(slots.begin(),slots.end(),0);
+			frozen = false;
+		}
+		
+		/* reserve space for n elements */
+		void reserve(size_t n) {
+			check_frozen();
+			entries.reserve(n);
+			grow(n);
+		}
+		
+		iterator find(const K& k) {
+			size_t i = find_index(k,slot_hash(hash(k)));
+			return (i == (size_t)-1) ? entries.end() : entries.begin() + i;
+		}
+		const_iterator find(const K& k) const {
+			size_t i = find_index(k,slot_hash(hash(k)));
+			return (i == (size_t)-1) ? entries.cend() : entries.cbegin() + i;
+		}
+		size_t count(const K& k) const { return (find_index(k,slot_hash(hash(k))) == (size_t)-1) ? 0 : 1; }
+		
+		V& at(const K& k) {
+			size_t i = find_index(k,slot_hash(hash(k)));
+			if(i == (size_t)-1) throw std::out_of_range("flat_hash_map::at()");
+			return entries[i].second;
+		}
+		const V& at(const K& k) const {
+			size_t i = find_index(k,slot_hash(hash(k)));
+			if(i == (size_t)-1) throw std::out_of_range("flat_hash_map::at()");
+			return entries[i].second;
+		}
+		
+		/* insert an element if the key does not exist yet; returns an
+		 * iterator to the element with the key and true if it was inserted */
+		std::pair<iterator,bool> insert(const value_type& x) {
+			uint32_t h = slot_hash(hash(x.first));
+			size_t i = find_index(x.first,h);
+			if(i != (size_t)-1) return std::make_pair(entries.begin() + i,false);
+			check_frozen();
+			return std::make_pair(insert_new(h,x),true);
+		}
+		std::pair<iterator,bool> insert(value_type&& x) {
+			uint32_t h = slot_hash(hash(x.first));
+			size_t i = find_index(x.first,h);
+			if(i != (size_t)-1) return std::make_pair(entries.begin() + i,false);
+			check_frozen();
+			return std::make_pair(insert_new(h,std::move(x)),true);
+		}
+		
+		V& operator [] (const K& k) {
+			uint32_t h = slot_hash(hash(k));
+			size_t i = find_index(k,h);
+			if(i != (size_t)-1) return entries[i].second;
+			check_frozen();
+			return insert_new(h,k,V())->second;
+		}
+		
+		/* insert all elements in [first,last) (ones with existing keys are
+		 * skipped, as with insert()) */
+		template<class It>
+		void insert(It first, It last) {
+			check_frozen();
+			size_t n = std::distance(first,last);
+			reserve(size() + n);
+			for(;first != last;++first) insert(*first);
+		}
+		
+		/* build the map from the given elements, replacing the current contents */
+		template<class It>
+		void build(It first, It last) {
+			clear();
+			insert(first,last);
+		}
+		
+		/* release unused memory and mark the map read-only */
+		void freeze() {
+			entries.shrink_to_fit();
+			size_t nslots = 16;
+			while(max_elements(nslots) < entries.size()) nslots *= 2;
+			if(nslots != slots.size()) {
+				std::vector<uint64_t>().swap(slots);
+				rehash(nslots);
+			}
+			frozen = true;
+		}
+		
+		/* memory used by the map (not including memory allocated by the
+		 * keys or values themselves) */
+		size_t memory_usage() const {
+			return entries.capacity() * sizeof(value_type) + slots.capacity() * sizeof(uint64_t);
+		}
+};
+
+#endif
+
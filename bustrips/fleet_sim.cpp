@@ -0,0 +1,590 @@
+/*
+ * fleet_sim.cpp -- event-driven simulation of a fleet of vehicles serving
+ * 	a set of trips, with dispatch to the nearest idle vehicle
+ * 
+ * trips are read in the format of sample_trips3 or the bike trip files
+ * (trip ID, other ID, start time, end time, start node, start distance,
+ * end node, ...); each trip is a request at its start time; it is assigned
+ * to the nearest idle vehicle (by the distance from the vehicle to the start
+ * node), which travels there, picks up the passenger and travels to the end
+ * node, where it becomes idle again; if there is no idle vehicle, requests
+ * wait in a queue and are assigned in the order of their start time to the
+ * vehicles that become idle (requests that waited more than -W seconds
+ * without a vehicle are dropped); travel times are calculated from the
+ * distances among the nodes (see distances.h) and the vehicle speed
+ * 
+ * events (requests, pickups and drop-offs) are processed in time order,
+ * using a radix heap with times in milliseconds; vehicles are stored as
+ * separate arrays of their properties; idle vehicles are indexed by their
+ * node, finding the nearest one to a request is done by a dispatch policy:
+ * 	-P list (default): for each start node, the list of the -K nearest
+ * 		nodes (among all nodes of the trips) is precomputed; these are
+ * 		checked in order, and the first one with an idle vehicle is the
+ * 		nearest; if there is none, all nodes with idle vehicles are checked
+ * 	-P scan: all nodes with idle vehicles are checked for each request
+ * both give the same result (ties are broken by the order of the nodes)
+ * 
+ * output: for each trip served (-o), trip ID, vehicle, start time, pickup
+ * time, drop-off time and waiting time; for each vehicle (-u), number of
+ * trips, time spent traveling with and without passenger and the share of
+ * these of the whole simulation (from the first request to the last
+ * drop-off); a summary is written to stderr
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+#include "distances.h"
+#include "bike_trips.h"
+#include "stage_timer.h"
+#include "trip_inputs.h"
+#include "radix_heap.h"
+
+
+static const uint32_t sim_none = (uint32_t)-1;
+
+/* one trip, times are in milliseconds */
+struct sim_trip {
+	uint64_t ts; /* request (start) time */
+	uint64_t t; /* travel time */
+	uint32_t o, d; /* start and end nodes (indices in sim_nodes) */
+	uint32_t idx; /* index of the trip in the input */
+};
+
+/* nodes of the trips, with their index in the distance matrix */
+struct sim_nodes {
+	const distances& dists;
+	std::vector<uint32_t> idx; /* index in the distance matrix */
+	double v; /* speed, in m/s */
+	
+	size_t size() const { return idx.size(); }
+	double dist(uint32_t x, uint32_t y) const { return dists.get_dist_idx(idx[x],idx[y]); }
+	/* travel time in milliseconds, or UINT64_MAX if there is no path */
+	uint64_t travel_time(double d) const { return (d < INFINITY) ? (uint64_t)llround(1000.0 * d / v) : UINT64_MAX; }
+};
+
+/* vehicles, stored as a separate array for each property */
+struct sim_vehicles {
+	std::vector<uint32_t> node; /* current node, or the end of the current trip */
+	std::vector<uint32_t> trip; /* current trip (index in the sorted trips) or sim_none */
+	std::vector<uint32_t> ntrips; /* number of trips served */
+	std::vector<uint64_t> loaded; /* time spent with passengers */
+	std::vector<uint64_t> empty; /* time spent traveling to the passengers */
+	
+	void resize(size_t n) {
+		node.resize(n);
+		trip.assign(n,sim_none);
+		ntrips.assign(n,0);
+		loaded.assign(n,0);
+		empty.assign(n,0);
+	}
+	size_t size() const { return node.size(); }
+	size_t memory_usage() const {
+		return mem_size(node) + mem_size(trip) + mem_size(ntrips) + mem_size(loaded) + mem_size(empty);
+	}
+};
+
+/* idle vehicles, grouped by their node; derived classes implement the
+ * search for the nearest one */
+class sim_idle_vehicles {
+	protected:
+		const sim_nodes& nodes;
+		std::vector<std::vector<uint32_t> > at; /* idle vehicles at each node */
+		std::vector<uint32_t> pos; /* position of each idle vehicle in its list */
+		std::vector<uint32_t> vnode; /* node of each idle vehicle */
+		std::vector<uint32_t> occupied; /* nodes with idle vehicles */
+		std::vector<uint32_t> occ_pos; /* position of each node in occupied */
+		
+		/* nearest node with idle vehicles, checking all of them; ties are
+		 * broken by the node index; returns sim_none if there is no
+		 * vehicle that can reach the given node */
+		uint32_t nearest_scan(uint32_t n) const {
+			uint32_t best = sim_none;
+			double bd = INFINITY;
+			for(uint32_t x : occupied) {
+				double d = nodes.dist(x,n);
+				if(d < bd || (d == bd && best != sim_none && x < best)) {
+					bd = d;
+					best = x;
+				}
+			}
+			return best;
+		}
+		
+	public:
+		explicit sim_idle_vehicles(const sim_nodes& nodes_, size_t nveh) : nodes(nodes_),
+			at(nodes_.size()), pos(nveh,sim_none), vnode(nveh,sim_none), occ_pos(nodes_.size(),sim_none) { }
+		virtual ~sim_idle_vehicles() { }
+		
+		bool empty() const { return occupied.empty(); }
+		
+		void add(uint32_t v, uint32_t n) {
+			if(at[n].empty()) {
+				occ_pos[n] = occupied.size();
+				occupied.push_back(n);
+			}
+			pos[v] = at[n].size();
+			vnode[v] = n;
+			at[n].push_back(v);
+		}
+		
+		void remove(uint32_t v) {
+			uint32_t n = vnode[v];
+			std::vector<uint32_t>& a = at[n];
+			uint32_t v2 = a.back();
+			a[pos[v]] = v2;
+			pos[v2] = pos[v];
+			a.pop_back();
+			pos[v] = sim_none;
+			vnode[v] = sim_none;
+			if(a.empty()) {
+				uint32_t n2 = occupied.back();
+				occupied[occ_pos[n]] = n2;
+				occ_pos[n2] = occ_pos[n];
+				occupied.pop_back();
+				occ_pos[n] = sim_none;
+			}
+		}
+		
+		/* nearest node with idle vehicles to node n, or sim_none */
+		virtual uint32_t nearest_node(uint32_t n) = 0;
+		
+		/* nearest idle vehicle to node n (the last one added among the ones
+		 * at the nearest node), or sim_none */
+		uint32_t nearest(uint32_t n) {
+			uint32_t x = nearest_node(n);
+			return (x == sim_none) ? sim_none : at[x].back();
+		}
+		
+		virtual size_t memory_usage() const {
+			size_t s = mem_size(pos) + mem_size(vnode) + mem_size(occupied) + mem_size(occ_pos) + mem_size(at);
+			for(const auto& a : at) s += mem_size(a);
+			return s;
+		}
+};
+
+/* checking all nodes with idle vehicles */
+class sim_idle_scan : public sim_idle_vehicles {
+	public:
+		sim_idle_scan(const sim_nodes& nodes_, size_t nveh) : sim_idle_vehicles(nodes_,nveh) { }
+		uint32_t nearest_node(uint32_t n) override { return nearest_scan(n); }
+};
+
+/* using the lists of nearest nodes */
+class sim_idle_lists : public sim_idle_vehicles {
+	protected:
+		size_t k; /* length of the lists */
+		std::vector<uint32_t> list_start; /* start of the list of each node (or sim_none if not a start node) */
+		std::vector<uint32_t> lists; /* nearest nodes, ordered by distance, then node index */
+		
+	public:
+		uint64_t fallback = 0; /* number of times all nodes had to be checked */
+		
+		sim_idle_lists(const sim_nodes& nodes_, size_t nveh) : sim_idle_vehicles(nodes_,nveh), k(0) { }
+		
+		/* create the lists for the given start nodes, using multiple threads */
+		void create(const std::vector<uint32_t>& starts, size_t k_, unsigned int nthreads) {
+			size_t nn = nodes.size();
+			k = std::min(k_,nn);
+			list_start.assign(nn,sim_none);
+			for(size_t i=0;i<starts.size();i++) list_start[starts[i]] = i*k;
+			lists.assign(starts.size()*k,sim_none);
+			std::atomic<size_t> next(0);
+			auto worker = [&]() {
+				std::vector<std::pair<size_t,size_t> > q(nn);
+				std::vector<double> d(nn);
+				std::vector<std::pair<double,uint32_t> > tmp(nn);
+				while(true) {
+					size_t i = next++;
+					if(i >= starts.size()) break;
+					uint32_t s = starts[i];
+					for(size_t x=0;x<nn;x++) q[x] = std::make_pair(nodes.idx[x],nodes.idx[s]);
+					nodes.dists.get_dists_idx(q.data(),nn,d.data());
+					for(size_t x=0;x<nn;x++) tmp[x] = std::make_pair(d[x],(uint32_t)x);
+					std::partial_sort(tmp.begin(),tmp.begin() + k,tmp.end());
+					for(size_t x=0;x<k;x++) if(tmp[x].first < INFINITY) lists[i*k + x] = tmp[x].second;
+				}
+			};
+			std::vector<std::thread> threads;
+			for(unsigned int j=1;j<nthreads;j++) threads.emplace_back(worker);
+			worker();
+			for(auto& t : threads) t.join();
+		}
+		
+		uint32_t nearest_node(uint32_t n) override {
+			if(occupied.empty()) return sim_none;
+			const uint32_t* l = lists.data() + list_start[n];
+			for(size_t x=0;x<k && l[x] != sim_none;x++) if(at[l[x]].size()) return l[x];
+			/* not found among the nearest nodes (or there are unreachable nodes) */
+			fallback++;
+			return nearest_scan(n);
+		}
+		
+		size_t memory_usage() const override {
+			return sim_idle_vehicles::memory_usage() + mem_size(list_start) + mem_size(lists);
+		}
+};
+
+/* events: type in the lower 2 bits, trip or vehicle index in the rest */
+enum sim_event_type { EV_REQUEST = 0, EV_PICKUP = 1, EV_DROPOFF = 2 };
+
+/* the simulation */
+struct sim_state {
+	const std::vector<sim_trip>& trips; /* sorted by start time */
+	const sim_nodes& nodes;
+	sim_vehicles& veh;
+	sim_idle_vehicles& idle;
+	radix_heap<uint32_t> events;
+	std::deque<uint32_t> waiting; /* requests without a vehicle */
+	uint64_t max_wait; /* max. time to wait for a vehicle, in ms */
+	
+	std::vector<uint32_t> trip_vehicle; /* vehicle of each trip (or sim_none) */
+	std::vector<uint64_t> pickup; /* pickup time of each trip */
+	uint64_t nevents = 0;
+	uint64_t rejected = 0;
+	uint64_t end = 0; /* time of the last event */
+	
+	sim_state(const std::vector<sim_trip>& trips_, const sim_nodes& nodes_, sim_vehicles& veh_,
+			sim_idle_vehicles& idle_, uint64_t max_wait_) : trips(trips_), nodes(nodes_), veh(veh_),
+			idle(idle_), max_wait(max_wait_), trip_vehicle(trips_.size(),sim_none), pickup(trips_.size(),0) { }
+	
+	void push(uint64_t t, uint32_t id, sim_event_type type) { events.push(t,(id << 2) | type); }
+	
+	/* assign trip k to vehicle v at time now; returns false if the
+	 * vehicle cannot reach the start of the trip */
+	bool assign(uint32_t v, uint32_t k, uint64_t now) {
+		uint64_t t = nodes.travel_time(nodes.dist(veh.node[v],trips[k].o));
+		if(t == UINT64_MAX) return false;
+		veh.trip[v] = k;
+		veh.empty[v] += t;
+		trip_vehicle[k] = v;
+		push(now + t,v,EV_PICKUP);
+		return true;
+	}
+	
+	void run() {
+		if(trips.empty()) return;
+		push(trips[0].ts,0,EV_REQUEST);
+		while(!events.empty()) {
+			auto e = events.pop();
+			uint64_t now = e.first;
+			uint32_t id = e.second >> 2;
+			nevents++;
+			end = now;
+			switch(e.second & 3) {
+				case EV_REQUEST:
+					{
+						if(id + 1 < trips.size()) push(trips[id+1].ts,id+1,EV_REQUEST);
+						const sim_trip& tr = trips[id];
+						if(tr.t == UINT64_MAX) {
+							rejected++; /* no path from the start to the end */
+							break;
+						}
+						uint32_t v = idle.nearest(tr.o);
+						if(v != sim_none) {
+							idle.remove(v);
+							assign(v,id,now);
+						}
+						else waiting.push_back(id);
+					}
+					break;
+				case EV_PICKUP:
+					{
+						uint32_t k = veh.trip[id];
+						pickup[k] = now;
+						veh.loaded[id] += trips[k].t;
+						veh.node[id] = trips[k].d;
+						push(now + trips[k].t,id,EV_DROPOFF);
+					}
+					break;
+				case EV_DROPOFF:
+					veh.trip[id] = sim_none;
+					veh.ntrips[id]++;
+					/* serve the first waiting request (dropping the ones
+					 * that waited too long or cannot be reached) */
+					while(waiting.size()) {
+						uint32_t k = waiting.front();
+						waiting.pop_front();
+						if(now - trips[k].ts > max_wait || !assign(id,k,now)) rejected++;
+						else break;
+					}
+					if(veh.trip[id] == sim_none) idle.add(id,veh.node[id]);
+					break;
+			}
+		}
+		rejected += waiting.size();
+		waiting.clear();
+	}
+	
+	size_t memory_usage() const {
+		return events.memory_usage() + mem_size(trip_vehicle) + mem_size(pickup) + waiting.size()*sizeof(uint32_t);
+	}
+};
+
+
+int main(int argc, char **argv)
+{
+	trip_inputs inputs; /* trips, distances (-i, -d, -I, --edges, --dist-cache) and --timing */
+	const char* out_fn = 0; /* output: trips served */
+	const char* veh_fn = 0; /* output: vehicles */
+	size_t nveh = 0; /* number of vehicles */
+	double vkmh = 20.0; /* speed of the vehicles, in km/h */
+	double max_wait = -1.0; /* maximum time to wait for a vehicle, in seconds (no limit if < 0) */
+	const char* policy = "list"; /* dispatch method */
+	size_t list_len = 64; /* length of the lists of nearest nodes */
+	uint64_t seed = 0; /* random seed for the initial positions of the vehicles */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use (for preparing the data) */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(inputs.parse_option(argv,i)) continue;
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'o':
+				out_fn = argv[i+1];
+				i++;
+				break;
+			case 'u':
+				veh_fn = argv[i+1];
+				i++;
+				break;
+			case 'n':
+				nveh = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'v':
+				vkmh = atof(argv[i+1]);
+				i++;
+				break;
+			case 'W':
+				max_wait = atof(argv[i+1]);
+				i++;
+				break;
+			case 'P':
+				policy = argv[i+1];
+				i++;
+				break;
+			case 'K':
+				list_len = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 's':
+				seed = strtoull(argv[i+1],0,10);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!inputs.check()) return 1;
+	if(nveh == 0 || nveh >= (1UL << 30)) {
+		fprintf(stderr,"Error: invalid number of vehicles!\n");
+		return 1;
+	}
+	if(!(vkmh > 0.0)) {
+		fprintf(stderr,"Error: invalid speed!\n");
+		return 1;
+	}
+	bool use_lists = !strcmp(policy,"list");
+	if(!use_lists && strcmp(policy,"scan")) {
+		fprintf(stderr,"Error: unknown dispatch policy: %s!\n",policy);
+		return 1;
+	}
+	if(use_lists && list_len == 0) list_len = 1;
+	if(nthreads == 0) nthreads = 1;
+	stage_timer timer(inputs.timing);
+	
+	/* read the trips; start times are converted to milliseconds below,
+	 * stored as unsigned numbers */
+	std::vector<bike_trip> trips_in;
+	if(!inputs.read_trips(nthreads,1UL << 30,trips_in)) return 1;
+	size_t n = trips_in.size();
+	for(const bike_trip& t : trips_in) if(t.start_ts < 0) {
+		fprintf(stderr,"Error: negative start time for trip %lu!\n",t.trip_id);
+		return 1;
+	}
+	timer.stage("reading the trips");
+	
+	/* distances among the nodes of the trips */
+	distances dists;
+	if(!inputs.read_dists(trips_in,nthreads,dists)) return 1;
+	timer.stage("reading the distances");
+	
+	/* nodes of the trips, and the trips sorted by start time */
+	sim_nodes nodes{dists, std::vector<uint32_t>(), vkmh / 3.6};
+	std::vector<sim_trip> trips(n);
+	{
+		for(const bike_trip& t : trips_in) {
+			nodes.idx.push_back(dists.get_index(t.start_node));
+			nodes.idx.push_back(dists.get_index(t.end_node));
+		}
+		std::sort(nodes.idx.begin(),nodes.idx.end());
+		nodes.idx.erase(std::unique(nodes.idx.begin(),nodes.idx.end()),nodes.idx.end());
+		nodes.idx.shrink_to_fit();
+		auto node = [&](uint64_t id) {
+			return (uint32_t)(std::lower_bound(nodes.idx.begin(),nodes.idx.end(),dists.get_index(id)) - nodes.idx.begin());
+		};
+		std::vector<std::pair<size_t,size_t> > q(n);
+		std::vector<double> d(n);
+		for(size_t i=0;i<n;i++) {
+			const bike_trip& t = trips_in[i];
+			trips[i].ts = (uint64_t)llround(1000.0 * t.start_ts);
+			trips[i].o = node(t.start_node);
+			trips[i].d = node(t.end_node);
+			trips[i].idx = i;
+			q[i] = std::make_pair(nodes.idx[trips[i].o],nodes.idx[trips[i].d]);
+		}
+		dists.get_dists_idx(q.data(),n,d.data());
+		for(size_t i=0;i<n;i++) trips[i].t = nodes.travel_time(d[i]);
+	}
+	std::vector<uint64_t> trip_ids(n);
+	for(size_t i=0;i<n;i++) trip_ids[i] = trips_in[i].trip_id;
+	trips_in.clear();
+	trips_in.shrink_to_fit();
+	std::stable_sort(trips.begin(),trips.end(),[](const sim_trip& a, const sim_trip& b) { return a.ts < b.ts; });
+	
+	/* vehicles start at the start of random trips */
+	sim_vehicles veh;
+	veh.resize(nveh);
+	std::unique_ptr<sim_idle_vehicles> idle;
+	if(use_lists) {
+		sim_idle_lists* l = new sim_idle_lists(nodes,nveh);
+		idle.reset(l);
+		std::vector<uint32_t> starts;
+		for(const sim_trip& t : trips) starts.push_back(t.o);
+		std::sort(starts.begin(),starts.end());
+		starts.erase(std::unique(starts.begin(),starts.end()),starts.end());
+		l->create(starts,list_len,nthreads);
+	}
+	else idle.reset(new sim_idle_scan(nodes,nveh));
+	if(n) {
+		std::mt19937_64 rng(seed);
+		std::uniform_int_distribution<size_t> dst(0,n-1);
+		for(size_t v=0;v<nveh;v++) {
+			veh.node[v] = trips[dst(rng)].o;
+			idle->add(v,veh.node[v]);
+		}
+	}
+	timer.stage("preparing the simulation");
+	stats.add("trips",trips);
+	stats.add("trip IDs",trip_ids);
+	stats.add("nodes",nodes.idx);
+	stats.add("vehicles",veh);
+	stats.add("idle vehicles",*idle);
+	dists.add_mem_stats(stats);
+	stats.report("preparing the simulation");
+	
+	/* run the simulation */
+	uint64_t max_wait_ms = (max_wait < 0.0) ? UINT64_MAX : (uint64_t)llround(1000.0 * max_wait);
+	sim_state sim(trips,nodes,veh,*idle,max_wait_ms);
+	struct timespec t1, t2;
+	clock_gettime(CLOCK_MONOTONIC,&t1);
+	sim.run();
+	clock_gettime(CLOCK_MONOTONIC,&t2);
+	double dt = (t2.tv_sec - t1.tv_sec) + (t2.tv_nsec - t1.tv_nsec) / 1e9;
+	timer.stage("simulation");
+	
+	/* summary */
+	std::vector<double> waits;
+	for(size_t k=0;k<n;k++) if(sim.trip_vehicle[k] != sim_none) waits.push_back((sim.pickup[k] - trips[k].ts) / 1000.0);
+	std::sort(waits.begin(),waits.end());
+	double sum = 0.0;
+	for(double w : waits) sum += w;
+	fprintf(stderr,"%lu trips served, %lu dropped\n",waits.size(),sim.rejected);
+	if(waits.size()) fprintf(stderr,"waiting time: mean %f, median %f, 90%% %f, max %f\n",sum / waits.size(),
+		waits[waits.size()/2],waits[(size_t)(0.9 * (waits.size()-1))],waits.back());
+	fprintf(stderr,"%lu events in %f s (%f million events / s)\n",sim.nevents,dt,sim.nevents / dt / 1e6);
+	if(use_lists) fprintf(stderr,"all nodes checked for %lu requests\n",((sim_idle_lists*)idle.get())->fallback);
+	stats.add("trips",trips);
+	stats.add("simulation",sim);
+	stats.add("vehicles",veh);
+	stats.add("idle vehicles",*idle);
+	stats.report("simulation");
+	
+	/* write the outputs */
+	if(out_fn) {
+		write_table w(out_fn);
+		for(size_t k=0;k<n;k++) if(sim.trip_vehicle[k] != sim_none) {
+			uint64_t p = sim.pickup[k];
+			w.write_row(trip_ids[trips[k].idx],sim.trip_vehicle[k],trips[k].ts / 1000.0,p / 1000.0,
+				(p + trips[k].t) / 1000.0,(p - trips[k].ts) / 1000.0);
+		}
+		if(!w.close()) {
+			fprintf(stderr,"Error writing file %s!\n",out_fn);
+			return 1;
+		}
+	}
+	if(veh_fn) {
+		double total = n ? (sim.end - trips[0].ts) / 1000.0 : 0.0;
+		write_table w(veh_fn);
+		for(size_t v=0;v<nveh;v++) {
+			double l = veh.loaded[v] / 1000.0;
+			double e = veh.empty[v] / 1000.0;
+			w.write_row(v,veh.ntrips[v],l,e,(total > 0.0) ? (l + e) / total : 0.0);
+		}
+		if(!w.close()) {
+			fprintf(stderr,"Error writing file %s!\n",veh_fn);
+			return 1;
+		}
+	}
+	timer.stage("writing the output");
+	timer.report();
+	dists.report_cache();
+	return 0;
+}
+
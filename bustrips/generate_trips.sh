@@ -4,24 +4,21 @@
 # script to generate SRSPMD trips based on bus trip data
 
 # 0. compile C++ code used in this script
-# code in this repository
-g++ -o nd nodes_distances.cpp -O3 -march=native -std=gnu++11
-g++ -o st3 sample_trips3.cpp -O3 -march=native -std=gnu++11
-g++ -o dm dist_matrix.cpp -O3 -march=native -std=gnu++11
-
-# code needed to extract trips
-git clone https://github.com/dkondor/join-utils.git
-cd join-utils
-g++ -o hashjoin hashjoin.cpp -O3 -march=native -std=gnu++11
-cd ..
-
-# 1. extract trips 
-zcat origin_destination_bus_201901.zip | tail -n +2 | awk -F, '{if($2 == "WEEKDAY") print $3,$5,$6,$7;}' > bustrips_all_weekday.dat
-# 1.1. filter trips to only include ones from Toa Payoh
-# this uses the hashjoin program from here: https://github.com/dkondor/join-utils
-# alternatively, you could sort the files and use the standard join program
-tail -n +2 busstops_toa_payoh.csv | cut -d , -f 1 | join-utils/hashjoin -1 1 -2 2 -o1 "" - bustrips_all_weekday.dat > bustrips_all_weekday_tmp1.dat
-tail -n +2 busstops_toa_payoh.csv | cut -d , -f 1 | join-utils/hashjoin -1 1 -2 3 -o1 "" - bustrips_all_weekday_tmp1.dat > bustrips_toa_payoh_weekday.dat
+# code in this repository (with -DREAD_TABLE_ZLIB, gzip and zip input files can be
+# given directly, e.g. ./dm -i toa_payoh_paths_nodes_distances.dat.gz)
+g++ -o nd nodes_distances.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o st3 sample_trips3.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o dm dist_matrix.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o et extract_trips.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o sn shareability.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o mf min_fleet.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+g++ -o fsim fleet_sim.cpp -O3 -march=native -std=gnu++11 -pthread -DREAD_TABLE_ZLIB -lz
+
+# 1. extract weekday trips among bus stops in Toa Payoh, aggregated by pairs of
+# bus stops (after merging the ones in busstops_matches.dat) and hours
+./et -i origin_destination_bus_201901.zip -s busstops_toa_payoh.csv -p busstops_matches.dat -d WEEKDAY -o bustrips_toa_payoh_weekday.dat
+# 1.1. (optional) the same in binary format, can be given to st3 with -i instead
+./et -i origin_destination_bus_201901.zip -s busstops_toa_payoh.csv -p busstops_matches.dat -d WEEKDAY -b bustrips_toa_payoh_weekday.bin
 
 
 # 2. calculate distances among OSM nodes
@@ -45,6 +42,43 @@ s=1 # random seed to use
 # 3.2. using the distances in binary format
 ./st3 -N $nt -D $R -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -i bustrips_toa_payoh_weekday.dat -s $s -b toa_payoh_buildings_osm_center_busstops.csv -B toa_payoh_buildings_osm_center_filtered.csv -n toa_payoh_buildings_osm_center_nodes.csv -p busstops_matches.dat -c trips_coords_R"$R"_N"$nt"_s$s.csv > trips_R"$R"_N"$nt"_s$s.dat
 
-
-
-
+# 3.3. multiple parameter combinations in one run (inputs are loaded only once)
+# -N, -D, -s and -v accept comma-separated lists and start:end[:step] ranges;
+# output file names are given as templates where %N, %R, %s and %v are replaced
+# by the parameter values; combinations are processed in parallel with -t
+./st3 -N 1000,5000 -D 1000:3000:500 -s 1:10 -t 4 -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -i bustrips_toa_payoh_weekday.dat -b toa_payoh_buildings_osm_center_busstops.csv -B toa_payoh_buildings_osm_center_filtered.csv -n toa_payoh_buildings_osm_center_nodes.csv -p busstops_matches.dat -c trips_coords_R%R_N%N_s%s.csv -o trips_R%R_N%N_s%s.dat
+
+# 3.4. save all preprocessed data in a binary snapshot that later runs can load
+# directly without reading the input files; input files given together with
+# --load-state are checked against the ones used to create the snapshot
+./st3 -N $nt -D $R -s $s -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -i bustrips_toa_payoh_weekday.dat -b toa_payoh_buildings_osm_center_busstops.csv -B toa_payoh_buildings_osm_center_filtered.csv -n toa_payoh_buildings_osm_center_nodes.csv -p busstops_matches.dat --save-state toa_payoh_state.bin > /dev/null
+./st3 --load-state toa_payoh_state.bin -N $nt -D $R -s $s -c trips_coords_R"$R"_N"$nt"_s$s.csv > trips_R"$R"_N"$nt"_s$s.dat
+
+# 3.5. all steps in one run: trips are aggregated from the original data and
+# distances are calculated among the nodes of the buildings in memory (without
+# the files created in steps 1 and 2); the distance matrix can be saved and
+# given with -d and -I in later runs; --timing shows the time of each stage
+./st3 -N $nt -D $R -s $s --od origin_destination_bus_201901.zip --stops busstops_toa_payoh.csv --day-type WEEKDAY --edges toa_payoh_paths_edges.dat -b toa_payoh_buildings_osm_center_busstops.csv -B toa_payoh_buildings_osm_center_filtered.csv -n toa_payoh_buildings_osm_center_nodes.csv -p busstops_matches.dat --save-dists toa_payoh_buildings_nodes_distances.bin --save-dists-ids toa_payoh_buildings_nodes_distances_ids.dat --timing -c trips_coords_R"$R"_N"$nt"_s$s.csv > trips_R"$R"_N"$nt"_s$s.dat
+
+# 3.6. distances can be also calculated only when needed (searches stop at the
+# maximum distance), keeping at most the given MB of rows in memory; calculated
+# rows can be saved in a file and reused in later runs (with the same -D or less)
+./st3 -N $nt -D $R -s $s -i bustrips_toa_payoh_weekday.dat --edges toa_payoh_paths_edges.dat --dist-cache 256 --dist-cache-file toa_payoh_dist_rows.bin -b toa_payoh_buildings_osm_center_busstops.csv -B toa_payoh_buildings_osm_center_filtered.csv -n toa_payoh_buildings_osm_center_nodes.csv -p busstops_matches.dat -c trips_coords_R"$R"_N"$nt"_s$s.csv > trips_R"$R"_N"$nt"_s$s.dat
+
+# 4. shareability network of the generated trips: pairs of trips that can be
+# served together by one vehicle (speed in km/h given with -v), with both
+# passengers arriving at most -T seconds later than when traveling alone;
+# the edges are written as pairs of trip IDs (-o) or in binary format (-b)
+./sn -i trips_R"$R"_N"$nt"_s$s.dat -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -v 20 -T 300 -o share_R"$R"_N"$nt"_s$s.dat
+
+# 5. minimum number of vehicles that can serve all generated trips, if
+# vehicles can relocate between trips (speed in km/h given with -v), with at
+# most -R seconds between the end of a trip and the start of the next one;
+# the number is printed, and the vehicle of each trip is written with -o
+./mf -i trips_R"$R"_N"$nt"_s$s.dat -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -v 20 -R 900 -o vehicles_R"$R"_N"$nt"_s$s.dat
+
+# 6. simulation of a given number of vehicles (-n) serving the generated trips,
+# each request is assigned to the nearest idle vehicle, or waits until one
+# becomes idle; writes the waiting time of each trip (-o) and the trips and
+# time spent traveling by each vehicle (-u), and a summary to stderr
+./fsim -i trips_R"$R"_N"$nt"_s$s.dat -d toa_payoh_paths_nodes_distances.bin -I toa_payoh_paths_nodes_distances_ids.dat -n 100 -v 20 -s 1 -o sim_trips_R"$R"_N"$nt"_s$s.dat -u sim_vehicles_R"$R"_N"$nt"_s$s.dat
@@ -0,0 +1,228 @@
+/*
+ * match_nodes.cpp -- match points (e.g. bus stops, buildings or trip start
+ * 	and end locations) to the nearest node(s) of the OSM network
+ * 
+ * nodes are read from a file with the columns ID, longitude, latitude
+ * (e.g. osm/sg_osm_nodes.dat); points are read from a table with an ID
+ * and coordinates in the columns given by -c (0-based indices of the ID,
+ * longitude and latitude), with the delimiter given by -d and optionally
+ * a header line to skip (-H); quotes around the IDs are removed
+ * 
+ * output has the columns point ID, node ID, distance (in meters), as in
+ * busstops_all_nodes.dat, or with -C, as a CSV file with the header
+ * InputID,TargetID,Distance (as toa_payoh_buildings_osm_center_nodes.csv);
+ * with -k, the k nearest nodes are written for each point (ordered by
+ * distance); with -D, only nodes within the given distance are considered
+ * 
+ * queries are run in parallel with -t threads (see node_index.h for the
+ * details of the search)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "read_table.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "node_index.h"
+
+
+int main(int argc, char **argv)
+{
+	const char* nodes_fn = 0; /* network nodes with coordinates */
+	const char* points_fn = 0; /* points to match (stdin if not given) */
+	const char* out_fn = 0; /* output (stdout if not given) */
+	char delim = 0; /* delimiter in the points file (default: tab or space) */
+	bool header = false; /* if true, the first line of the points file is skipped */
+	unsigned int cols[3] = {0, 1, 2}; /* columns of the ID, longitude and latitude */
+	size_t k = 1; /* number of nodes to find for each point */
+	double max_dist = 0.0; /* if > 0, only nodes within this distance are considered */
+	bool csv = false; /* output in CSV format with a header */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'n':
+				nodes_fn = argv[i+1];
+				i++;
+				break;
+			case 'i':
+				points_fn = argv[i+1];
+				i++;
+				break;
+			case 'o':
+				out_fn = argv[i+1];
+				i++;
+				break;
+			case 'd':
+				delim = argv[i+1][0];
+				i++;
+				break;
+			case 'H':
+				header = true;
+				break;
+			case 'c':
+				if(sscanf(argv[i+1],"%u,%u,%u",cols,cols+1,cols+2) != 3) {
+					fprintf(stderr,"Invalid columns: %s!\n",argv[i+1]);
+					return 1;
+				}
+				i++;
+				break;
+			case 'k':
+				k = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'D':
+				max_dist = atof(argv[i+1]);
+				i++;
+				break;
+			case 'C':
+				csv = true;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!nodes_fn) {
+		fprintf(stderr,"Error: no network nodes given!\n");
+		return 1;
+	}
+	if(k == 0 || cols[0] == cols[1] || cols[0] == cols[2] || cols[1] == cols[2]) {
+		fprintf(stderr,"Error: invalid parameters!\n");
+		return 1;
+	}
+	if(nthreads == 0) nthreads = 1;
+	
+	node_index index;
+	if(!index.read_nodes(nodes_fn,0,nthreads)) return 1;
+	fprintf(stderr,"%lu nodes read\n",index.size());
+	stats.add("node index",index);
+	stats.report("reading the nodes");
+	
+	/* read the points */
+	std::vector<std::string> ids;
+	std::vector<double> lon, lat;
+	{
+		read_table2 rt(points_fn,stdin);
+		if(delim) rt.set_delim(delim);
+		if(header) rt.read_line();
+		unsigned int last = std::max(cols[0],std::max(cols[1],cols[2]));
+		while(rt.read_line()) {
+			std::string id;
+			double x = 0.0, y = 0.0;
+			bool ok = true;
+			for(unsigned int j=0;ok && j<=last;j++) {
+				if(j == cols[0]) ok = rt.read(id);
+				else if(j == cols[1]) ok = rt.read_double_limits(x,-180.0,180.0);
+				else if(j == cols[2]) ok = rt.read_double_limits(y,-90.0,90.0);
+				else ok = rt.read_skip();
+			}
+			if(!ok) break;
+			if(id.size() >= 2 && id.front() == '"' && id.back() == '"') id = id.substr(1,id.size() - 2);
+			ids.push_back(std::move(id));
+			lon.push_back(x);
+			lat.push_back(y);
+		}
+		if(rt.get_last_error() != T_EOF) {
+			fprintf(stderr,"Error reading points:\n");
+			rt.write_error(stderr);
+			return 1;
+		}
+	}
+	size_t n = ids.size();
+	fprintf(stderr,"%lu points read\n",n);
+	
+	/* queries in parallel, in blocks of points */
+	std::vector<node_index::result> res(n*k);
+	std::vector<uint32_t> nres(n,0);
+	std::atomic<size_t> next(0);
+	const size_t block = 1024;
+	auto worker = [&]() {
+		node_index::query_state s;
+		std::vector<node_index::result> r;
+		while(true) {
+			size_t i1 = block * (next++);
+			if(i1 >= n) break;
+			size_t i2 = std::min(n,i1 + block);
+			for(size_t i=i1;i<i2;i++) {
+				index.nearest(lon[i],lat[i],k,max_dist,s,r);
+				std::copy(r.begin(),r.end(),res.begin() + i*k);
+				nres[i] = r.size();
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int j=1;j<nthreads && j*block<n;j++) threads.emplace_back(worker);
+	worker();
+	for(auto& t : threads) t.join();
+	stats.add("node index",index);
+	stats.add("point IDs",ids);
+	stats.add("results",res);
+	stats.report("the queries");
+	
+	write_table w(out_fn,stdout);
+	size_t unmatched = 0;
+	if(csv) {
+		w.set_delim(',');
+		w.write_row("InputID","TargetID","Distance");
+	}
+	for(size_t i=0;i<n;i++) {
+		if(!nres[i]) unmatched++;
+		for(size_t j=0;j<nres[i];j++) w.write_row(ids[i],res[i*k + j].second,res[i*k + j].first);
+	}
+	if(!w.close()) {
+		fprintf(stderr,"Error writing output!\n");
+		return 1;
+	}
+	if(unmatched) fprintf(stderr,"%lu points without nodes within %f m\n",unmatched,max_dist);
+	return 0;
+}
+
@@ -0,0 +1,182 @@
+/*  -*- C++ -*-
+ * mem_stats.h -- simple accounting of the memory used by the main data
+ * 	structures of a program, reported at the end of each phase
+ * 
+ * mem_size() estimates the memory allocated by a container (not including
+ * the size of the object itself); it supports std::vector, std::pair,
+ * std::string, std::set (assuming the usual node overhead),
+ * flat_hash_map and any class with a memory_usage() member function
+ * 
+ * mem_stats collects the sizes of the structures given in a phase and
+ * prints them with the current and peak resident set size of the process;
+ * for memory mapped areas, the part that is resident in memory is checked
+ * with mincore(); if not enabled, nothing is calculated
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef MEM_STATS_H
+#define MEM_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <utility>
+#include <type_traits>
+#include "flat_hash_map.h"
+
+
+/* memory allocated by x (only if it has a memory_usage() function) */
+template<class T>
+static auto mem_size_impl(const T& x, int) -> decltype((size_t)x.memory_usage()) { return x.memory_usage(); }
+template<class T>
+static size_t mem_size_impl(const T&, long) { return 0; }
+template<class T>
+static size_t mem_size(const T& x) { return mem_size_impl(x,0); }
+
+template<class T1, class T2> static size_t mem_size(const std::pair<T1,T2>& p);
+template<class T> static size_t mem_size(const std::vector<T>& v);
+template<class K, class V, class H> static size_t mem_size(const flat_hash_map<K,V,H>& m);
+
+static inline size_t mem_size(const std::string& s) {
+	/* short strings are stored in the object itself */
+	return (s.capacity() > 15) ? s.capacity() + 1 : 0;
+}
+template<class T1, class T2>
+static size_t mem_size(const std::pair<T1,T2>& p) { return mem_size(p.first) + mem_size(p.second); }
+template<class T>
+static size_t mem_size(const std::vector<T>& v) {
+	size_t size = v.capacity() * sizeof(T);
+	if(!std::is_trivially_copyable<T>::value) for(const T& x : v) size += mem_size(x);
+	return size;
+}
+template<class T>
+static size_t mem_size(const std::set<T>& s) {
+	/* each node has three pointers and the color besides the element */
+	size_t size = s.size() * (sizeof(T) + 4*sizeof(void*));
+	if(!std::is_trivially_copyable<T>::value) for(const T& x : s) size += mem_size(x);
+	return size;
+}
+template<class K, class V, class H>
+static size_t mem_size(const flat_hash_map<K,V,H>& m) {
+	size_t size = m.memory_usage();
+	if(!std::is_trivially_copyable<V>::value) for(const auto& x : m) size += mem_size(x.second);
+	return size;
+}
+
+
+class mem_stats {
+	protected:
+		struct item {
+			std::string name;
+			size_t size;
+			size_t resident; /* for memory maps */
+			bool mapped;
+		};
+		std::vector<item> items;
+		bool enabled;
+	
+	public:
+		explicit mem_stats(bool enabled_ = false):enabled(enabled_) { }
+		bool is_enabled() const { return enabled; }
+		
+		/* add the memory used by x in the current phase */
+		template<class T>
+		void add(const char* name, const T& x) {
+			if(enabled) add_bytes(name,mem_size(x));
+		}
+		void add_bytes(const char* name, size_t size) {
+			if(enabled) items.push_back(item{name,size,0,false});
+		}
+		/* add a memory mapped area; the resident part is also counted */
+		void add_mapped(const char* name, const void* p, size_t len) {
+			if(!enabled || !p || p == MAP_FAILED) return;
+			items.push_back(item{name,len,mapped_resident(p,len),true});
+		}
+		
+		/* size of the part of [p,p+len) that is resident in memory */
+		static size_t mapped_resident(const void* p, size_t len) {
+			if(!len) return 0;
+			size_t page = sysconf(_SC_PAGESIZE);
+			uintptr_t start = ((uintptr_t)p) & ~(uintptr_t)(page - 1);
+			uintptr_t end = (uintptr_t)p + len;
+			size_t npages = (end - start + page - 1) / page;
+			std::vector<unsigned char> vec(npages);
+			if(mincore((void*)start,end - start,vec.data())) return 0;
+			size_t res = 0;
+			for(unsigned char c : vec) if(c & 1) res++;
+			res *= page;
+			return (res > len) ? len : res; /* partial pages at the ends */
+		}
+		/* current resident set size (from /proc/self/statm) */
+		static size_t current_rss() {
+			FILE* f = fopen("/proc/self/statm","r");
+			if(!f) return 0;
+			unsigned long size, res = 0;
+			if(fscanf(f,"%lu %lu",&size,&res) != 2) res = 0;
+			fclose(f);
+			return res * sysconf(_SC_PAGESIZE);
+		}
+		/* peak resident set size */
+		static size_t peak_rss() {
+			struct rusage r;
+			if(getrusage(RUSAGE_SELF,&r)) return 0;
+			return r.ru_maxrss * 1024UL; /* in kB on Linux */
+		}
+		
+		/* write the sizes collected in this phase and start a new one */
+		void report(const char* phase, FILE* f = stderr) {
+			if(!enabled) return;
+			const double MB = 1048576.0;
+			fprintf(f,"memory after %s:\n",phase);
+			size_t total = 0;
+			for(const item& x : items) {
+				if(x.mapped) fprintf(f,"\t%-32s %10.3f MB mapped (%.3f MB resident)\n",x.name.c_str(),x.size / MB,x.resident / MB);
+				else {
+					fprintf(f,"\t%-32s %10.3f MB\n",x.name.c_str(),x.size / MB);
+					total += x.size;
+				}
+			}
+			if(items.size()) fprintf(f,"\t%-32s %10.3f MB\n","total allocated",total / MB);
+			fprintf(f,"\tRSS: %.1f MB, peak RSS: %.1f MB\n",current_rss() / MB,peak_rss() / MB);
+			items.clear();
+		}
+};
+
+#endif
+
@@ -0,0 +1,474 @@
+/*
+ * min_fleet.cpp -- minimum number of vehicles needed to serve a set of
+ * 	trips, if vehicles can relocate between trips
+ * 
+ * trips are read in the format of sample_trips3 or the bike trip files
+ * (trip ID, other ID, start time, end time, start node, start distance,
+ * end node, ...); a vehicle that served trip i can serve trip j next if it
+ * can travel from the end node of i to the start node of j (with the given
+ * speed, using the distances among nodes, see distances.h) by the start
+ * time of j, and the time between the end of i and the start of j is at
+ * most max_gap (-R, including waiting and relocation)
+ * 
+ * the minimum number of vehicles is the size of a minimum path cover of
+ * the directed acyclic graph of trips with these edges, i.e. the number of
+ * trips minus the size of a maximum matching in the bipartite graph where
+ * each trip appears on both sides; this is found with the Pothen-Fan
+ * algorithm, starting from a greedy matching
+ * 
+ * edges are found in parallel; trips are sorted by start time, so for
+ * trip i only the trips starting in [end_i, end_i + max_gap] need to be
+ * checked; if there are more of these than nodes where trips start, trips
+ * are instead grouped by start node (sorted by start time), and the trips
+ * that can follow i are found by binary search for each node (they start
+ * after end_i plus the travel time to the node); edges are stored as
+ * arrays of the successors of each trip
+ * 
+ * optionally (-o), the vehicle serving each trip is written out (trip ID
+ * and vehicle ID, in the order of the start times)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+#include "distances.h"
+#include "bike_trips.h"
+#include "stage_timer.h"
+#include "trip_inputs.h"
+
+
+/* one trip, with the indices of its nodes */
+struct fleet_trip {
+	double ts; /* start time */
+	double te; /* end time */
+	uint32_t o, d; /* indices of the start and end nodes in the distance matrix */
+	uint32_t idx; /* index of the trip in the input */
+};
+
+/* trips grouped by their start node, with the start times (for the binary
+ * search), each group is sorted by start time */
+struct fleet_nodes {
+	std::vector<uint32_t> nodes; /* start nodes (indices in the distance matrix) */
+	std::vector<size_t> start; /* start of the trips of each node in trips and ts */
+	std::vector<uint32_t> trips; /* indices of the trips in the sorted order */
+	std::vector<double> ts; /* start time of these */
+	
+	void create(const std::vector<fleet_trip>& t) {
+		std::vector<std::pair<uint32_t,uint32_t> > tmp(t.size());
+		for(size_t i=0;i<t.size();i++) tmp[i] = std::make_pair(t[i].o,(uint32_t)i);
+		std::sort(tmp.begin(),tmp.end());
+		trips.resize(t.size());
+		ts.resize(t.size());
+		for(size_t i=0;i<tmp.size();i++) {
+			if(i == 0 || tmp[i].first != tmp[i-1].first) {
+				nodes.push_back(tmp[i].first);
+				start.push_back(i);
+			}
+			trips[i] = tmp[i].second;
+			ts[i] = t[tmp[i].second].ts;
+		}
+		start.push_back(tmp.size());
+	}
+	
+	size_t memory_usage() const {
+		return mem_size(nodes) + mem_size(start) + mem_size(trips) + mem_size(ts);
+	}
+};
+
+/* parameters and data shared by the threads */
+struct fleet_params {
+	const distances& dists;
+	const std::vector<fleet_trip>& trips; /* sorted by start time */
+	const fleet_nodes& nodes;
+	double v; /* speed, in m/s */
+	double max_gap; /* in seconds */
+};
+
+/* counts of trips processed with the two methods */
+struct fleet_counts {
+	uint64_t candidates = 0; /* trips checked in the time window */
+	uint64_t node_searches = 0; /* trips processed by nodes */
+	uint64_t edges = 0;
+	void add(const fleet_counts& c) {
+		candidates += c.candidates;
+		node_searches += c.node_searches;
+		edges += c.edges;
+	}
+};
+
+/* find the trips that can follow trip i (in the sorted order), add them
+ * to out (their indices in the sorted order, increasing); marks is used
+ * as temporary storage */
+static void fleet_next_trips(const fleet_params& p, size_t i, std::vector<uint32_t>& out,
+		std::vector<uint64_t>& marks, fleet_counts& cnt) {
+	const fleet_trip& a = p.trips[i];
+	double t1 = a.te;
+	double t2 = a.te + p.max_gap;
+	/* trips that start in the time window; only trips after i need to be
+	 * considered (trips before it can start at end_i only if i has zero
+	 * length and starts at the same time; these are not allowed to follow
+	 * i to avoid cycles) */
+	auto cmp = [](const fleet_trip& x, double t) { return x.ts < t; };
+	size_t j1 = std::lower_bound(p.trips.begin() + i + 1,p.trips.end(),t1,cmp) - p.trips.begin();
+	size_t j2 = std::lower_bound(p.trips.begin() + j1,p.trips.end(),std::nextafter(t2,INFINITY),cmp) - p.trips.begin();
+	size_t n0 = out.size();
+	
+	/* searching by nodes needs a distance and two binary searches for
+	 * each node, checking a trip needs one distance */
+	if(j2 - j1 <= 4*p.nodes.nodes.size()) {
+		/* check all trips */
+		cnt.candidates += j2 - j1;
+		for(size_t j=j1;j<j2;j++) {
+			const fleet_trip& b = p.trips[j];
+			if(a.te + p.dists.get_dist_idx(a.d,b.o) / p.v <= b.ts) out.push_back(j);
+		}
+	}
+	else {
+		/* check the nodes, find the trips starting late enough at each;
+		 * these are marked in a bitmap (relative to j1), so that they can
+		 * be output in order */
+		cnt.node_searches++;
+		marks.assign((j2 - j1 + 63) / 64,0);
+		for(size_t k=0;k<p.nodes.nodes.size();k++) {
+			double t = a.te + p.dists.get_dist_idx(a.d,p.nodes.nodes[k]) / p.v;
+			if(t > t2) continue;
+			const double* ts1 = p.nodes.ts.data() + p.nodes.start[k];
+			const double* ts2 = p.nodes.ts.data() + p.nodes.start[k+1];
+			const double* x1 = std::lower_bound(ts1,ts2,t);
+			const double* x2 = std::upper_bound(x1,ts2,t2);
+			for(const double* x = x1;x < x2;++x) {
+				uint32_t j = p.nodes.trips[x - p.nodes.ts.data()];
+				if(j >= j1) marks[(j - j1) / 64] |= ((uint64_t)1) << ((j - j1) % 64);
+			}
+		}
+		for(size_t k=0;k<marks.size();k++) for(uint64_t x = marks[k]; x; x &= x - 1)
+			out.push_back(j1 + 64*k + __builtin_ctzll(x));
+	}
+	cnt.edges += out.size() - n0;
+}
+
+/* graph of the trips, stored as the list of successors of each trip */
+struct fleet_graph {
+	std::vector<size_t> start; /* start of the successors of each trip in next */
+	std::vector<uint32_t> next;
+	size_t memory_usage() const { return mem_size(start) + mem_size(next); }
+};
+
+/* maximum matching in the bipartite graph given by g (each trip is on
+ * both sides, edges go from the left side to the right side); result is
+ * in match_l (for each trip, the trip that follows it, or none) and
+ * match_r (for each trip, the trip it follows, or none); returns the size
+ * of the matching
+ * 
+ * the initial greedy matching goes over the trips in decreasing order of
+ * end time, and matches each to the latest starting free trip that can
+ * follow it (the last one among its successors, which are sorted by
+ * start time); the remaining trips end earlier, and are the least likely
+ * to reach this one within max_gap
+ * 
+ * this is completed with the Pothen-Fan algorithm: in each phase, a DFS
+ * is started from each free left side vertex, not visiting any right side
+ * vertex twice in the same phase; before going deeper, the remaining
+ * successors of each vertex are checked for a free one ("lookahead",
+ * these only need to be checked once, since matched vertices stay
+ * matched); the order of successors tried alternates between phases */
+class fleet_matching {
+	public:
+		enum : uint32_t { none = (uint32_t)-1 };
+		std::vector<uint32_t> match_l, match_r;
+		unsigned int phases = 0; /* number of phases (after the greedy matching) */
+		size_t greedy = 0; /* size of the greedy matching */
+		
+		size_t solve(const fleet_graph& g, const std::vector<fleet_trip>& trips) {
+			size_t n = g.start.size() - 1;
+			match_l.assign(n,none);
+			match_r.assign(n,none);
+			size_t m = 0;
+			
+			/* greedy matching: the latest trip that can follow each, in
+			 * decreasing order of end times (stack holds this order here) */
+			stack.resize(n);
+			for(size_t u=0;u<n;u++) stack[u] = n - 1 - u;
+			std::stable_sort(stack.begin(),stack.end(),[&trips](uint32_t x, uint32_t y) {
+				return trips[x].te > trips[y].te; });
+			for(uint32_t u : stack) for(size_t k=g.start[u+1];k>g.start[u];k--) {
+				uint32_t v = g.next[k-1];
+				if(match_r[v] == none) {
+					match_l[u] = v;
+					match_r[v] = u;
+					m++;
+					break;
+				}
+			}
+			greedy = m;
+			
+			look.assign(g.start.begin(),g.start.end()-1);
+			visited.assign(n,0);
+			pos.resize(n);
+			while(true) {
+				phases++;
+				bool fwd = !(phases % 2); /* first phase goes backward */
+				size_t m0 = m;
+				for(size_t u=0;u<n;u++) pos[u] = fwd ? g.start[u] : g.start[u+1];
+				for(size_t u=0;u<n;u++) if(match_l[u] == none && dfs(g,u,fwd)) m++;
+				if(m == m0) break;
+			}
+			phases--; /* the last one did not find any path */
+			return m;
+		}
+		
+		size_t memory_usage() const {
+			return mem_size(match_l) + mem_size(match_r) + mem_size(look) +
+				mem_size(pos) + mem_size(visited) + mem_size(stack) + mem_size(path);
+		}
+		
+	protected:
+		std::vector<size_t> look; /* next successor to check in the lookahead */
+		std::vector<size_t> pos; /* next successor to try in the DFS */
+		std::vector<uint32_t> visited; /* phase when right side vertices were visited */
+		std::vector<uint32_t> stack; /* left side vertices on the current path */
+		std::vector<uint32_t> path; /* right side vertices on the current path */
+		
+		/* search for an augmenting path from u, without recursion; if
+		 * found, the matching is updated along it */
+		bool dfs(const fleet_graph& g, uint32_t u, bool fwd) {
+			stack.clear();
+			path.clear();
+			stack.push_back(u);
+			while(stack.size()) {
+				uint32_t x = stack.back();
+				for(;look[x] < g.start[x+1];look[x]++) {
+					uint32_t v = g.next[look[x]];
+					if(match_r[v] == none) {
+						/* found a path */
+						path.push_back(v);
+						for(size_t i=0;i<stack.size();i++) {
+							match_l[stack[i]] = path[i];
+							match_r[path[i]] = stack[i];
+						}
+						return true;
+					}
+				}
+				uint32_t v = none;
+				if(fwd) while(pos[x] < g.start[x+1]) {
+					uint32_t v1 = g.next[pos[x]++];
+					if(visited[v1] != phases) { v = v1; break; }
+				}
+				else while(pos[x] > g.start[x]) {
+					uint32_t v1 = g.next[--pos[x]];
+					if(visited[v1] != phases) { v = v1; break; }
+				}
+				if(v == none) {
+					/* no path from here */
+					stack.pop_back();
+					if(path.size()) path.pop_back();
+					continue;
+				}
+				visited[v] = phases;
+				path.push_back(v);
+				stack.push_back(match_r[v]);
+			}
+			return false;
+		}
+};
+
+
+int main(int argc, char **argv)
+{
+	trip_inputs inputs; /* trips, distances (-i, -d, -I, --edges, --dist-cache) and --timing */
+	const char* out_fn = 0; /* output: vehicle of each trip */
+	double vkmh = 20.0; /* speed of the vehicles, in km/h */
+	double max_gap = 900.0; /* maximum time between trips, in seconds */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(inputs.parse_option(argv,i)) continue;
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'o':
+				out_fn = argv[i+1];
+				i++;
+				break;
+			case 'v':
+				vkmh = atof(argv[i+1]);
+				i++;
+				break;
+			case 'R':
+				max_gap = atof(argv[i+1]);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!inputs.check()) return 1;
+	if(!(vkmh > 0.0) || max_gap < 0.0) {
+		fprintf(stderr,"Error: invalid speed or time between trips!\n");
+		return 1;
+	}
+	if(nthreads == 0) nthreads = 1;
+	stage_timer timer(inputs.timing);
+	
+	/* read the trips */
+	std::vector<bike_trip> trips_in;
+	if(!inputs.read_trips(nthreads,UINT32_MAX,trips_in)) return 1;
+	size_t n = trips_in.size();
+	timer.stage("reading the trips");
+	
+	/* distances among the nodes of the trips */
+	distances dists;
+	if(!inputs.read_dists(trips_in,nthreads,dists)) return 1;
+	timer.stage("reading the distances");
+	
+	/* trips sorted by start time, with node indices */
+	std::vector<fleet_trip> trips(n);
+	for(size_t i=0;i<n;i++) {
+		fleet_trip& t = trips[i];
+		t.ts = trips_in[i].start_ts;
+		t.te = std::max(trips_in[i].end_ts,trips_in[i].start_ts);
+		t.o = dists.get_index(trips_in[i].start_node);
+		t.d = dists.get_index(trips_in[i].end_node);
+		t.idx = i;
+	}
+	std::vector<uint64_t> trip_ids(n);
+	for(size_t i=0;i<n;i++) trip_ids[i] = trips_in[i].trip_id;
+	trips_in.clear();
+	trips_in.shrink_to_fit();
+	std::stable_sort(trips.begin(),trips.end(),[](const fleet_trip& a, const fleet_trip& b) { return a.ts < b.ts; });
+	fleet_nodes nodes;
+	nodes.create(trips);
+	timer.stage("preparing the trips");
+	
+	/* find the edges in parallel, in blocks of trips */
+	fleet_params p{dists, trips, nodes, vkmh / 3.6, max_gap};
+	const size_t block = 1024;
+	size_t nblocks = (n + block - 1) / block;
+	std::vector<std::vector<uint32_t> > next(nblocks); /* successors of the trips in each block */
+	std::vector<std::vector<uint32_t> > counts(nblocks); /* number of successors of each trip */
+	std::vector<fleet_counts> cnts(nthreads);
+	std::atomic<size_t> next_block(0);
+	auto worker = [&](unsigned int k) {
+		std::vector<uint64_t> marks;
+		while(true) {
+			size_t b = next_block++;
+			if(b >= nblocks) break;
+			for(size_t i=b*block;i<std::min(n,(b+1)*block);i++) {
+				size_t n1 = next[b].size();
+				fleet_next_trips(p,i,next[b],marks,cnts[k]);
+				counts[b].push_back(next[b].size() - n1);
+			}
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int k=1;k<nthreads && k<nblocks;k++) threads.emplace_back(worker,k);
+	worker(0);
+	for(auto& t : threads) t.join();
+	fleet_counts cnt;
+	for(const auto& c : cnts) cnt.add(c);
+	
+	/* copy to one array */
+	fleet_graph g;
+	g.start.resize(n+1);
+	g.next.resize(cnt.edges);
+	g.start[0] = 0;
+	for(size_t b=0;b<nblocks;b++) {
+		size_t i0 = b*block;
+		for(size_t k=0;k<counts[b].size();k++) g.start[i0+k+1] = g.start[i0+k] + counts[b][k];
+		std::copy(next[b].begin(),next[b].end(),g.next.begin() + g.start[i0]);
+		std::vector<uint32_t>().swap(next[b]);
+		std::vector<uint32_t>().swap(counts[b]);
+	}
+	fprintf(stderr,"%lu edges (%lu candidates checked in the time window, %lu trips searched by nodes)\n",
+		cnt.edges,cnt.candidates,cnt.node_searches);
+	timer.stage("finding the edges");
+	stats.add("trips",trips);
+	stats.add("trip IDs",trip_ids);
+	stats.add("trips by start node",nodes);
+	stats.add("graph",g);
+	dists.add_mem_stats(stats);
+	stats.report("finding the edges");
+	
+	/* minimum path cover */
+	fleet_matching m;
+	size_t nm = m.solve(g,trips);
+	fprintf(stderr,"maximum matching: %lu (greedy: %lu, %u phases)\n",nm,m.greedy,m.phases);
+	printf("%lu\n",n - nm);
+	timer.stage("matching");
+	stats.add("trips",trips);
+	stats.add("graph",g);
+	stats.add("matching",m);
+	stats.report("matching");
+	
+	if(out_fn) {
+		/* vehicles: follow the chains from the trips that do not follow another */
+		std::vector<uint32_t> vehicle(n);
+		uint32_t nv = 0;
+		for(size_t i=0;i<n;i++) if(m.match_r[i] == fleet_matching::none) {
+			for(uint32_t j = i; j != fleet_matching::none; j = m.match_l[j]) vehicle[j] = nv;
+			nv++;
+		}
+		write_table w(out_fn);
+		for(size_t i=0;i<n;i++) w.write_row(trip_ids[trips[i].idx],vehicle[i]);
+		if(!w.close()) {
+			fprintf(stderr,"Error writing file %s!\n",out_fn);
+			return 1;
+		}
+		timer.stage("writing the output");
+	}
+	timer.report();
+	dists.report_cache();
+	return 0;
+}
+
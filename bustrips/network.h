@@ -0,0 +1,217 @@
+/*  -*- C++ -*-
+ * network.h -- road network with distances for each edge and shortest
+ * 	path search from a node (Dijkstra's algorithm)
+ * 
+ * the network is stored as an associative container of nodes, with the
+ * edges starting from each node; edges are symmetrized when reading;
+ * edges in the "improved" network can be preferred by giving a weight
+ * (> 1) that their distance is divided with in the search
+ * 
+ * a search visits the nodes in the order of their (weighted) distance
+ * from the start node; the search state can be reused among searches to
+ * avoid allocating memory for each of them
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <set>
+#include <utility>
+#include "read_table.h"
+#include "flat_hash_map.h"
+#include "mem_stats.h"
+
+
+struct edge_info {
+	double d; /* edge distance */
+	unsigned int cnt; /* total times this edge was used */
+	unsigned int first_ts; /* first time this edge was used */
+	bool is_improved; /* flag if the edge is part of the improved network */
+	explicit edge_info(double d_) : d(d_), cnt(0), first_ts(0), is_improved(false) { }
+	edge_info() : d(0), cnt(0), first_ts(0), is_improved(false) { }
+};
+
+/* temporary data used in one search */
+struct network_search_state {
+	struct node {
+		double d; /* current estimate of distance to this node */
+		double real_d; /* "real" distance; the above can be the weighted distance */
+		uint64_t node_id; /* node id */
+		uint64_t ancestor; /* last node in the path leading to this */
+		bool operator < (const node& n) const {
+			/* note: node_id is part of the comparison so that nodes can be found exactly
+			 * (even if distances are the same for multiple nodes);
+			 * ancestor and real distance are not part of the comparison as that is not known or relevant when searching */
+			return d < n.d || (d == n.d && node_id < n.node_id);
+		}
+	};
+	std::set<node> q; /* queue of nodes to process by distance */
+	flat_hash_map<uint64_t,double> node_distances; /* distance of all nodes from the start node */
+	size_t memory_usage() const { return mem_size(q) + mem_size(node_distances); }
+};
+
+struct network {
+	/* graph is simply an associative container of edges with distances and counts (of trips using the edge) */
+	flat_hash_map<uint64_t,flat_hash_map<uint64_t,edge_info> > n;
+	double improved_edge_weight; /* extra preference toward improved edges */
+	
+	network():improved_edge_weight(1.0) { }
+	
+	bool has_node(uint64_t n1) const { return n.count(n1) > 0; }
+	size_t size() const { return n.size(); }
+	
+	/* read the edges (node IDs and distance); if fn is null, f is read;
+	 * the input is parsed with nthreads threads */
+	bool read_edges(const char* fn, FILE* f, unsigned int nthreads) {
+		/* parse the input in parallel, then build the graph in the original order */
+		read_table_parallel rt(fn,f,nthreads);
+		rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
+		std::vector<read_table_schema<uint64_t,uint64_t,double> > parts;
+		if(!rt.read_all_rows(parts)) {
+			fprintf(stderr,"Error reading network:\n");
+			rt.write_error(stderr);
+			return false;
+		}
+		for(const auto& p : parts) {
+			const auto& n1 = p.col<0>();
+			const auto& n2 = p.col<1>();
+			const auto& d = p.col<2>();
+			for(size_t j=0;j<p.size();j++) {
+				n[n1[j]][n2[j]] = edge_info(d[j]);
+				n[n2[j]][n1[j]] = edge_info(d[j]);
+			}
+		}
+		return true;
+	}
+	
+	/* read the list of improved edges; these have to be already in the network */
+	bool read_improved_edges(const char* fn, double weight) {
+		if(weight <= 0) {
+			fprintf(stderr,"Improved edge weight must be positive!\n");
+			return false;
+		}
+		if(weight <= 1) fprintf(stderr,"Improved edge weight seems too low (%g <= 1)\n",weight);
+		improved_edge_weight = weight;
+		unsigned int cnt = 0;
+		read_table2 rt(fn);
+		while(rt.read_line()) {
+			uint64_t n1,n2;
+			if(!rt.read(n1,n2)) break;
+			if(n.count(n1) == 0 || n.count(n2) == 0) {
+				fprintf(stderr,"Improved edge %lu -- %lu not in network!\n",n1,n2);
+				return false;
+			}
+			if(n[n1].count(n2) == 0 || n[n2].count(n1) == 0) {
+				fprintf(stderr,"Improved edge %lu -- %lu not in network!\n",n1,n2);
+				return false;
+			}
+			n[n1][n2].is_improved = true;
+			n[n2][n1].is_improved = true;
+			cnt++;
+		}
+		if(rt.get_last_error() != T_EOF) {
+			fprintf(stderr,"Error reading improved edges:\n");
+			rt.write_error(stderr);
+			return false;
+		}
+		fprintf(stderr,"%u improved edges read\n",cnt);
+		return true;
+	}
+	
+	/* the network is not modified after this; it can be searched from
+	 * multiple threads (each using a separate search state) */
+	void freeze() {
+		for(auto& x : n) x.second.freeze();
+		n.freeze();
+	}
+	
+	size_t memory_usage() const { return mem_size(n); }
+	
+	/* search from the start node, calling visit(node,d,real_d) for each
+	 * node reached, in the order of increasing (weighted) distance;
+	 * the search is stopped if visit() returns false;
+	 * returns false on an internal error */
+	template<class F>
+	bool search(uint64_t start_node, network_search_state& s, F&& visit) const {
+		typedef network_search_state::node node;
+		auto& q = s.q;
+		auto& node_distances = s.node_distances;
+		q.clear();
+		node_distances.clear();
+		node_distances[start_node] = 0;
+		q.insert(node {0.0,0.0,start_node,start_node});
+		
+		do {
+			auto it = q.begin();
+			uint64_t current = it->node_id;
+			double d = it->d;
+			double real_d = it->real_d;
+			q.erase(it);
+			
+			if(!visit(current,d,real_d)) break;
+			/* add to the queue the nodes reachable from the current */
+			for(const auto& x : n.at(current)) {
+				uint64_t n1 = x.first; /* node ID */
+				double real_d1 = real_d + x.second.d; /* total real distance this way */
+				double d1 = d; /* total weighted distance this way */
+				if(x.second.is_improved) d1 += x.second.d / improved_edge_weight;
+				else d1 += x.second.d;
+				auto it3 = node_distances.find(n1);
+				if(it3 == node_distances.end()) { /* this node was not seen yet, we can add to the queue */
+					node_distances.insert(std::make_pair(n1,d1));
+					q.insert(node{d1,real_d1,n1,current});
+				}
+				else {
+					/* node already found, may need to be updated -- only if new distance is shorter */
+					if(d1 < it3->second) {
+						if(q.erase(node{it3->second,0,n1,0}) != 1) {
+							fprintf(stderr,"Error: node %lu not found in the queue (distance: %f)!\n",n1,it3->second);
+							return false;
+						}
+						it3->second = d1;
+						q.insert(node{d1,real_d1,n1,current});
+					}
+				}
+			}
+		} while(q.size());
+		return true;
+	}
+};
+
+#endif
+
@@ -0,0 +1,297 @@
+/*  -*- C++ -*-
+ * node_index.h -- spatial index of network nodes (e.g. osm/sg_osm_nodes.dat)
+ * 	for finding the nearest node(s) to given coordinates
+ * 
+ * nodes are put in a uniform grid over an equirectangular projection
+ * (with the scale of the mean latitude), with about two nodes in each
+ * cell; nodes are stored ordered by cell (row by row), so a row of cells
+ * is a contiguous range; a query looks at cells in rings of increasing
+ * size around the query point, until no node outside can be closer than
+ * the ones found already
+ * 
+ * distances are great-circle distances (same as the haversine formula);
+ * candidates are compared by the chord length between the points on the
+ * unit sphere, calculated from precomputed 3D coordinates, which is
+ * monotonic in the distance and can be vectorized by the compiler; only
+ * the final results are converted to meters
+ * 
+ * the search stops when the distance of the query point from the area not
+ * searched yet (bounded by parallels and meridians) is larger than the
+ * current candidates; this assumes that the nodes do not cross the 180th
+ * meridian
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef NODE_INDEX_H
+#define NODE_INDEX_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+
+
+class node_index {
+	public:
+		constexpr static double earth_radius = 6371000.0; /* in meters */
+		
+		/* one result: distance (in meters) and node ID */
+		typedef std::pair<double,uint64_t> result;
+	
+	protected:
+		/* nodes, ordered by cell */
+		std::vector<uint64_t> ids;
+		std::vector<double> px, py, pz; /* coordinates on the unit sphere */
+		std::vector<uint32_t> cell_start; /* start of each cell among the nodes (size: ncells + 1) */
+		/* grid: x = lon * cos(lat0), y = lat (in degrees) */
+		double lat0_cos;
+		double x0, y0; /* lower left corner */
+		double cs; /* cell size */
+		long nx, ny;
+		
+		static void unit_vector(double lon, double lat, double& x, double& y, double& z) {
+			double l1 = lon * M_PI / 180.0;
+			double l2 = lat * M_PI / 180.0;
+			x = cos(l2) * cos(l1);
+			y = cos(l2) * sin(l1);
+			z = sin(l2);
+		}
+		/* conversion between squared chord length and distance in meters */
+		static double chord2_to_dist(double c2) {
+			double c = sqrt(c2) / 2.0;
+			if(c > 1.0) c = 1.0;
+			return 2.0 * earth_radius * asin(c);
+		}
+		static double dist_to_chord2(double d) {
+			if(d >= M_PI * earth_radius) return 4.0;
+			double c = 2.0 * sin(d / (2.0 * earth_radius));
+			return c*c;
+		}
+		
+	public:
+		/* temporary data used in one query; one is needed for each thread */
+		struct query_state {
+			std::vector<double> d2; /* squared chord lengths in one range */
+			std::vector<std::pair<double,uint32_t> > heap; /* best candidates so far */
+		};
+		
+		node_index() : lat0_cos(1.0), x0(0.0), y0(0.0), cs(1.0), nx(0), ny(0) { }
+		
+		size_t size() const { return ids.size(); }
+		size_t memory_usage() const {
+			return ids.capacity()*sizeof(uint64_t) + (px.capacity() + py.capacity() + pz.capacity())*sizeof(double) +
+				cell_start.capacity()*sizeof(uint32_t);
+		}
+		
+		/* build the index from a list of nodes (ID, longitude, latitude) */
+		bool build(const std::vector<uint64_t>& nids, const std::vector<double>& lon, const std::vector<double>& lat) {
+			size_t n = nids.size();
+			if(n == 0 || n != lon.size() || n != lat.size()) {
+				fprintf(stderr,"node_index::build(): no nodes given!\n");
+				return false;
+			}
+			if(n >= UINT32_MAX) {
+				fprintf(stderr,"node_index::build(): too many nodes!\n");
+				return false;
+			}
+			double lat_min = lat[0], lat_max = lat[0], lon_min = lon[0], lon_max = lon[0];
+			double lat_sum = 0.0;
+			for(size_t i=0;i<n;i++) {
+				lat_min = std::min(lat_min,lat[i]);
+				lat_max = std::max(lat_max,lat[i]);
+				lon_min = std::min(lon_min,lon[i]);
+				lon_max = std::max(lon_max,lon[i]);
+				lat_sum += lat[i];
+			}
+			double lat0 = lat_sum / n;
+			lat0_cos = cos(lat0 * M_PI / 180.0);
+			
+			/* grid with about two nodes in a cell */
+			x0 = lon_min * lat0_cos;
+			y0 = lat_min;
+			double w = (lon_max - lon_min) * lat0_cos;
+			double h = lat_max - lat_min;
+			cs = sqrt(w * h / (0.5 * n));
+			if(!(cs > 0.0)) cs = std::max(w,h) / (0.5 * n); /* all nodes on a line */
+			if(!(cs > 0.0)) cs = 1.0; /* all nodes at the same place */
+			nx = (long)(w / cs) + 1;
+			ny = (long)(h / cs) + 1;
+			
+			/* sort by cell (counting sort) */
+			std::vector<uint32_t> cells(n);
+			cell_start.assign(nx*ny + 1,0);
+			for(size_t i=0;i<n;i++) {
+				long cx = std::min(nx - 1,(long)((lon[i] * lat0_cos - x0) / cs));
+				long cy = std::min(ny - 1,(long)((lat[i] - y0) / cs));
+				cells[i] = cy*nx + cx;
+				cell_start[cells[i] + 1]++;
+			}
+			for(size_t c=0;c<(size_t)(nx*ny);c++) cell_start[c+1] += cell_start[c];
+			std::vector<uint32_t> pos(cell_start.begin(),cell_start.end() - 1);
+			ids.resize(n);
+			px.resize(n);
+			py.resize(n);
+			pz.resize(n);
+			for(size_t i=0;i<n;i++) {
+				uint32_t j = pos[cells[i]]++;
+				ids[j] = nids[i];
+				unit_vector(lon[i],lat[i],px[j],py[j],pz[j]);
+			}
+			return true;
+		}
+		
+		/* read the nodes from a file with the columns ID, longitude,
+		 * latitude (as osm/sg_osm_nodes.dat), using nthreads threads to
+		 * parse it, and build the index */
+		bool read_nodes(const char* fn, FILE* f, unsigned int nthreads) {
+			typedef read_table_schema<uint64_t,read_table_bounded<double>,read_table_bounded<double> > schema;
+			read_table_parallel rt(fn,f,nthreads);
+			rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
+			std::vector<schema> parts(rt.get_nchunks());
+			for(auto& p : parts) {
+				p.set_bounds<1>(-180.0,180.0);
+				p.set_bounds<2>(-90.0,90.0);
+			}
+			if(!rt.read_all([&parts](read_table2& r, unsigned int i) { return parts[i].read_row(r); })) {
+				fprintf(stderr,"Error reading nodes:\n");
+				rt.write_error(stderr);
+				return false;
+			}
+			std::vector<uint64_t> nids;
+			std::vector<double> lon, lat;
+			for(auto& p : parts) {
+				nids.insert(nids.end(),p.col<0>().begin(),p.col<0>().end());
+				lon.insert(lon.end(),p.col<1>().begin(),p.col<1>().end());
+				lat.insert(lat.end(),p.col<2>().begin(),p.col<2>().end());
+				p = schema();
+			}
+			return build(nids,lon,lat);
+		}
+		
+		/* find the (at most) k nodes nearest to the given point, within
+		 * max_dist meters (if > 0); results are written to res, ordered
+		 * by distance (then by their position in the index) */
+		void nearest(double lon, double lat, size_t k, double max_dist, query_state& s, std::vector<result>& res) const {
+			res.clear();
+			if(k == 0 || ids.empty()) return;
+			double qx, qy, qz;
+			unit_vector(lon,lat,qx,qy,qz);
+			auto& heap = s.heap; /* max heap of the best candidates (squared chord, node index) */
+			heap.clear();
+			double limit = (max_dist > 0.0) ? dist_to_chord2(max_dist) : 5.0;
+			
+			/* process nodes with indices in [a,b) */
+			auto process = [&](uint32_t a, uint32_t b) {
+				if(b <= a) return;
+				size_t len = b - a;
+				if(s.d2.size() < len) s.d2.resize(len);
+				double* d2 = s.d2.data();
+				const double* x = px.data() + a;
+				const double* y = py.data() + a;
+				const double* z = pz.data() + a;
+				for(size_t i=0;i<len;i++) {
+					double dx = x[i] - qx;
+					double dy = y[i] - qy;
+					double dz = z[i] - qz;
+					d2[i] = dx*dx + dy*dy + dz*dz;
+				}
+				for(size_t i=0;i<len;i++) {
+					double worst = (heap.size() < k) ? limit : heap.front().first;
+					if(d2[i] > worst || (d2[i] == worst && heap.size() == k)) continue;
+					if(heap.size() == k) {
+						std::pop_heap(heap.begin(),heap.end());
+						heap.pop_back();
+					}
+					heap.push_back(std::make_pair(d2[i],(uint32_t)(a + i)));
+					std::push_heap(heap.begin(),heap.end());
+				}
+			};
+			
+			/* cell of the query point (can be outside the grid) */
+			double x = lon * lat0_cos;
+			double fx = (x - x0) / cs;
+			double fy = (lat - y0) / cs;
+			double big = 4.0 * (nx + ny + 2);
+			long cx = (long)floor(std::max(-big,std::min(big,fx)));
+			long cy = (long)floor(std::max(-big,std::min(big,fy)));
+			/* first ring that can contain any cells */
+			long r = 0;
+			if(cx < 0) r = std::max(r,-cx);
+			if(cx >= nx) r = std::max(r,cx - nx + 1);
+			if(cy < 0) r = std::max(r,-cy);
+			if(cy >= ny) r = std::max(r,cy - ny + 1);
+			
+			for(;;r++) {
+				/* cells in ring r (limited to the grid) */
+				long xa = std::max(0L,cx - r), xb = std::min(nx - 1,cx + r);
+				for(long y = std::max(0L,cy - r);y <= std::min(ny - 1,cy + r);y++) {
+					const uint32_t* row = cell_start.data() + y*nx;
+					if(y == cy - r || y == cy + r) process(row[xa],row[xb + 1]);
+					else {
+						if(cx - r >= 0 && cx - r < nx) process(row[cx - r],row[cx - r + 1]);
+						if(r > 0 && cx + r >= 0 && cx + r < nx) process(row[cx + r],row[cx + r + 1]);
+					}
+				}
+				/* stop if all cells were processed */
+				if(cx - r <= 0 && cx + r >= nx - 1 && cy - r <= 0 && cy + r >= ny - 1) break;
+				/* or if no node outside can be better than the current worst:
+				 * nodes not processed yet are beyond the parallels or meridians
+				 * bounding the cells processed; the distance to a parallel is
+				 * the difference in latitude, to a meridian it is the distance
+				 * to its great circle */
+				double worst = (heap.size() < k) ? limit : heap.front().first;
+				if(worst >= 4.0) continue; /* no candidates yet */
+				double b = INFINITY; /* in radians */
+				double lat_r = lat * M_PI / 180.0;
+				auto lon_bound = [&](double x1) {
+					double dlon = fabs(lon - x1 / lat0_cos) * M_PI / 180.0;
+					return asin(cos(lat_r) * sin(std::min(dlon,M_PI / 2.0)));
+				};
+				if(cx - r > 0) b = std::min(b,lon_bound(x0 + (cx - r)*cs));
+				if(cx + r < nx - 1) b = std::min(b,lon_bound(x0 + (cx + r + 1)*cs));
+				if(cy - r > 0) b = std::min(b,fabs(lat - (y0 + (cy - r)*cs)) * M_PI / 180.0);
+				if(cy + r < ny - 1) b = std::min(b,fabs((y0 + (cy + r + 1)*cs) - lat) * M_PI / 180.0);
+				if(dist_to_chord2(b * earth_radius) > worst) break;
+			}
+			
+			std::sort_heap(heap.begin(),heap.end());
+			for(const auto& x : heap) res.push_back(result(chord2_to_dist(x.first),ids[x.second]));
+		}
+};
+
+#endif
+
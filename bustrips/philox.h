@@ -0,0 +1,124 @@
+/*  -*- C++ -*-
+ * philox.h -- counter-based random number generator (Philox4x32-10)
+ * 
+ * based on the description in: Salmon et al., Parallel random numbers:
+ * as easy as 1, 2, 3, SC'11, https://doi.org/10.1145/2063384.2063405
+ * 
+ * each (key, stream) combination gives an independent sequence that can be
+ * created directly, without generating any previous numbers; this allows
+ * generating the same random numbers independently of how the work is
+ * split among threads
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+
+/* Philox4x32-10 with a 64-bit key and a 64-bit stream ID; the stream ID
+ * is stored in the upper half of the 128-bit counter, the lower half is
+ * incremented for each block of four 32-bit outputs
+ * 
+ * satisfies the requirements of UniformRandomBitGenerator, producing
+ * 64-bit numbers, so it can be used with the standard library distributions */
+class philox4x32 {
+	protected:
+		uint32_t key[2];
+		uint32_t ctr[4];
+		uint32_t out[4];
+		unsigned int pos;
+		
+		static inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+			uint64_t p = (uint64_t)a * (uint64_t)b;
+			hi = (uint32_t)(p >> 32);
+			lo = (uint32_t)p;
+		}
+		
+		/* generate the next block of output and increment the counter */
+		void next_block() {
+			uint32_t c[4] = {ctr[0], ctr[1], ctr[2], ctr[3]};
+			uint32_t k0 = key[0];
+			uint32_t k1 = key[1];
+			for(unsigned int r = 0; r < 10; r++) {
+				uint32_t hi0, lo0, hi1, lo1;
+				mulhilo(0xD2511F53U, c[0], hi0, lo0);
+				mulhilo(0xCD9E8D57U, c[2], hi1, lo1);
+				c[0] = hi1 ^ c[1] ^ k0;
+				c[1] = lo1;
+				c[2] = hi0 ^ c[3] ^ k1;
+				c[3] = lo0;
+				k0 += 0x9E3779B9U;
+				k1 += 0xBB67AE85U;
+			}
+			for(unsigned int i = 0; i < 4; i++) out[i] = c[i];
+			pos = 0;
+			if(++ctr[0] == 0) ++ctr[1];
+		}
+	
+	public:
+		typedef uint64_t result_type;
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return UINT64_MAX; }
+		
+		philox4x32(uint64_t seed, uint64_t stream = 0) { set(seed,stream); }
+		
+		/* restart at the beginning of the given stream */
+		void set(uint64_t seed, uint64_t stream) {
+			key[0] = (uint32_t)seed;
+			key[1] = (uint32_t)(seed >> 32);
+			ctr[0] = 0;
+			ctr[1] = 0;
+			ctr[2] = (uint32_t)stream;
+			ctr[3] = (uint32_t)(stream >> 32);
+			pos = 4;
+		}
+		
+		/* raw output of one block (four 32-bit numbers) for the given counter;
+		 * mainly useful to check against known answers */
+		const uint32_t* block(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) {
+			ctr[0] = c0; ctr[1] = c1; ctr[2] = c2; ctr[3] = c3;
+			next_block();
+			return out;
+		}
+		
+		result_type operator () () {
+			if(pos >= 4) next_block();
+			uint64_t r = out[pos] | (((uint64_t)out[pos+1]) << 32);
+			pos += 2;
+			return r;
+		}
+};
+
+#endif /* PHILOX_H */
+
@@ -0,0 +1,130 @@
+/*  -*- C++ -*-
+ * radix_heap.h -- monotone priority queue with integer keys
+ * 
+ * a radix heap can be used if the popped keys never decrease (i.e. new
+ * keys are never smaller than the last one popped), e.g. for the events
+ * of a simulation; elements are stored in 65 buckets, bucket i contains
+ * keys that differ from the last popped key first in bit i-1 (bucket 0
+ * has keys equal to it); when bucket 0 is empty, the first non-empty
+ * bucket is redistributed after finding its minimum; each element is
+ * moved at most 64 times, but typically much less, and there are no
+ * comparisons among the elements, which makes this faster than a binary
+ * heap
+ * 
+ * elements with equal keys are popped in the order they were added only
+ * if they were added to the same bucket; the order is deterministic in all
+ * cases (it depends only on the order of the operations)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef RADIX_HEAP_H
+#define RADIX_HEAP_H
+
+#include <stdint.h>
+#include <stdexcept>
+#include <vector>
+#include <utility>
+
+
+template<class T>
+class radix_heap {
+	public:
+		typedef std::pair<uint64_t,T> element;
+		
+	protected:
+		std::vector<element> buckets[65];
+		uint64_t last = 0; /* last key popped */
+		size_t n = 0;
+		
+		static unsigned int bucket(uint64_t key, uint64_t last) {
+			return (key == last) ? 0 : (64 - __builtin_clzll(key ^ last));
+		}
+		
+		/* make sure that bucket 0 is not empty (if there are any elements) */
+		void pull() {
+			if(buckets[0].size()) return;
+			unsigned int i = 1;
+			for(;buckets[i].empty();i++) ;
+			std::vector<element>& b = buckets[i];
+			uint64_t m = b[0].first;
+			for(const element& x : b) if(x.first < m) m = x.first;
+			last = m;
+			for(element& x : b) buckets[bucket(x.first,last)].push_back(std::move(x));
+			b.clear();
+		}
+		
+	public:
+		bool empty() const { return n == 0; }
+		size_t size() const { return n; }
+		uint64_t last_key() const { return last; }
+		
+		/* add an element, key cannot be less than the last key popped */
+		void push(uint64_t key, const T& x) {
+			if(key < last) throw std::logic_error("radix_heap::push(): key smaller than the last one popped");
+			buckets[bucket(key,last)].push_back(element(key,x));
+			n++;
+		}
+		
+		/* element with the smallest key */
+		const element& top() {
+			if(n == 0) throw std::out_of_range("radix_heap::top(): empty heap");
+			pull();
+			return buckets[0].back();
+		}
+		
+		/* remove the element with the smallest key and return it */
+		element pop() {
+			if(n == 0) throw std::out_of_range("radix_heap::pop(): empty heap");
+			pull();
+			element x = std::move(buckets[0].back());
+			buckets[0].pop_back();
+			n--;
+			return x;
+		}
+		
+		void clear() {
+			for(auto& b : buckets) b.clear();
+			last = 0;
+			n = 0;
+		}
+		
+		size_t memory_usage() const {
+			size_t s = 0;
+			for(const auto& b : buckets) s += b.capacity() * sizeof(element);
+			return s;
+		}
+};
+
+#endif
+
@@ -10,6 +10,28 @@
  * version with both C and C++ interface; it requires the POSIX C getline()
  * function which is not available on all systems (most notably on Windows)
  * 
+ * regular files can be also read using mmap() instead of getline(), see
+ * read_table_new_mmap() and read_table_mmap below; this parses lines directly
+ * from the mapped memory, avoiding copies; read_table_parallel can be used
+ * to parse a memory mapped file with multiple threads; read_table_schema can be
+ * used to read rows of a fixed format into separate arrays for each column
+ * 
+ * inputs that cannot be memory mapped (e.g. pipes) can be read in a
+ * background thread with read_table2::start_background_reader(), which
+ * overlaps reading the input with parsing it
+ * 
+ * if compiled with READ_TABLE_ZLIB defined (and linked with -lz), gzip and
+ * zip (only the first file in the archive) inputs are detected and
+ * decompressed in the background thread; read_table_mmap and
+ * read_table_parallel do this automatically, for other cases (e.g. stdin),
+ * start_background_reader() has to be called
+ * 
+ * decimal numbers in the usual format are converted directly, without calling
+ * the strto* functions from the C library (error handling is the same, any
+ * number that is not simple is given to strto*); this assumes that the "C"
+ * locale is used (i.e. setlocale() is not called); compile with
+ * READ_TABLE_NO_FAST_PARSE defined to always use the C library functions
+ * 
  * note that the C++ interface requires C++11
  * 
  * Copyright 2018 Daniel Kondor <kondor.dani@gmail.com>
@@ -92,6 +114,13 @@ f.close(); // close file separately -- r should not be used after this point
 #include <limits.h>
 #include <ctype.h>
 #include <errno.h>
+#include <float.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #ifdef __cplusplus
 #include <cmath>
@@ -160,6 +189,21 @@ typedef struct read_table_s {
 	char delim; /* delimiter to use; 0 means any blank (space or tab) note: cannot be newline */
 	char comment; /* character to indicate comments; 0 means none */
 	uint8_t flags; /* further flags: whether reading a NaN or INF for double values is considered and error */
+	/* fields used if the input is memory mapped */
+	const char* map; /* start of the input data; if NULL, the input is read with getline() */
+	size_t map_size; /* size of the input data */
+	size_t map_pos; /* start of the next line in the input */
+	size_t map_prefetch; /* input was requested to be prefetched up to this point */
+	void* map_base; /* mapped region (to be unmapped at the end) */
+	size_t map_base_size; /* size of the mapped region */
+	char* mbuf; /* copy of the current line if needed (if there is no newline at the end of the input or for get_line_str()) */
+	size_t mbuf_size;
+	/* optional function to get the next block of data after the end of
+	 * the current one (map, map_size) is reached; this should update
+	 * map, map_size and map_pos and return 0 if there is more data, 1 at
+	 * the end of the input and -1 on error; if NULL, there is only one
+	 * block (i.e. the whole memory mapped file) */
+	int (*refill)(struct read_table_s* r);
 } read_table;
 
 /* flags used above */
@@ -181,6 +225,81 @@ static void read_table_init(read_table* r, FILE* f_) {
 	r->fn = 0;
 	r->base = 10;
 	r->flags = READ_TABLE_ALLOW_NAN_INF;
+	r->map = 0;
+	r->map_size = 0;
+	r->map_pos = 0;
+	r->map_prefetch = 0;
+	r->map_base = 0;
+	r->map_base_size = 0;
+	r->mbuf = 0;
+	r->mbuf_size = 0;
+	r->refill = 0;
+}
+
+/* empty input (used if there is no data to map) */
+static const char read_table_empty_map[1] = {0};
+
+/* amount of data to request to be read ahead in memory mapped input */
+#define READ_TABLE_PREFETCH_SIZE 4194304UL
+
+/* ask the OS to read ahead the next part of a memory mapped input
+ * (if we are close to the end of the part requested previously) */
+static void read_table_map_prefetch(read_table* r) {
+	if(!r->map_base) return;
+	if(r->map_prefetch >= r->map_size ||
+		r->map_pos + READ_TABLE_PREFETCH_SIZE / 2 < r->map_prefetch) return;
+	size_t start = r->map_prefetch + (r->map - (const char*)r->map_base); /* relative to the mapped region */
+	size_t len = READ_TABLE_PREFETCH_SIZE;
+	if(start + len > r->map_base_size) len = r->map_base_size - start;
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t start2 = start - (start % page); /* madvise() requires aligned address */
+	madvise(((char*)r->map_base) + start2, len + (start - start2), MADV_WILLNEED);
+	r->map_prefetch += len;
+}
+
+/* try to memory map the input from the given file descriptor, starting at
+ * offset off; returns 0 on success, 1 if this is not possible (e.g. the input
+ * is not a regular file), in this case the input should be read normally
+ * note: the file descriptor can be closed after this */
+static int read_table_map_fd(read_table* r, int fd, off_t off) {
+	struct stat st;
+	if(fd < 0 || off < 0) return 1;
+	if(fstat(fd,&st) || !S_ISREG(st.st_mode)) return 1;
+	if(st.st_size <= off) {
+		/* no data, will give EOF */
+		r->map = read_table_empty_map;
+		r->map_size = 0;
+		r->map_pos = 0;
+		return 0;
+	}
+	void* p = mmap(0,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	if(p == MAP_FAILED) return 1;
+	madvise(p,st.st_size,MADV_SEQUENTIAL);
+	r->map_base = p;
+	r->map_base_size = st.st_size;
+	r->map = ((const char*)p) + off;
+	r->map_size = st.st_size - off;
+	r->map_pos = 0;
+	r->map_prefetch = 0;
+	read_table_map_prefetch(r);
+	return 0;
+}
+
+/* free buffers and mapped memory (but not the struct itself) */
+static void read_table_free_buffers(read_table* r) {
+	if(r->map) {
+		if(r->map_base) munmap(r->map_base,r->map_base_size);
+		if(r->mbuf) free(r->mbuf);
+	}
+	else if(r->buf) free(r->buf);
+	r->buf = 0;
+	r->buf_size = 0;
+	r->map = 0;
+	r->map_size = 0;
+	r->map_base = 0;
+	r->map_base_size = 0;
+	r->mbuf = 0;
+	r->mbuf_size = 0;
 }
 
 /* create new read_table object, reading from the given file
@@ -211,16 +330,114 @@ static read_table* read_table_new_fn(const char* fn_) {
 	return r;
 }
 
+/* create new read_table object for the given file, memory mapping it if
+ * possible (if it is a regular file); otherwise it is opened and read
+ * normally, as with read_table_new_fn()
+ * note: this will close the file when deallocating the read_table struct */
+static read_table* read_table_new_mmap(const char* fn_) {
+	if(!fn_) return 0;
+	int fd = open(fn_,O_RDONLY);
+	if(fd == -1) {
+		fprintf(stderr,"read_table_new_mmap(): error opening file %s!\n",fn_);
+		return 0;
+	}
+	read_table* r = (read_table*)malloc(sizeof(read_table));
+	if(!r) {
+		close(fd);
+		return 0;
+	}
+	read_table_init(r,0);
+	r->fn = fn_;
+	if(read_table_map_fd(r,fd,0) == 0) {
+		close(fd);
+		return r;
+	}
+	/* not possible to map, read normally */
+	r->f = fdopen(fd,"r");
+	if(!r->f) {
+		close(fd);
+		free(r);
+		return 0;
+	}
+	r->flags |= READ_TABLE_CLOSE_FILE;
+	return r;
+}
+
 /* free read_table struct
  * note that this does not close the file, that is the caller's responsibility! */
 static void read_table_free(read_table* r) {
 	if(r) {
-		if(r->buf) free(r->buf);
+		read_table_free_buffers(r);
 		if(r->flags & READ_TABLE_CLOSE_FILE) if(r->f) fclose(r->f);
 		free(r);
 	}
 }
 
+/* check if the current line should be skipped: it is empty or a comment
+ * (advances pos to the first non-blank character) */
+static int read_table_line_empty(read_table* r) {
+	for(r->pos = 0; r->pos < r->line_len; r->pos++)
+		if( ! (r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') ) break;
+	if(r->comment && r->pos < r->line_len) if(r->buf[r->pos] == r->comment) return 1; /* check for comment character first */
+	if(r->pos < r->line_len) return 0; /* there is some data in the line */
+	return 1;
+}
+
+/* read a new line from a memory mapped input, same as read_table_line_skip() below
+ * buf will point directly to the line in the mapped memory, except for the
+ * last line if it does not end with a newline, which is copied */
+static int read_table_line_skip_map(read_table* r, int skip) {
+	while(1) {
+		if(r->map_pos >= r->map_size) {
+			if(r->refill) {
+				int ret = r->refill(r);
+				if(ret == 0) continue; /* new block of data */
+				if(ret < 0) {
+					r->last_error = T_READ_ERROR;
+					r->line_len = 0;
+					return 1;
+				}
+			}
+			r->last_error = T_EOF;
+			r->line_len = 0; /* ensure the buffer will never be accessed */
+			return 1;
+		}
+		const char* start = r->map + r->map_pos;
+		size_t rem = r->map_size - r->map_pos;
+		const char* end = (const char*)memchr(start,'\n',rem);
+		size_t len;
+		if(end) {
+			len = end - start + 1;
+			r->buf = (char*)start;
+		}
+		else {
+			/* last line without a newline, copy it so that it is terminated */
+			len = rem;
+			if(r->mbuf_size < len + 1) {
+				char* tmp = (char*)realloc(r->mbuf,len + 1);
+				if(!tmp) {
+					r->last_error = T_READ_ERROR;
+					return 1;
+				}
+				r->mbuf = tmp;
+				r->mbuf_size = len + 1;
+			}
+			memcpy(r->mbuf,start,len);
+			r->mbuf[len] = 0;
+			r->buf = r->mbuf;
+		}
+		r->map_pos += len;
+		read_table_map_prefetch(r);
+		r->line_len = len;
+		r->line++;
+		r->pos = 0;
+		if(!skip || !read_table_line_empty(r)) break;
+	}
+	r->col = 0; /* reset the counter for columns */
+	r->last_error = T_OK;
+	return 0;
+}
+
 /* read a new line (discarding any remaining data in the current line)
  * returns 0 if a line was read, 1 on failure
  * note that failure can mean end of file, which should be checked separately
@@ -231,6 +448,7 @@ static int read_table_line_skip(read_table* r, int skip) {
 	if(!r) return 1;
 	if(r->last_error == T_EOF || r->last_error == T_COPIED ||
 		r->last_error == T_ERROR_FOPEN) return 1;
+	if(r->map) return read_table_line_skip_map(r,skip);
 	if(!(r->f)) { r->last_error = T_READ_ERROR; return 1; }
 	while(1) {
 		ssize_t len = getline(&(r->buf),&(r->buf_size),r->f);
@@ -244,13 +462,7 @@ static int read_table_line_skip(read_table* r, int skip) {
 		
 		/* check that there is actual data in the line, empty lines are skipped */
 		r->pos = 0;
-		if(skip) {
-			for(; r->pos < r->line_len; r->pos++)
-				if( ! (r->buf[r->pos] == ' ' || r->buf[r->pos] == '\t') ) break;
-			if(r->comment) if(r->buf[r->pos] == r->comment) continue; /* check for comment character first */
-			if(r->pos < r->line_len) break; /* there is some data in the line */
-		}
-		else break; /* if empty lines should not be skipped */
+		if(!skip || !read_table_line_empty(r)) break;
 	}
 	r->col = 0; /* reset the counter for columns */
 	r->last_error = T_OK;
@@ -283,17 +495,8 @@ static int read_table_pre_check(read_table* r) {
 }
 
 
-/* perform checks needed after number conversion */
-static int read_table_post_check(read_table* r, char* c2) {
-	/* 0. check for format errors and overflow as indicated by strto* */
-	if(errno == EINVAL || c2 == r->buf + r->pos) {
-		r->last_error = T_FORMAT;
-		return 1;
-	}
-	if(errno == ERANGE) {
-		r->last_error = T_OVERFLOW;
-		return 1;
-	}
+/* checks after a number was converted successfully, ending at c2 */
+static int read_table_post_check_end(read_table* r, const char* c2) {
 	/* 1. skip the converted number and any blanks */
 	int have_blank = 0;
 	for(r->pos = c2 - r->buf;r->pos<r->line_len;r->pos++)
@@ -321,6 +524,146 @@ static int read_table_post_check(read_table* r, char* c2) {
 	return 0; /* everything OK */
 }
 
+/* perform checks needed after number conversion */
+static int read_table_post_check(read_table* r, char* c2) {
+	/* 0. check for format errors and overflow as indicated by strto* */
+	if(errno == EINVAL || c2 == r->buf + r->pos) {
+		r->last_error = T_FORMAT;
+		return 1;
+	}
+	if(errno == ERANGE) {
+		r->last_error = T_OVERFLOW;
+		return 1;
+	}
+	return read_table_post_check_end(r,c2);
+}
+
+
+/* fast conversion of simple decimal numbers
+ * the functions below behave the same as the corresponding strto* functions
+ * (with base 10), but only handle the common case directly: an optional sign
+ * followed by at most 18 (or 19 for unsigned) digits, so the result cannot
+ * overflow; anything else (other base, blanks or a sign followed by a
+ * non-digit, longer numbers) is given to the strto* functions, so that the
+ * result, the end position and errno are always the same */
+
+/* parse an integer with an optional sign (only '+' if neg is NULL) and at
+ * most maxdigits digits; returns the position after the number or NULL if
+ * the number is not in this format */
+static inline const char* read_table_parse_int(const char* c, unsigned long long* res, int* neg, int maxdigits) {
+	if(neg) {
+		*neg = 0;
+		if(*c == '-') { *neg = 1; c++; }
+		else if(*c == '+') c++;
+	}
+	else if(*c == '+') c++;
+	const char* start = c;
+	unsigned long long x = 0;
+	for(; (unsigned int)(*c - '0') < 10U; c++) x = 10*x + (*c - '0');
+	if(c == start || c - start > maxdigits) return 0;
+	*res = x;
+	return c;
+}
+
+/* parse a floating point number: numbers with at most 19 significant
+ * digits, a mantissa that is exactly representable (< 2^53) and a decimal
+ * exponent in the range [-22,22] are converted with one multiplication or
+ * division of two exact values, giving the correctly rounded result (as
+ * strtod() does); returns the position after the number or NULL if the
+ * number is not in this format
+ * (note: this requires that double operations are not done with extended
+ * precision, which is checked by FLT_EVAL_METHOD in read_table_strtod()) */
+static inline const char* read_table_parse_double(const char* c, double* res) {
+	static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+		1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18,
+		1e19, 1e20, 1e21, 1e22};
+	int neg = 0;
+	if(*c == '-') { neg = 1; c++; }
+	else if(*c == '+') c++;
+	uint64_t m = 0; /* mantissa */
+	int nd = 0; /* number of significant digits (not counting leading zeros) */
+	int nd_all = 0; /* number of all digits */
+	int e = 0; /* decimal exponent */
+	for(; (unsigned int)(*c - '0') < 10U; c++, nd_all++) {
+		m = 10*m + (*c - '0');
+		if(m) nd++;
+	}
+	if(*c == '.') {
+		for(c++; (unsigned int)(*c - '0') < 10U; c++, nd_all++) {
+			m = 10*m + (*c - '0');
+			if(m) nd++;
+			e--;
+		}
+	}
+	/* note: an exponent is only considered if there are digits after the 'e' */
+	if(nd_all && (*c == 'e' || *c == 'E')) {
+		const char* c1 = c + 1;
+		int eneg = 0;
+		if(*c1 == '-') { eneg = 1; c1++; }
+		else if(*c1 == '+') c1++;
+		if((unsigned int)(*c1 - '0') < 10U) {
+			int e2 = 0;
+			for(; (unsigned int)(*c1 - '0') < 10U; c1++)
+				if(e2 < 10000) e2 = 10*e2 + (*c1 - '0');
+			e += eneg ? -e2 : e2;
+			c = c1;
+		}
+	}
+	/* note: hexadecimal numbers (0x...) are given to strtod() */
+	if(nd_all && nd <= 19 && m <= (UINT64_C(1) << 53) && e >= -22 && e <= 22 &&
+			*c != 'x' && *c != 'X') {
+		double d = (double)m;
+		if(e < 0) d /= pow10[-e];
+		else d *= pow10[e];
+		*res = neg ? -d : d;
+		return c;
+	}
+	return 0;
+}
+
+static long long read_table_strtoll(const read_table* r, char** c2) {
+	const char* s = r->buf + r->pos;
+#ifndef READ_TABLE_NO_FAST_PARSE
+	if(r->base == 10) {
+		unsigned long long res;
+		int neg;
+		const char* c = read_table_parse_int(s,&res,&neg,18);
+		if(c) {
+			*c2 = (char*)c;
+			return neg ? -(long long)res : (long long)res;
+		}
+	}
+#endif
+	return strtoll(s, c2, r->base);
+}
+static unsigned long long read_table_strtoull(const read_table* r, char** c2) {
+	const char* s = r->buf + r->pos;
+#ifndef READ_TABLE_NO_FAST_PARSE
+	/* note: negative numbers are always given to strtoull() */
+	if(r->base == 10) {
+		unsigned long long res;
+		const char* c = read_table_parse_int(s,&res,0,19);
+		if(c) {
+			*c2 = (char*)c;
+			return res;
+		}
+	}
+#endif
+	return strtoull(s, c2, r->base);
+}
+static double read_table_strtod(const read_table* r, char** c2) {
+	const char* s = r->buf + r->pos;
+#if !defined(READ_TABLE_NO_FAST_PARSE) && defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	double res;
+	const char* c = read_table_parse_double(s,&res);
+	if(c) {
+		*c2 = (char*)c;
+		return res;
+	}
+#endif
+	return strtod(s, c2);
+}
+
 
 /* skip next field, ignoring any content
  * if we have a delimiter, this means advancing until the next delimiter and
@@ -402,11 +745,11 @@ static int read_table_int32_limits(read_table* r, int32_t* i, int32_t min, int32
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	long res = strtol(r->buf + r->pos, &c2, r->base);
-	/* check that result fits in 32-bit integer -- long might be 64-bit */
-	if(res > (long)max || res < (long)min) {
-		if(res > (long)max) *i = max;
-		if(res < (long)min) *i = min;
+	long long res = read_table_strtoll(r, &c2);
+	/* check that result fits in 32-bit integer */
+	if(res > (long long)max || res < (long long)min) {
+		if(res > (long long)max) *i = max;
+		if(res < (long long)min) *i = min;
 		r->last_error = T_OVERFLOW;
 		return 1;
 	}
@@ -426,30 +769,15 @@ static int read_table_int64_limits(read_table* r, int64_t* i, int64_t min, int64
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	/* note: try to determine if to use long or long long */
-	long res;
-	long long res2;
-	if(LONG_MAX >= INT64_MAX && LONG_MIN <= INT64_MIN) {
-		res = strtol(r->buf + r->pos, &c2, r->base);
-		/* note: this check might be unnecessary */
-		if(res > (long)max || res < (long)min) {
-			r->last_error = T_OVERFLOW;
-			if(res > (long)max) *i = max;
-			if(res < (long)min) *i = min;
-			return 1;
-		}
-		*i = res; /* store potential result */
-	}
-	else {
-		res2 = strtoll(r->buf + r->pos, &c2, r->base);
-		if(res2 > (long long)max || res2 < (long long)min) {
-			r->last_error = T_OVERFLOW;
-			if(res2 > (long long)max) *i = max;
-			if(res2 < (long long)min) *i = min;
-			return 1;
-		}
-		*i = res2; /* store potential result */
+	/* note: long long is at least 64-bit */
+	long long res = read_table_strtoll(r, &c2);
+	if(res > (long long)max || res < (long long)min) {
+		r->last_error = T_OVERFLOW;
+		if(res > (long long)max) *i = max;
+		if(res < (long long)min) *i = min;
+		return 1;
 	}
+	*i = res; /* store potential result */
 	/* advance position after the number, check if there is proper field separator */
 	return read_table_post_check(r,c2);
 }
@@ -471,12 +799,12 @@ static int read_table_uint32_limits(read_table* r, uint32_t* i, uint32_t min, ui
 		*i = 0;
 		return 1;
 	}
-	unsigned long res = strtoul(r->buf + r->pos, &c2, r->base);
-	/* check that result fits in 32-bit integer -- long might be 64-bit */
-	if(res > (unsigned long)max || res < (unsigned int)min) {
+	unsigned long long res = read_table_strtoull(r, &c2);
+	/* check that result fits in 32-bit integer */
+	if(res > (unsigned long long)max || res < (unsigned long long)min) {
 		r->last_error = T_OVERFLOW;
-		if(res > (unsigned long)max) *i = max;
-		if(res < (unsigned long)min) *i = min;
+		if(res > (unsigned long long)max) *i = max;
+		if(res < (unsigned long long)min) *i = min;
 		return 1;
 	}
 	*i = res; /* store potential result */
@@ -501,30 +829,15 @@ static int read_table_uint64_limits(read_table* r, uint64_t* i, uint64_t min, ui
 		*i = 0;
 		return 1;
 	}
-	/* note: try to determine if to use long or long long */
-	unsigned long res;
-	unsigned long long res2;
-	if(ULONG_MAX >= UINT64_MAX) {
-		res = strtoul(r->buf + r->pos, &c2, r->base);
-		/* note: this check might be unnecessary */
-		if(res > (unsigned long)max || res < (unsigned long)min) {
-			r->last_error = T_OVERFLOW;
-			if(res > (unsigned long)max) *i = max;
-			if(res < (unsigned long)min) *i = min;
-			return 1;
-		}
-		*i = res; /* store potential result */
-	}
-	else {
-		res2 = strtoull(r->buf + r->pos, &c2, r->base);
-		if(res2 > (unsigned long long)max || res < (unsigned long long)min) {
-			r->last_error = T_OVERFLOW;
-			if(res > (unsigned long long)max) *i = max;
-			if(res < (unsigned long long)min) *i = min;
-			return 1;
-		}
-		*i = res2; /* store potential result */
+	/* note: unsigned long long is at least 64-bit */
+	unsigned long long res = read_table_strtoull(r, &c2);
+	if(res > (unsigned long long)max || res < (unsigned long long)min) {
+		r->last_error = T_OVERFLOW;
+		if(res > (unsigned long long)max) *i = max;
+		if(res < (unsigned long long)min) *i = min;
+		return 1;
 	}
+	*i = res; /* store potential result */
 	/* advance position after the number, check if there is proper field separator */
 	return read_table_post_check(r,c2);
 }
@@ -565,7 +878,7 @@ static int read_table_double(read_table* r, double* d) {
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	*d = strtod(r->buf + r->pos, &c2);
+	*d = read_table_strtod(r, &c2);
 	/* advance position after the number, check if there is proper field separator */
 	if(read_table_post_check(r,c2)) return 1;
 	if( (r->flags & READ_TABLE_ALLOW_NAN_INF) == 0) {
@@ -580,7 +893,7 @@ static int read_table_double_limits(read_table* r, double* d, double min, double
 	if(read_table_pre_check(r)) return 1;
 	errno = 0;
 	char* c2;
-	*d = strtod(r->buf + r->pos, &c2);
+	*d = read_table_strtod(r, &c2);
 	if(read_table_post_check(r,c2)) return 1;
 	if(isnan(*d)) {
 		r->last_error = T_NAN;
@@ -656,9 +969,24 @@ static void read_table_write_error(const read_table* r, FILE* f) {
 		get_error_desc(r->last_error));
 }
 
+/* get the current line as a null-terminated string; if the input is memory
+ * mapped, this makes a copy of the line (so the struct is modified, but only
+ * its internal buffer) */
 static const char* read_table_get_line_str(const read_table* r) {
-	if(r) return r->buf;
-	return 0;
+	if(!r) return 0;
+	if(r->map && r->buf && r->buf != r->mbuf) {
+		read_table* r2 = (read_table*)r;
+		if(r2->mbuf_size < r2->line_len + 1) {
+			char* tmp = (char*)realloc(r2->mbuf,r2->line_len + 1);
+			if(!tmp) return 0;
+			r2->mbuf = tmp;
+			r2->mbuf_size = r2->line_len + 1;
+		}
+		memcpy(r2->mbuf,r2->buf,r2->line_len);
+		r2->mbuf[r2->line_len] = 0;
+		return r2->mbuf;
+	}
+	return r->buf;
 }
 
 
@@ -668,6 +996,14 @@ static const char* read_table_get_line_str(const read_table* r) {
 
 #include <utility>
 #include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <limits>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 
 template<class T>
@@ -817,6 +1153,280 @@ static int read_table_multiple(read_table* r, first&& val, rest&&... vals) {
 
 
 /* C++ class interface for easier usage */
+/* size of blocks read by read_table_reader_thread */
+#define READ_TABLE_BLOCK_SIZE 4194304UL
+
+
+#ifdef READ_TABLE_ZLIB
+#include <zlib.h>
+
+/* compression detected from the first bytes of the input */
+enum read_table_compression { READ_TABLE_PLAIN = 0, READ_TABLE_GZIP, READ_TABLE_ZIP };
+static enum read_table_compression read_table_detect_compression(const char* p, size_t len) {
+	const unsigned char* c = (const unsigned char*)p;
+	if(len >= 2 && c[0] == 0x1f && c[1] == 0x8b) return READ_TABLE_GZIP;
+	if(len >= 4 && c[0] == 'P' && c[1] == 'K' && c[2] == 3 && c[3] == 4) return READ_TABLE_ZIP;
+	return READ_TABLE_PLAIN;
+}
+
+/* input source that decompresses gzip or zip data read from a file if
+ * needed (used as the source for read_table_reader_thread)
+ * for gzip, multiple concatenated members are supported; for zip, only
+ * the first file in the archive is read (as with zcat) */
+struct read_table_inflate {
+	public:
+		explicit read_table_inflate(FILE* f_) : f(f_), in(262144), in_pos(0), in_len(0),
+				in_eof(false), finished(false), zip_header(false), stored(false), stored_left(0) {
+			memset(&zs,0,sizeof(z_stream));
+			/* read the first bytes to detect the format */
+			while(in_len < 4 && fill_input() > 0) { }
+			mode = read_table_detect_compression(in.data(),in_len);
+			if(mode == READ_TABLE_GZIP) inflateInit2(&zs,15 + 16);
+			if(mode == READ_TABLE_ZIP) zip_header = true;
+		}
+		~read_table_inflate() {
+			if(mode == READ_TABLE_GZIP || (mode == READ_TABLE_ZIP && !stored)) inflateEnd(&zs);
+		}
+		enum read_table_compression get_mode() const { return mode; }
+		
+		/* read at most len bytes of (decompressed) data; returns the
+		 * number of bytes, 0 at the end of the input or -1 on error */
+		long read(char* buf, size_t len) {
+			if(mode == READ_TABLE_PLAIN) {
+				if(in_pos < in_len) return copy_input(buf,len);
+				size_t ret = fread(buf,1,len,f);
+				if(ret == 0 && ferror(f)) return -1;
+				return (long)ret;
+			}
+			if(zip_header) {
+				if(!read_zip_header()) return -1;
+				zip_header = false;
+			}
+			if(finished) return 0;
+			if(stored) {
+				/* zip entry without compression */
+				if(!stored_left) return 0;
+				if(in_pos == in_len && fill_input() <= 0) return -1; /* truncated input */
+				if(len > stored_left) len = stored_left;
+				long ret = copy_input(buf,len);
+				stored_left -= ret;
+				return ret;
+			}
+			zs.next_out = (Bytef*)buf;
+			zs.avail_out = len > UINT32_MAX ? UINT32_MAX : len;
+			size_t avail_out = zs.avail_out;
+			while(zs.avail_out == avail_out) {
+				if(in_pos == in_len && !in_eof) {
+					long ret = fill_input();
+					if(ret < 0) return -1;
+				}
+				zs.next_in = (Bytef*)(in.data() + in_pos);
+				zs.avail_in = in_len - in_pos;
+				int ret = inflate(&zs,Z_NO_FLUSH);
+				in_pos = in_len - zs.avail_in;
+				if(ret == Z_STREAM_END) {
+					if(mode == READ_TABLE_ZIP) { finished = true; break; }
+					/* gzip: check if there is another member */
+					if(in_pos == in_len && !in_eof && fill_input() < 0) return -1;
+					if(in_pos == in_len || read_table_detect_compression(in.data() + in_pos,in_len - in_pos) != READ_TABLE_GZIP) {
+						finished = true;
+						break;
+					}
+					inflateReset(&zs);
+					continue;
+				}
+				if(ret != Z_OK && ret != Z_BUF_ERROR) return -1;
+				if(zs.avail_out == avail_out && in_pos == in_len && in_eof) return -1; /* truncated input */
+			}
+			return (long)(avail_out - zs.avail_out);
+		}
+	
+	protected:
+		FILE* f;
+		std::vector<char> in; /* buffer for compressed data */
+		size_t in_pos; /* current position in the buffer */
+		size_t in_len; /* amount of data in the buffer */
+		bool in_eof; /* end of input reached */
+		bool finished; /* end of compressed stream reached */
+		bool zip_header; /* zip header needs to be processed */
+		bool stored; /* zip entry is stored without compression */
+		uint64_t stored_left; /* remaining size of a stored zip entry */
+		enum read_table_compression mode;
+		z_stream zs;
+		
+		/* read more data into the input buffer (after the current data);
+		 * returns the number of bytes read, 0 at the end or -1 on error */
+		long fill_input() {
+			if(in_eof) return 0;
+			if(in_pos == in_len) in_pos = in_len = 0;
+			else if(in_pos > 0) {
+				memmove(in.data(),in.data() + in_pos,in_len - in_pos);
+				in_len -= in_pos;
+				in_pos = 0;
+			}
+			if(in_len == in.size()) in.resize(2*in.size());
+			size_t ret = fread(in.data() + in_len,1,in.size() - in_len,f);
+			if(ret == 0) {
+				if(ferror(f)) return -1;
+				in_eof = true;
+			}
+			in_len += ret;
+			return (long)ret;
+		}
+		long copy_input(char* buf, size_t len) {
+			if(len > in_len - in_pos) len = in_len - in_pos;
+			memcpy(buf,in.data() + in_pos,len);
+			in_pos += len;
+			return (long)len;
+		}
+		/* ensure that at least n bytes are available in the input buffer */
+		bool need_input(size_t n) {
+			while(in_len - in_pos < n) if(fill_input() <= 0) return false;
+			return true;
+		}
+		static uint32_t get16(const char* p) {
+			const unsigned char* c = (const unsigned char*)p;
+			return c[0] | (((uint32_t)c[1]) << 8);
+		}
+		static uint32_t get32(const char* p) { return get16(p) | (get16(p + 2) << 16); }
+		/* process the local file header at the start of a zip file */
+		bool read_zip_header() {
+			if(!need_input(30)) return false;
+			const char* h = in.data() + in_pos;
+			uint32_t flags = get16(h + 6);
+			uint32_t method = get16(h + 8);
+			uint32_t csize = get32(h + 18);
+			size_t skip = 30 + get16(h + 26) + get16(h + 28); /* header, file name, extra field */
+			if(!need_input(skip)) return false;
+			in_pos += skip;
+			if(method == 8) return inflateInit2(&zs,-15) == Z_OK;
+			if(method == 0 && !(flags & 8) && csize != UINT32_MAX) {
+				stored = true;
+				stored_left = csize;
+				return true;
+			}
+			return false; /* unsupported compression method */
+		}
+};
+#endif
+
+/* reading the input in a background thread: blocks of complete lines are
+ * read into a ring of buffers by a separate thread while the previous
+ * blocks are parsed; the parser uses the blocks in the same way as a memory
+ * mapped input (see read_table2::start_background_reader()) */
+struct read_table_reader_thread {
+	public:
+		/* function used to read the input: it should read at most len
+		 * bytes into buf and return the number of bytes read, 0 at the end
+		 * of the input or -1 on error */
+		typedef std::function<long(char* buf, size_t len)> source_t;
+		
+		read_table_reader_thread(source_t&& source_, size_t block_size, unsigned int nbuffers) :
+				source(std::move(source_)), blocks(nbuffers < 2 ? 2 : nbuffers), produced(0),
+				released(0), have_current(false), done(false), error(false), stop(false) {
+			if(block_size < 4096) block_size = 4096;
+			for(auto& b : blocks) b.data.resize(block_size);
+			t = std::thread(&read_table_reader_thread::run,this);
+		}
+		~read_table_reader_thread() {
+			{
+				std::unique_lock<std::mutex> lock(m);
+				stop = true;
+			}
+			cv.notify_all();
+			t.join();
+		}
+		
+		/* get the next block, releasing the previous one; returns 0 if
+		 * there is a new block, 1 at the end of the input and -1 on error */
+		int next_block(const char** data, size_t* len) {
+			std::unique_lock<std::mutex> lock(m);
+			if(have_current) {
+				released++;
+				have_current = false;
+				cv.notify_all();
+			}
+			while(!(produced > released || done || error)) cv.wait(lock);
+			if(produced > released) {
+				const block& b = blocks[released % blocks.size()];
+				*data = b.data.data();
+				*len = b.len;
+				have_current = true;
+				return 0;
+			}
+			return error ? -1 : 1;
+		}
+	
+	protected:
+		struct block {
+			std::vector<char> data;
+			size_t len;
+		};
+		source_t source;
+		std::vector<block> blocks;
+		size_t produced; /* number of blocks read */
+		size_t released; /* number of blocks processed */
+		bool have_current; /* true if a block is being processed */
+		bool done; /* end of input reached */
+		bool error; /* read error */
+		bool stop; /* set when the reader thread should exit */
+		std::mutex m;
+		std::condition_variable cv;
+		std::thread t;
+		
+		/* main loop of the reader thread */
+		void run() {
+			std::vector<char> carry; /* partial line from the end of the previous block */
+			while(true) {
+				size_t i;
+				{
+					std::unique_lock<std::mutex> lock(m);
+					while(!(stop || produced - released < blocks.size())) cv.wait(lock);
+					if(stop) return;
+					i = produced % blocks.size();
+				}
+				block& b = blocks[i];
+				size_t len = carry.size();
+				if(len > b.data.size()) b.data.resize(2*len);
+				if(len) memcpy(b.data.data(),carry.data(),len);
+				carry.clear();
+				bool eof = false;
+				bool err = false;
+				while(true) {
+					while(len < b.data.size()) {
+						long ret = source(b.data.data() + len, b.data.size() - len);
+						if(ret < 0) { err = true; break; }
+						if(ret == 0) { eof = true; break; }
+						len += ret;
+					}
+					if(eof || err) break;
+					/* keep the last partial line for the next block */
+					size_t l2 = len;
+					for(; l2 > 0; l2--) if(b.data[l2-1] == '\n') break;
+					if(l2) {
+						carry.assign(b.data.begin() + l2, b.data.begin() + len);
+						len = l2;
+						break;
+					}
+					b.data.resize(2*b.data.size()); /* line longer than the block */
+				}
+				if(err) {
+					/* keep only complete lines read before the error */
+					for(; len > 0; len--) if(b.data[len-1] == '\n') break;
+				}
+				b.len = len;
+				{
+					std::unique_lock<std::mutex> lock(m);
+					if(len) produced++;
+					if(err) error = true;
+					if(eof) done = true;
+				}
+				cv.notify_all();
+				if(eof || err) return;
+			}
+		}
+};
+
 struct read_table2 : public read_table {
 	public:
 		/* constructor from a file that is already open
@@ -862,6 +1472,12 @@ struct read_table2 : public read_table {
 			 * with two different instances of this class */
 			rt_.buf = 0;
 			rt_.buf_size = 0;
+			rt_.map = 0;
+			rt_.map_base = 0;
+			rt_.mbuf = 0;
+			rt_.mbuf_size = 0;
+			rt_.refill = 0;
+			reader = std::move(rt_.reader);
 			rt_.pos = 0;
 			rt_.line_len = 0;
 			rt_.col = 0;
@@ -869,9 +1485,8 @@ struct read_table2 : public read_table {
 		}
 		/* destructor frees temporary buffer */
 		~read_table2() {
-			if(buf) free(buf);
-			buf = 0;
-			buf_size = 0;
+			reader.reset(); /* note: this needs to be stopped before closing the file */
+			read_table_free_buffers(this);
 			if(flags & READ_TABLE_CLOSE_FILE) if(f) fclose(f);
 			f = 0;
 		}
@@ -956,6 +1571,459 @@ struct read_table2 : public read_table {
 		void write_error(FILE* f) const { read_table_write_error(this,f); }
 		
 		static const read_table_skip_t* skip() { return &_read_table_skip1; }
+		
+		/* read the input in a background thread, in blocks of block_size
+		 * (a ring of nbuffers blocks is used, so the reader thread can
+		 * continue while the previous blocks are parsed); this can be used
+		 * only before reading anything and only if the input is read from
+		 * a file (i.e. not memory mapped); returns true if the reader
+		 * thread was started; the interface and error reporting stay the
+		 * same, only lines are read from the blocks instead of the file */
+		bool start_background_reader(size_t block_size = READ_TABLE_BLOCK_SIZE, unsigned int nbuffers = 3) {
+			if(map || !f || buf || line || last_error != T_OK) return false;
+#ifdef READ_TABLE_ZLIB
+			/* note: this detects and decompresses gzip and zip input */
+			std::shared_ptr<read_table_inflate> src(new read_table_inflate(f));
+			return start_background_reader([src](char* buf_, size_t len) -> long {
+				return src->read(buf_,len);
+			}, block_size, nbuffers);
+#else
+			FILE* f_ = f;
+			return start_background_reader([f_](char* buf_, size_t len) -> long {
+				size_t ret = fread(buf_,1,len,f_);
+				if(ret == 0 && ferror(f_)) return -1;
+				return (long)ret;
+			}, block_size, nbuffers);
+#endif
+		}
+	
+	protected:
+		std::unique_ptr<read_table_reader_thread> reader;
+		
+		/* start reading blocks from the given source in a background thread */
+		bool start_background_reader(read_table_reader_thread::source_t&& source, size_t block_size, unsigned int nbuffers) {
+			reader.reset(new read_table_reader_thread(std::move(source),block_size,nbuffers));
+			map = read_table_empty_map;
+			map_size = 0;
+			map_pos = 0;
+			refill = &read_table2::refill_reader;
+			return true;
+		}
+		static int refill_reader(read_table* r) {
+			read_table2* r2 = static_cast<read_table2*>(r);
+			if(!r2->reader) return 1;
+			const char* data;
+			size_t len;
+			int ret = r2->reader->next_block(&data,&len);
+			if(ret == 0) {
+				r->map = data;
+				r->map_size = len;
+				r->map_pos = 0;
+			}
+			return ret;
+		}
+};
+
+/* same interface as read_table2, but regular files are memory mapped and
+ * parsed in place; other inputs (e.g. pipes) are read normally
+ * compressed files are decompressed in a background thread if compiled with
+ * READ_TABLE_ZLIB */
+struct read_table_mmap : public read_table2 {
+	public:
+		/* open and map the given file */
+		explicit read_table_mmap(const char* fn_) : read_table2((FILE*)0) { open_map(fn_); }
+		/* map the given file if fn_ != 0, otherwise use f_ */
+		read_table_mmap(const char* fn_, FILE* f_) : read_table2((FILE*)0) {
+			if(fn_) open_map(fn_);
+			else map_file(f_);
+		}
+		/* use a file that is already open: it is mapped if it is a regular
+		 * file, starting from the current position; note that the file
+		 * should not be used for anything else while this object exists */
+		explicit read_table_mmap(FILE* f_) : read_table2((FILE*)0) { map_file(f_); }
+		
+		/* true if the input is memory mapped */
+		bool is_mapped() const { return map != 0 && refill == 0; }
+	
+	protected:
+		void open_map(const char* fn_) {
+			fn = fn_;
+			int fd = open(fn_,O_RDONLY | O_CLOEXEC);
+			if(fd == -1) {
+				last_error = T_ERROR_FOPEN;
+				return;
+			}
+			bool compressed = false;
+			if(read_table_map_fd(this,fd,0) == 0) {
+				compressed = unmap_compressed();
+				if(!compressed) {
+					close(fd);
+					return;
+				}
+			}
+			f = fdopen(fd,"r");
+			if(!f) {
+				close(fd);
+				last_error = T_ERROR_FOPEN;
+			}
+			else {
+				flags |= READ_TABLE_CLOSE_FILE;
+				if(compressed) start_background_reader();
+			}
+		}
+		void map_file(FILE* f_) {
+			f = f_;
+			if(!f_) return;
+			if(read_table_map_fd(this,fileno(f_),ftello(f_)) == 0) {
+				if(unmap_compressed()) start_background_reader();
+				else f = 0;
+			}
+		}
+		/* check if the mapped input is compressed; if yes, it is unmapped
+		 * (it needs to be read with start_background_reader()) */
+		bool unmap_compressed() {
+#ifdef READ_TABLE_ZLIB
+			if(read_table_detect_compression(map,map_size) != READ_TABLE_PLAIN) {
+				read_table_free_buffers(this);
+				map_pos = 0;
+				map_prefetch = 0;
+				return true;
+			}
+#endif
+			return false;
+		}
+};
+
+/* parallel reading of a memory mapped input: the input is split into parts
+ * (chunks) at line boundaries and each chunk is parsed by a separate thread
+ * with its own reader; if the input cannot be mapped (e.g. it is a pipe),
+ * it is read sequentially as one chunk
+ * settings (delimiter, comment character) are taken from this object when
+ * starting to read; after an error, this object takes the state of the reader
+ * that encountered it (with the line number counted from the start of the
+ * input), so write_error(), get_line_str(), etc. can be used as normally
+ * 
+ * example:
+read_table_parallel rt(fn,stdin,nthreads);
+std::vector<std::vector<std::pair<uint64_t,double> > > parts(rt.get_nchunks());
+bool ok = rt.read_all([&parts](read_table2& r, unsigned int i) {
+	uint64_t id;
+	double x;
+	if(!r.read(id,x)) return false;
+	parts[i].push_back(std::make_pair(id,x));
+	return true;
+});
+if(!ok) rt.write_error(stderr);
+ * (parts[0], parts[1], etc. contain the data in the same order as in the file)
+ * see also read_all_rows() below for a simpler way for the common case */
+struct read_table_parallel : public read_table_mmap {
+	public:
+		/* open and map the given file (or use f_ if fn_ == 0), to be read
+		 * with (at most) nchunks_ threads */
+		read_table_parallel(const char* fn_, FILE* f_, unsigned int nchunks_) :
+				read_table_mmap(fn_,f_), nchunks(nchunks_) {
+			if(nchunks == 0 || !is_mapped()) nchunks = 1;
+		}
+		
+		/* number of chunks the input will be split into */
+		unsigned int get_nchunks() const { return nchunks; }
+		
+		/* read the whole input: f(read_table2& r, unsigned int chunk) is
+		 * called after reading each line, it should parse the line using r
+		 * and return true on success; chunk is the index of the current chunk,
+		 * which can be used to store the result separately; f is called from
+		 * multiple threads concurrently (but always from the same thread
+		 * for a given chunk)
+		 * returns true if the whole input was read successfully, false if
+		 * there was an error (either when reading or f returned false) */
+		template<class F> bool read_all(F&& f) {
+			if(last_error != T_OK) return false;
+			if(nchunks == 1) {
+				while(read_line()) if(!f(*(read_table2*)this,0U)) return false;
+				return last_error == T_EOF;
+			}
+			
+			/* split input, create a reader for each chunk */
+			std::vector<size_t> starts(nchunks + 1,0);
+			starts[nchunks] = map_size;
+			for(unsigned int i=1;i<nchunks;i++) {
+				size_t s = starts[i-1];
+				size_t s2 = (map_size / nchunks) * i;
+				if(s2 > s) s = s2;
+				const char* c = s ? (const char*)memchr(map + (s-1),'\n',map_size - (s-1)) : map;
+				starts[i] = c ? (c - map) + (s ? 1 : 0) : map_size;
+			}
+			chunks.clear();
+			for(unsigned int i=0;i<nchunks;i++) {
+				chunks.emplace_back(new read_table2((FILE*)0));
+				read_table2& r = *chunks.back();
+				r.map = map + starts[i];
+				r.map_size = starts[i+1] - starts[i];
+				r.fn = fn;
+				r.delim = delim;
+				r.comment = comment;
+				r.base = base;
+				r.flags = flags & READ_TABLE_ALLOW_NAN_INF;
+			}
+			
+			std::vector<char> res(nchunks,0);
+			auto run = [this,&f,&res](unsigned int i) {
+				read_table2& r = *chunks[i];
+				while(r.read_line()) if(!f(r,i)) return;
+				if(r.get_last_error() == T_EOF) res[i] = 1;
+			};
+			std::vector<std::thread> threads;
+			for(unsigned int i=1;i<nchunks;i++) threads.emplace_back(run,i);
+			run(0);
+			for(auto& t : threads) t.join();
+			
+			/* report the first error (i.e. the one closest to the start of the input) */
+			uint64_t lines = 0;
+			for(unsigned int i=0;i<nchunks;i++) {
+				const read_table2& r = *chunks[i];
+				if(!res[i]) {
+					line = lines + r.line;
+					pos = r.pos;
+					col = r.col;
+					buf = r.buf;
+					line_len = r.line_len;
+					last_error = r.last_error;
+					return false;
+				}
+				lines += r.line;
+			}
+			line = lines;
+			line_len = 0;
+			last_error = T_EOF;
+			return true;
+		}
+		
+		/* read the whole input with one read_table_schema object (S) for
+		 * each chunk, i.e. parts[i] will contain the rows in chunk i */
+		template<class S> bool read_all_rows(std::vector<S>& parts) {
+			parts.clear();
+			parts.resize(nchunks);
+			return read_all([&parts](read_table2& r, unsigned int i) { return parts[i].read_row(r); });
+		}
+	
+	protected:
+		unsigned int nchunks;
+		std::vector<std::unique_ptr<read_table2> > chunks;
+};
+
+
+/* marker for values that have to be within bounds in read_table_schema */
+template<class T> struct read_table_bounded { };
+
+/* conversion used by read_table_schema: simple decimal numbers are converted
+ * directly after the usual checks, without the strto* functions and errno;
+ * anything else uses the same function as read_table_next(), so the result
+ * and errors are always the same */
+template<class T> static inline int read_table_schema_next(read_table* r, T& val) {
+	return read_table_next(r,val);
+}
+#ifndef READ_TABLE_NO_FAST_PARSE
+template<> inline int read_table_schema_next(read_table* r, uint64_t& val) {
+	if(read_table_pre_check(r)) return 1;
+	unsigned long long x;
+	const char* c;
+	if(r->base == 10 && (c = read_table_parse_int(r->buf + r->pos,&x,0,19))) {
+		val = x;
+		return read_table_post_check_end(r,c);
+	}
+	return read_table_uint64(r,&val);
+}
+template<> inline int read_table_schema_next(read_table* r, uint32_t& val) {
+	if(read_table_pre_check(r)) return 1;
+	unsigned long long x;
+	const char* c;
+	if(r->base == 10 && (c = read_table_parse_int(r->buf + r->pos,&x,0,19)) && x <= UINT32_MAX) {
+		val = x;
+		return read_table_post_check_end(r,c);
+	}
+	return read_table_uint32(r,&val);
+}
+template<> inline int read_table_schema_next(read_table* r, int64_t& val) {
+	if(read_table_pre_check(r)) return 1;
+	unsigned long long x;
+	int neg;
+	const char* c;
+	if(r->base == 10 && (c = read_table_parse_int(r->buf + r->pos,&x,&neg,18))) {
+		val = neg ? -(int64_t)x : (int64_t)x;
+		return read_table_post_check_end(r,c);
+	}
+	return read_table_int64(r,&val);
+}
+template<> inline int read_table_schema_next(read_table* r, int32_t& val) {
+	if(read_table_pre_check(r)) return 1;
+	unsigned long long x;
+	int neg;
+	const char* c;
+	if(r->base == 10 && (c = read_table_parse_int(r->buf + r->pos,&x,&neg,18)) &&
+			x <= (neg ? 2147483648ULL : 2147483647ULL)) {
+		val = neg ? (int32_t)(-(int64_t)x) : (int32_t)x;
+		return read_table_post_check_end(r,c);
+	}
+	return read_table_int32(r,&val);
+}
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+template<> inline int read_table_schema_next(read_table* r, double& val) {
+	if(read_table_pre_check(r)) return 1;
+	/* note: the result is always finite here */
+	const char* c = read_table_parse_double(r->buf + r->pos,&val);
+	if(c) return read_table_post_check_end(r,c);
+	return read_table_double(r,&val);
+}
+#endif
+#endif
+
+/* description of one field in read_table_schema: type of the value read,
+ * type of the column storing it and the conversion to use */
+template<class T> struct read_table_field {
+	typedef T value_type;
+	typedef std::vector<T> column_type;
+	struct bounds_type { };
+	static int read(read_table* r, T& val, const bounds_type&) { return read_table_schema_next(r,val); }
+	static void push(column_type& col, const T& val) { col.push_back(val); }
+};
+/* skipped field: nothing is stored */
+template<> struct read_table_field<read_table_skip_t> {
+	typedef read_table_skip_t value_type;
+	struct column_type {
+		size_t size() const { return 0; }
+		size_t capacity() const { return 0; }
+		void clear() { }
+		void reserve(size_t) { }
+	};
+	struct bounds_type { };
+	static int read(read_table* r, read_table_skip_t&, const bounds_type&) { return read_table_skip(r); }
+	static void push(column_type&, const read_table_skip_t&) { }
+};
+/* value with bounds (by default, the whole range of T is allowed) */
+template<class T> struct read_table_field<read_table_bounded<T> > {
+	typedef T value_type;
+	typedef std::vector<T> column_type;
+	struct bounds_type {
+		T min;
+		T max;
+		bounds_type() : min(std::numeric_limits<T>::lowest()), max(std::numeric_limits<T>::max()) { }
+	};
+	static int read(read_table* r, T& val, const bounds_type& b) {
+		return read_table_next(r,read_bounds_t<T>(val,b.min,b.max));
+	}
+	static void push(column_type& col, const T& val) { col.push_back(val); }
+};
+
+/* recursive helper to read and store the fields of one row */
+template<size_t I, size_t N> struct read_table_schema_helper {
+	template<class S> static int read(read_table* r, S& s, typename S::row_type& row) {
+		typedef read_table_field<typename std::tuple_element<I,typename S::fields>::type> F;
+		if(F::read(r,std::get<I>(row),std::get<I>(s.bounds))) return 1;
+		return read_table_schema_helper<I+1,N>::read(r,s,row);
+	}
+	template<class S> static void push(S& s, const typename S::row_type& row) {
+		typedef read_table_field<typename std::tuple_element<I,typename S::fields>::type> F;
+		F::push(std::get<I>(s.cols),std::get<I>(row));
+		read_table_schema_helper<I+1,N>::push(s,row);
+	}
+	template<class S> static void clear(S& s) {
+		std::get<I>(s.cols).clear();
+		read_table_schema_helper<I+1,N>::clear(s);
+	}
+	template<class S> static void reserve(S& s, size_t n) {
+		std::get<I>(s.cols).reserve(n);
+		read_table_schema_helper<I+1,N>::reserve(s,n);
+	}
+	template<class S> static size_t memory_usage(const S& s) {
+		typedef read_table_field<typename std::tuple_element<I,typename S::fields>::type> F;
+		return std::get<I>(s.cols).capacity() * sizeof(typename F::value_type) +
+			read_table_schema_helper<I+1,N>::memory_usage(s);
+	}
+};
+template<size_t N> struct read_table_schema_helper<N,N> {
+	template<class S> static int read(read_table*, S&, typename S::row_type&) { return 0; }
+	template<class S> static void push(S&, const typename S::row_type&) { }
+	template<class S> static void clear(S&) { }
+	template<class S> static void reserve(S&, size_t) { }
+	template<class S> static size_t memory_usage(const S&) { return 0; }
+};
+
+/* compile-time description of the fields in each line, reading rows into
+ * separate vectors for each field (struct of arrays)
+ * fields can be any type supported by read_table_next(), read_table_skip_t
+ * (the field is skipped) or read_table_bounded<T> (value of type T which has
+ * to be between the bounds set by set_bounds<I>(), inclusive); the parser for
+ * a row is generated at compile time, and additional fields at the end of
+ * lines are ignored (same as with read_table2::read())
+ * 
+ * example:
+read_table_schema<uint64_t,read_table_skip_t,read_table_bounded<double> > sc;
+sc.set_bounds<2>(0.0,1000.0);
+read_table_mmap rt(fn);
+while(sc.read_rows(rt,65536)) {
+	for(size_t i=0;i<sc.size();i++) process(sc.col<0>()[i],sc.col<2>()[i]);
+	sc.clear();
+}
+if(rt.get_last_error() != T_EOF) rt.write_error(stderr);
+ * 
+ * with read_table_parallel, one schema object can be used for each chunk
+ * and read_row() can be called from the callback */
+template<class... Ts>
+struct read_table_schema {
+	public:
+		typedef std::tuple<Ts...> fields;
+		typedef std::tuple<typename read_table_field<Ts>::value_type...> row_type;
+		static const size_t nfields = sizeof...(Ts);
+		
+		std::tuple<typename read_table_field<Ts>::column_type...> cols;
+		std::tuple<typename read_table_field<Ts>::bounds_type...> bounds;
+		
+		/* column storing field I (an empty object for skipped fields) */
+		template<size_t I> typename std::tuple_element<I,decltype(cols)>::type& col() { return std::get<I>(cols); }
+		template<size_t I> const typename std::tuple_element<I,decltype(cols)>::type& col() const { return std::get<I>(cols); }
+		
+		/* set the bounds for field I (which has to be read_table_bounded) */
+		template<size_t I, class T> void set_bounds(T min, T max) {
+			std::get<I>(bounds).min = min;
+			std::get<I>(bounds).max = max;
+		}
+		
+		/* number of rows stored */
+		size_t size() const { return nrows; }
+		/* remove all rows (memory is kept allocated) */
+		void clear() { read_table_schema_helper<0,nfields>::clear(*this); nrows = 0; }
+		/* reserve space for the given number of rows in total */
+		void reserve(size_t n) { read_table_schema_helper<0,nfields>::reserve(*this,n); }
+		/* memory allocated for the stored rows */
+		size_t memory_usage() const { return read_table_schema_helper<0,nfields>::memory_usage(*this); }
+		
+		/* parse the current line (already read by r.read_line()) and
+		 * store the result; returns false on error (in this case nothing
+		 * is stored and the error is set in r) */
+		bool read_row(read_table2& r) {
+			row_type row;
+			if(read_table_schema_helper<0,nfields>::read(&r,*this,row)) return false;
+			read_table_schema_helper<0,nfields>::push(*this,row);
+			nrows++;
+			return true;
+		}
+		/* read at most max_rows lines from r, adding them to the stored
+		 * rows; returns the number of lines read, which is less than
+		 * max_rows at the end of the input or if there was an error
+		 * (r.get_last_error() is T_EOF in the former case) */
+		size_t read_rows(read_table2& r, size_t max_rows = std::numeric_limits<size_t>::max()) {
+			size_t i = 0;
+			for(;i<max_rows;i++) {
+				if(!r.read_line()) break;
+				if(!read_row(r)) break;
+			}
+			return i;
+		}
+		
+		read_table_schema() : nrows(0) { }
+	
+	protected:
+		size_t nrows;
 };
 
 #endif /* __cplusplus */
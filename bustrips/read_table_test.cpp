@@ -0,0 +1,341 @@
+/*
+ * read_table_test.cpp -- check and time the conversion of numbers in
+ * 	read_table.h
+ * 
+ * 1. the fast conversion of decimal numbers (read_table_strtod(),
+ * read_table_strtoll() and read_table_strtoull()) is compared to the
+ * strto* functions on random strings (random characters and numbers
+ * formatted in different ways): the result (all bits for doubles), the end
+ * position and errno have to be the same; each string is also read as a
+ * field with read_table_double(), read_table_int64() and
+ * read_table_uint64(), which are compared to the same steps done with the
+ * strto* functions (value, position after the field, return value and
+ * error code); the first mismatches are printed and the return value is
+ * nonzero if there were any
+ * 
+ * 2. if given, the path network edges (e.g. toa_payoh_paths_edges.dat,
+ * with the columns ID, ID, distance) and bike trips (9 columns as in
+ * bike_trips.h) are read -r times, and the number of lines read per second
+ * is reported; compile with -DREAD_TABLE_NO_FAST_PARSE to get the same
+ * numbers with only the strto* functions
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+#include "read_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <string>
+
+
+/* statistics of the comparisons */
+struct test_stats {
+	uint64_t n = 0; /* number of comparisons */
+	uint64_t bad = 0; /* number of mismatches */
+	
+	/* print the first few mismatches */
+	void mismatch(const char* what, const std::string& str) {
+		if(bad < 20) fprintf(stderr,"mismatch (%s) for string '%s'\n",what,str.c_str());
+		bad++;
+	}
+};
+
+/* set up r to read the given string as one line */
+static void set_line(read_table* r, const std::string& str, char delim, uint8_t flags) {
+	r->buf = (char*)str.c_str();
+	r->line_len = str.size();
+	r->pos = 0;
+	r->col = 0;
+	r->delim = delim;
+	r->flags = flags;
+	r->last_error = T_OK;
+}
+
+/* reference versions of read_table_double(), read_table_int64() and
+ * read_table_uint64(), using the same steps, but with the strto* functions */
+static int ref_double(read_table* r, double* d) {
+	if(read_table_pre_check(r)) return 1;
+	errno = 0;
+	char* c2;
+	*d = strtod(r->buf + r->pos, &c2);
+	if(read_table_post_check(r,c2)) return 1;
+	if( (r->flags & READ_TABLE_ALLOW_NAN_INF) == 0) {
+		if(isnan(*d) || isinf(*d)) {
+			r->last_error = T_NAN;
+			return 1;
+		}
+	}
+	return 0;
+}
+static int ref_int64(read_table* r, int64_t* i) {
+	if(read_table_pre_check(r)) return 1;
+	errno = 0;
+	char* c2;
+	*i = strtoll(r->buf + r->pos, &c2, r->base);
+	return read_table_post_check(r,c2);
+}
+static int ref_uint64(read_table* r, uint64_t* i) {
+	if(read_table_pre_check(r)) return 1;
+	errno = 0;
+	char* c2;
+	if( ! (isalnum(r->buf[r->pos]) || r->buf[r->pos] == '+') ) {
+		if(r->buf[r->pos] == '-') r->last_error = T_OVERFLOW;
+		else r->last_error = T_FORMAT;
+		*i = 0;
+		return 1;
+	}
+	*i = strtoull(r->buf + r->pos, &c2, r->base);
+	return read_table_post_check(r,c2);
+}
+
+/* compare the result of reading one field with the fast version (r1, ret1,
+ * x1) and the reference (r2, ret2, x2) */
+template<class T>
+static void compare_field(test_stats& s, const char* what, const std::string& str,
+		const read_table& r1, int ret1, const T& x1, const read_table& r2, int ret2, const T& x2) {
+	s.n++;
+	if(ret1 != ret2 || r1.pos != r2.pos || r1.col != r2.col ||
+		r1.last_error != r2.last_error || memcmp(&x1,&x2,sizeof(T))) s.mismatch(what,str);
+}
+
+/* create a random string: random characters, or a number formatted in
+ * different ways, followed by the end of the line or another field */
+static std::string random_string(std::mt19937_64& rng, char delim) {
+	static const char chars[] = "0123456789012345678901234567890123456789+-.eExX \tan";
+	char buf[64];
+	std::string str;
+	unsigned int len = 1 + rng() % 30;
+	switch(rng() % 5) {
+		case 0:
+			for(unsigned int i=0;i<len;i++) str += chars[rng() % (sizeof(chars) - 1)];
+			break;
+		case 1:
+			snprintf(buf,64,"%.*f",(int)(rng() % 12),(double)(int64_t)rng() / (double)(UINT64_C(1) << (rng() % 64)));
+			str = buf;
+			break;
+		case 2:
+			snprintf(buf,64,"%.*g",(int)(1 + rng() % 20),(double)(int64_t)rng() * pow(10.0,(int)(rng() % 80) - 40));
+			str = buf;
+			break;
+		case 3:
+			snprintf(buf,64,"%lld",(long long)(rng() >> (rng() % 64)) * ((rng() & 1) ? -1 : 1));
+			str = buf;
+			break;
+		default:
+			/* numbers around the limits of 64-bit integers */
+			snprintf(buf,64,"%s%llu%s",(rng() & 1) ? "-" : "",
+				(unsigned long long)(UINT64_MAX - rng() % 3) >> (rng() % 2),(rng() & 1) ? "0" : "");
+			str = buf;
+			break;
+	}
+	switch(rng() % 3) {
+		case 0:
+			str += '\n';
+			break;
+		case 1:
+			str += ' ';
+			str += '5';
+			break;
+		default:
+			str += delim ? delim : '\t';
+			str += '5';
+			break;
+	}
+	return str;
+}
+
+/* run the comparisons on n random strings */
+static void run_compare(uint64_t n, uint64_t seed, test_stats& s) {
+	std::mt19937_64 rng(seed);
+	read_table r1, r2;
+	read_table_init(&r1,0);
+	read_table_init(&r2,0);
+	for(uint64_t it = 0; it < n; it++) {
+		char delim = (rng() & 1) ? ',' : 0;
+		uint8_t flags = (rng() & 1) ? READ_TABLE_ALLOW_NAN_INF : 0;
+		std::string str = random_string(rng,delim);
+		set_line(&r1,str,delim,flags);
+		const char* s0 = r1.buf;
+		
+		/* 1. direct comparison to the strto* functions */
+		char *c1, *c2;
+		errno = 0;
+		double d1 = read_table_strtod(&r1,&c1);
+		int e1 = errno;
+		errno = 0;
+		double d2 = strtod(s0,&c2);
+		int e2 = errno;
+		s.n++;
+		if(c1 != c2 || e1 != e2 || memcmp(&d1,&d2,sizeof(double))) s.mismatch("strtod",str);
+		
+		errno = 0;
+		long long i1 = read_table_strtoll(&r1,&c1);
+		e1 = errno;
+		errno = 0;
+		long long i2 = strtoll(s0,&c2,10);
+		e2 = errno;
+		s.n++;
+		if(c1 != c2 || e1 != e2 || i1 != i2) s.mismatch("strtoll",str);
+		
+		errno = 0;
+		unsigned long long u1 = read_table_strtoull(&r1,&c1);
+		e1 = errno;
+		errno = 0;
+		unsigned long long u2 = strtoull(s0,&c2,10);
+		e2 = errno;
+		s.n++;
+		if(c1 != c2 || e1 != e2 || u1 != u2) s.mismatch("strtoull",str);
+		
+		/* 2. reading one field */
+		double fd1 = 0.0, fd2 = 0.0;
+		set_line(&r1,str,delim,flags);
+		set_line(&r2,str,delim,flags);
+		int ret1 = read_table_double(&r1,&fd1);
+		int ret2 = ref_double(&r2,&fd2);
+		compare_field(s,"read_table_double",str,r1,ret1,fd1,r2,ret2,fd2);
+		
+		int64_t fi1 = 0, fi2 = 0;
+		set_line(&r1,str,delim,flags);
+		set_line(&r2,str,delim,flags);
+		ret1 = read_table_int64(&r1,&fi1);
+		ret2 = ref_int64(&r2,&fi2);
+		compare_field(s,"read_table_int64",str,r1,ret1,fi1,r2,ret2,fi2);
+		
+		uint64_t fu1 = 0, fu2 = 0;
+		set_line(&r1,str,delim,flags);
+		set_line(&r2,str,delim,flags);
+		ret1 = read_table_uint64(&r1,&fu1);
+		ret2 = ref_uint64(&r2,&fu2);
+		compare_field(s,"read_table_uint64",str,r1,ret1,fu1,r2,ret2,fu2);
+	}
+}
+
+/* read the edges (is_bike == false) or bike trips from fn repeat times;
+ * returns false on error */
+static bool run_timing(const char* fn, bool is_bike, unsigned int repeat) {
+	uint64_t n = 0;
+	double sum = 0.0; /* checksum (so that parsing is not optimized out) */
+	auto t1 = std::chrono::steady_clock::now();
+	for(unsigned int j = 0; j < repeat; j++) {
+		read_table_mmap rt(fn);
+		while(rt.read_line()) {
+			if(is_bike) {
+				uint64_t trip_id, bike_id, start_node, end_node;
+				int64_t start_ts, end_ts;
+				double start_dist, end_dist, trip_dist;
+				if(!rt.read(trip_id, bike_id, start_ts, end_ts, start_node, start_dist,
+						end_node, end_dist, trip_dist)) {
+					rt.write_error(stderr);
+					return false;
+				}
+				sum += trip_dist;
+			}
+			else {
+				uint64_t n1, n2;
+				double d;
+				if(!rt.read(n1, n2, d)) {
+					rt.write_error(stderr);
+					return false;
+				}
+				sum += d;
+			}
+			n++;
+		}
+		if(rt.get_last_error() != T_EOF) {
+			rt.write_error(stderr);
+			return false;
+		}
+	}
+	double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+	fprintf(stdout,"%s: %lu lines in %.3f s, %.2f million lines / s (checksum: %g)\n",
+		fn, n, t, t > 0.0 ? n / t / 1e6 : 0.0, sum);
+	return true;
+}
+
+
+int main(int argc, char **argv)
+{
+	uint64_t n = 1000000; /* number of random strings to compare */
+	uint64_t seed = 1; /* random seed */
+	const char* edges_fn = 0; /* path network edges to read */
+	const char* bike_fn = 0; /* bike trips to read */
+	unsigned int repeat = 10; /* read the files this many times */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'n':
+				n = strtoull(argv[i+1],0,10);
+				i++;
+				break;
+			case 's':
+				seed = strtoull(argv[i+1],0,10);
+				i++;
+				break;
+			case 'e':
+				edges_fn = argv[i+1];
+				i++;
+				break;
+			case 'b':
+				bike_fn = argv[i+1];
+				i++;
+				break;
+			case 'r':
+				repeat = atoi(argv[i+1]);
+				i++;
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	test_stats s;
+	run_compare(n,seed,s);
+	fprintf(stdout,"%lu comparisons, %lu mismatches\n",s.n,s.bad);
+	
+	if(edges_fn && !run_timing(edges_fn,false,repeat)) {
+		fprintf(stderr,"Error reading file %s!\n",edges_fn);
+		return 1;
+	}
+	if(bike_fn && !run_timing(bike_fn,true,repeat)) {
+		fprintf(stderr,"Error reading file %s!\n",bike_fn);
+		return 1;
+	}
+	
+	return s.bad ? 1 : 0;
+}
+
@@ -40,6 +40,8 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <limits.h>
+#include <string.h>
 
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -47,270 +49,1344 @@
 #include <fcntl.h>
 #include <unistd.h>
 
-#include <unordered_map>
 #include <vector>
 #include <random>
+#include <time.h>
+#include <math.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <atomic>
+#include <set>
 #include "read_table.h"
+#include "flat_hash_map.h"
+#include "alias_table.h"
+#include "philox.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+#include "bus_od.h"
+#include "stage_timer.h"
+#include "distances.h"
 
 
-/*-----------------------------------------------------------------------------
- * pair_hash: combine the hash of two 64-bit unsigned integers
- * 
- * adapted from Murmurhash, from
- * https://github.com/aappleby/smhasher/blob/master/src/MurmurHash2.cpp
- * MurmurHash2, 64-bit versions, by Austin Appleby
- * 64-bit hash for 64-bit platforms
- * 
- * MurmurHash2 was written by Austin Appleby, and is placed in the public
- * domain. The author hereby disclaims copyright to this source code.
-*/
-struct pair_hash {
-	uint64_t seed;
-	explicit pair_hash(uint64_t s = 0xe6573480bcc4fceaUL) : seed(s) { }
-	uint64_t operator () (const std::pair<uint64_t,uint64_t>& p) const {
-		
-		const uint64_t m = 0xc6a4a7935bd1e995UL;
-		const int r = 47;
-		uint64_t h = seed ^ (16UL * m); /* 16UL since we have 16 bytes in total */
-		
-		const std::array<uint64_t,2> a = {p.first, p.second};
-		for(uint64_t k : a) {
-			k *= m; 
-			k ^= k >> r; 
-			k *= m; 
-			
-			h ^= k;
-			h *= m; 
-		}
-		
-		h ^= h >> r;
-		h *= m;
-		h ^= h >> r;
-		
-		return h;
+struct building_node {
+	uint64_t pc; /* postal code */
+	uint64_t nid; /* node id */
+	double dist; /* distance of building to node */
+};
+
+
+struct busstops_pairs_t {
+	flat_hash_map<uint64_t,uint64_t> busstops_pairs;
+	void set(uint64_t n1, uint64_t n2) { busstops_pairs[n1] = n2; }
+	uint64_t get(uint64_t n1) const {
+		auto it = busstops_pairs.find(n1);
+		if(it != busstops_pairs.cend()) n1 = it->second;
+		return n1;
 	}
 };
 
-struct building_node {
+/* simple read-only view of an array, either stored in a vector or in
+ * external memory (e.g. a memory mapped file) */
+template<class T>
+struct array_ref {
+	const T* p;
+	size_t n;
+	array_ref():p(0),n(0) { }
+	void set(const T* p_, size_t n_) { p = p_; n = n_; }
+	void set(const std::vector<T>& v) { p = v.data(); n = v.size(); }
+	const T& operator [] (size_t i) const { return p[i]; }
+	size_t size() const { return n; }
+	const T* begin() const { return p; }
+	const T* end() const { return p + n; }
+};
+
+/* building with the matching node and its index in the distance matrix */
+struct building_t {
 	uint64_t pc; /* postal code */
 	uint64_t nid; /* node id */
 	double dist; /* distance of building to node */
+	uint64_t mid; /* index of the node in the distance matrix */
+	double x; /* coordinates (NaN if not known) */
+	double y;
 };
 
+/* pair of bus stops (indices to the list of buildings grouped by bus stops) */
+struct stop_pair {
+	uint32_t s1;
+	uint32_t s2;
+};
 
-/* generic interface for distances -- store them in a matrix */
-class distances {
-	protected:
-		void* map;
-		double* matrix;
-		size_t n;
-		size_t map_size;
-		std::unordered_map<uint64_t,size_t> ids;
-		int f;
-		const static uint64_t file_id = 0x47a9b290e72d9f21UL;
-		
-	public:
-		distances():map(MAP_FAILED),matrix(0),n(0UL),map_size(0UL),f(-1) { }
-		~distances() { clear(); }
-		
-		void clear() {
-			if(map != MAP_FAILED) munmap(map,map_size);
-			else if(matrix) free(matrix);
-			map = MAP_FAILED;
-			matrix = 0;
-			n = 0;
-			map_size = 0;
-			ids.clear();
-			if(f != -1) close(f);
-			f = -1;
+/* all data needed for sampling, stored in dense arrays: buildings grouped by
+ * bus stops, pairs of bus stops with weights for each hour and the distance
+ * matrix among the nodes; this is either created from the input files or
+ * loaded from a snapshot file */
+struct sampling_state {
+	array_ref<building_t> buildings; /* buildings, grouped by bus stops */
+	array_ref<uint64_t> stop_start; /* index of the first building for each bus stop (has one extra element at the end) */
+	array_ref<stop_pair> pairs; /* pairs of bus stops with trips */
+	array_ref<double> w; /* weights of pairs of bus stops and hours */
+	const double* matrix; /* distance matrix among nodes */
+	uint64_t n; /* size of the distance matrix */
+	bool have_coords; /* building coordinates were loaded */
+
+	/* storage used if created from the input files */
+	std::vector<building_t> buildings_;
+	std::vector<uint64_t> stop_start_;
+	std::vector<stop_pair> pairs_;
+	std::vector<double> w_;
+	distances dists;
+
+	sampling_state():matrix(0),n(0),have_coords(false) { }
+
+	size_t nbuildings(uint32_t stop) const { return stop_start[stop+1] - stop_start[stop]; }
+	const building_t& get_building(uint32_t stop, size_t i) const { return buildings[stop_start[stop] + i]; }
+	double get_dist(const building_t& b1, const building_t& b2) const {
+		return matrix ? matrix[b1.mid*n + b2.mid] : dists.get_dist_idx(b1.mid,b2.mid);
+	}
+	/* distances for nq pairs of matrix indices (see distances::get_dists_idx()) */
+	void get_dists(const std::pair<size_t,size_t>* q, size_t nq, double* out) const {
+		if(matrix) gather_dists(matrix,n,q,nq,out);
+		else dists.get_dists_idx(q,nq,out);
+	}
+
+	/* memory used by the data created from the input files */
+	void add_mem_stats(mem_stats& stats) const {
+		stats.add("buildings",buildings_);
+		stats.add("bus stops",stop_start_);
+		stats.add("pairs of bus stops",pairs_);
+		stats.add("weights",w_);
+		dists.add_mem_stats(stats);
+	}
+
+	/* check that coordinates are available for all buildings */
+	bool check_coords() const {
+		if(!have_coords) return false;
+		for(const auto& b : buildings) if(std::isnan(b.x) || std::isnan(b.y)) {
+			fprintf(stderr,"Error: no coordinates for building %lu!\n",b.pc);
+			return false;
 		}
+		return true;
+	}
+};
+
+/* input files used to create the sampling state; the order here identifies
+ * them in the snapshot file as well */
+enum input_roles { IN_TRIPS = 0, IN_DISTS, IN_DISTS_IDS, IN_BUILDINGS, IN_BUILDINGS_NODES,
+	IN_BUILDINGS_COORDS, IN_BUSSTOPS_PAIRS, IN_EDGES, IN_OD, IN_STOPS, IN_NUM };
+static const char* const input_desc[] = {"aggregated trips (-i)", "distances (-d)", "distance matrix IDs (-I)",
+	"buildings (-b)", "building nodes (-n)", "building coordinates (-B)", "bus stop pairs (-p)",
+	"road network (--edges)", "origin-destination data (--od)", "bus stops (--stops)"};
+
+/* aggregated trips can be also given as a binary weight table (created by
+ * extract_trips -b; only in a regular file, not a pipe): file ID, number of
+ * pairs of bus stops, number of hours, the bus stop IDs for each pair and
+ * the weights for each pair and hour; add(h,n1,n2,w) is called for all
+ * nonzero weights;
+ * returns 1 if fn is a weight table and it was read successfully, 0 if it
+ * is not a weight table and -1 on error (weight_table_id is in bus_od.h) */
+template<class F>
+static int read_weight_table(const char* fn, F&& add) {
+	if(!fn) return 0;
+	FILE* f = fopen(fn,"r");
+	if(!f) return 0; /* error reported when reading it as a text file */
+	/* note: only regular files are checked, reading the header from a pipe
+	 * would consume it, so these are always read as text */
+	struct stat st;
+	if(fstat(fileno(f),&st) || !S_ISREG(st.st_mode)) {
+		fclose(f);
+		return 0;
+	}
+	uint64_t header[3];
+	if(fread(header,sizeof(uint64_t),3,f) != 3 || header[0] != weight_table_id) {
+		fclose(f);
+		return 0;
+	}
+	uint64_t npairs = header[1];
+	if(header[2] != hours) {
+		fprintf(stderr,"Unexpected number of hours in weight table %s!\n",fn);
+		fclose(f);
+		return -1;
+	}
+	if(npairs > ((uint64_t)st.st_size - sizeof(header)) / (2*sizeof(uint64_t) + hours*sizeof(double))) {
+		fprintf(stderr,"Error reading weight table %s!\n",fn);
+		fclose(f);
+		return -1;
+	}
+	std::vector<uint64_t> ids(2*npairs);
+	std::vector<double> w(npairs*hours);
+	if(fread(ids.data(),sizeof(uint64_t),ids.size(),f) != ids.size() ||
+			fread(w.data(),sizeof(double),w.size(),f) != w.size()) {
+		fprintf(stderr,"Error reading weight table %s!\n",fn);
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+	for(uint64_t i=0;i<npairs;i++) for(unsigned int h=0;h<hours;h++)
+		if(w[i*hours + h] != 0.0) add(h,ids[2*i],ids[2*i+1],w[i*hours + h]);
+	return 1;
+}
+
+/* options for distances calculated from the road network (--edges) */
+struct network_dist_opts {
+	size_t cache_size; /* if > 0, calculate distances on demand, with a row cache of this size (in bytes) */
+	double max_dist; /* maximum distance for on demand searches (0: no limit) */
+	const char* cache_fn; /* file to save the rows calculated on demand */
+	network_dist_opts():cache_size(0),max_dist(0.0),cache_fn(0) { }
+};
+
+/* read all input files and create the sampling state; distances can be
+ * read from a file (-d, -I) or calculated from the road network (only
+ * among the nodes of the buildings, either all at once or on demand); trips can be given as aggregated
+ * trips (-i) or as the original origin-destination data, aggregated here
+ * for the given day type; the time for each stage is recorded in timer */
+static bool read_inputs(const char* const* fns, sampling_state& state, unsigned int nthreads,
+		const char* day_type, const network_dist_opts& dopts, stage_timer& timer) {
+	flat_hash_map<std::pair<uint64_t,uint64_t>,unsigned int> ids;
+	std::vector<std::pair<uint64_t,uint64_t> > pairs;
+	std::vector<double>& w = state.w_;
+
+	/* match to nodes (via buildings) and the associated distances */
+	flat_hash_map<uint64_t,std::vector<building_node> > nodes;
+	/* building coordinates */
+	flat_hash_map<uint64_t,std::pair<double,double> > building_coords;
+
+	/* replace bus stop IDs by matched pairs (if given) */
+	busstops_pairs_t busstops_pairs;
+	if(fns[IN_BUSSTOPS_PAIRS]) {
+		read_table2 rt(fns[IN_BUSSTOPS_PAIRS]);
+		while(rt.read_line()) {
+			uint64_t n1,n2;
+			if(!rt.read(n1,n2)) break;
+			busstops_pairs.set(n1,n2);
+		}
+		if(rt.get_last_error() != T_EOF) {
+			fprintf(stderr,"Error reading bus stop pairs:\n");
+			rt.write_error(stderr);
+			return false;
+		}
+	}
+
+	/* read distances between nodes */
+	distances& dists = state.dists;
+
+	if(fns[IN_DISTS_IDS]) {
+		if(!dists.open_dists(fns[IN_DISTS],fns[IN_DISTS_IDS])) return false;
+		timer.stage("opening the distance matrix");
+	}
+	else if(fns[IN_DISTS]) {
+		if(!dists.read_dists(read_table_parallel(fns[IN_DISTS],0,nthreads))) return false;
+		timer.stage("reading the distances");
+	}
+
+
+	/* read match between bus stops, buildings and network nodes */
+	{
+		flat_hash_map<uint64_t,std::pair<uint64_t,double> > buildings_nodes;
+		{
+			read_table2 rt(fns[IN_BUILDINGS_NODES]);
+			rt.set_delim(',');
+			rt.read_line(); /* skip header */
+			while(rt.read_line()) {
+				uint64_t id,nid;
+				double dist;
+				if(!rt.read(id,nid,dist)) break;
+				buildings_nodes[id] = std::make_pair(nid,dist);
+			}
+			if(rt.get_last_error() != T_EOF) {
+				fprintf(stderr,"Error reading building data:\n");
+				rt.write_error(stderr);
+				return false;
+			}
+		}
+		{
+			read_table2 rt(fns[IN_BUILDINGS]);
+			rt.set_delim(',');
+			rt.read_line(); /* skip header */
+			while(rt.read_line()) {
+				building_node n1;
+				uint64_t sid;
+				if(!rt.read(n1.pc,sid)) break;
+				/* replace bus stop ID if it has a pair */
+				sid = busstops_pairs.get(sid);
+				const auto& tmp = buildings_nodes.at(n1.pc);
+				n1.nid = tmp.first;
+				n1.dist = tmp.second;
+				nodes[sid].push_back(n1);
+			}
+			if(rt.get_last_error() != T_EOF) {
+				fprintf(stderr,"Error reading building data:\n");
+				rt.write_error(stderr);
+				return false;
+			}
+		}
+	}
+	timer.stage("reading the buildings");
+
+	/* calculate the distances among the nodes of the buildings (if not read above) */
+	if(!fns[IN_DISTS]) {
+		network net;
+		if(!net.read_edges(fns[IN_EDGES],0,nthreads)) return false;
+		net.freeze();
+		timer.stage("reading the road network");
+		std::vector<uint64_t> nids;
+		for(const auto& x : nodes) for(const auto& b : x.second) nids.push_back(b.nid);
+		if(dopts.cache_size) {
+			if(!dists.open_network(std::move(net),nids,dopts.max_dist,dopts.cache_size,dopts.cache_fn)) return false;
+		}
+		else {
+			if(!dists.compute_dists(net,nids,nthreads)) return false;
+			fprintf(stderr,"distances calculated among %lu nodes\n",dists.size());
+			timer.stage("calculating the distances");
+		}
+	}
+
+	/* read bus trip data */
+	{
+		unsigned int nids = 0;
+		unsigned int lines = 0;
+		/* add cnt trips between bus stops n1 and n2 in hour h */
+		auto add_trips = [&](unsigned int h, uint64_t n1, uint64_t n2, double cnt) {
+			size_t id;
+			/* replace bus stop IDs if any of them has a pair */
+			n1 = busstops_pairs.get(n1);
+			n2 = busstops_pairs.get(n2);
+
+			/* check if both bus stops have associated buildings */
+			if(nodes.count(n1) == 0 || nodes.count(n2) == 0) return;
+
+			auto p = std::make_pair(n1,n2);
+			auto it = ids.find(p);
+			if(it == ids.end()) {
+				id = nids;
+				ids.insert(std::make_pair(p,id));
+				pairs.push_back(p);
+				w.insert(w.end(),hours,0.0);
+				nids++;
+			}
+			else id = it->second;
+			size_t pos = id*hours + h;
+			w[pos] += cnt; /* it's possible that a "pair" has multiple entries */
+			lines++;
+		};
 		
-		bool open_dists(const char* df, const char* fids) {
-			clear();
-			/* load ids first */
-			{
-				std::vector<uint64_t> vids;
-				read_table2 rt(fids);
+		if(fns[IN_OD]) {
+			/* aggregate the original data first */
+			bus_od od;
+			if(!od.read_stops(fns[IN_STOPS],busstops_pairs.busstops_pairs)) return false;
+			if(!od.read_trips(fns[IN_OD],0,day_type,nthreads)) return false;
+			od.combine();
+			od.for_each(add_trips);
+		}
+		else {
+			int res = read_weight_table(fns[IN_TRIPS],add_trips);
+			if(res < 0) return false;
+			if(res == 0) {
+				read_table_mmap rt(fns[IN_TRIPS],stdin);
+				rt.start_background_reader(); /* if the input is not a regular file (e.g. a pipe) */
 				while(rt.read_line()) {
-					uint64_t id;
-					if(!rt.read(id)) break;
-					vids.push_back(id);
+					unsigned int h;
+					uint64_t n1,n2;
+					unsigned int cnt;
+					if(!rt.read(read_bounds(h,0U,23U),n1,n2,cnt)) break;
+					add_trips(h,n1,n2,cnt);
 				}
 				if(rt.get_last_error() != T_EOF) {
-					fprintf(stderr,"distances::open_dists(): Error reading ids:\n");
+					fprintf(stderr,"Error reading trips:\n");
 					rt.write_error(stderr);
 					return false;
 				}
-				
-				for(size_t i=0;i<vids.size();i++) ids.insert(std::make_pair(vids[i],i));
 			}
-			n = ids.size();
-			/* try opening distances file */
-			f = open(df,O_RDONLY | O_CLOEXEC | O_NOATIME);
-			if(f == -1) {
-				fprintf(stderr,"distances::open_dists(): Error opening file %s!\n",df);
-				ids.clear();
-				return false;
+		}
+		fprintf(stderr,"%u records read, %u pairs\n",lines,nids);
+	}
+	timer.stage("reading the trips");
+
+	/* read building coordinates (if needed) */
+	if(fns[IN_BUILDINGS_COORDS]) {
+		read_table2 rt(fns[IN_BUILDINGS_COORDS]);
+		rt.set_delim(',');
+		rt.read_line();
+		while(rt.read_line()) {
+			std::pair<double,double> c;
+			uint64_t id;
+			if(!rt.read(read_bounds_coords(c),id)) break;
+			building_coords[id] = c;
+		}
+		state.have_coords = true;
+		timer.stage("reading the building coordinates");
+	}
+
+	/* convert to dense arrays: bus stops are numbered in the order they
+	 * appear among the pairs, buildings are kept in the original order */
+	flat_hash_map<uint64_t,uint32_t> stops;
+	auto get_stop = [&](uint64_t sid) -> uint32_t {
+		auto it = stops.find(sid);
+		if(it != stops.end()) return it->second;
+		uint32_t s = stops.size();
+		stops.insert(std::make_pair(sid,s));
+		state.stop_start_.push_back(state.buildings_.size());
+		for(const auto& b : nodes.at(sid)) {
+			building_t b2;
+			b2.pc = b.pc;
+			b2.nid = b.nid;
+			b2.dist = b.dist;
+			b2.mid = dists.get_index(b.nid);
+			b2.x = NAN;
+			b2.y = NAN;
+			auto it2 = building_coords.find(b.pc);
+			if(it2 != building_coords.end()) {
+				b2.x = it2->second.first;
+				b2.y = it2->second.second;
 			}
-			{
-				struct stat st;
-				if(fstat(f,&st)) {
-					fprintf(stderr,"distances::open_dists(): Error with stat() on file %s!\n",df);
-					ids.clear();
-					close(f);
-					f = -1;
-					return false;
+			state.buildings_.push_back(b2);
+		}
+		return s;
+	};
+	for(const auto& p : pairs) state.pairs_.push_back(stop_pair{get_stop(p.first),get_stop(p.second)});
+	state.stop_start_.push_back(state.buildings_.size());
+
+	state.buildings.set(state.buildings_);
+	state.stop_start.set(state.stop_start_);
+	state.pairs.set(state.pairs_);
+	state.w.set(state.w_);
+	state.matrix = dists.get_matrix();
+	state.n = dists.size();
+	timer.stage("creating the sampling state");
+	return true;
+}
+
+/* list of building combinations for each pair of bus stops that result in
+ * a trip not longer than the maximum distance; this is used to sample trips
+ * directly among these instead of rejecting the ones that are too long */
+struct building_pairs_t {
+	struct comb_t {
+		uint32_t i1; /* index of buildings in the lists of the two bus stops */
+		uint32_t i2;
+	};
+	array_ref<uint64_t> start; /* index of the first combination for each pair of bus stops (has one extra element at the end) */
+	array_ref<comb_t> comb;
+	std::vector<uint64_t> start_;
+	std::vector<comb_t> comb_;
+
+	size_t size(size_t p) const { return start[p+1] - start[p]; }
+	const comb_t& get(size_t p, size_t i) const { return comb[start[p] + i]; }
+
+	/* calculate all valid combinations for the given pairs of bus stops;
+	 * the fraction of valid combinations for each pair is stored in frac;
+	 * distances are looked up together for batches of pairs of bus stops */
+	void create(const sampling_state& state, double max_dist, std::vector<double>& frac) {
+		start_.clear();
+		comb_.clear();
+		frac.clear();
+		const size_t batch_size = 1048576;
+		std::vector<std::pair<size_t,size_t> > q;
+		std::vector<double> d;
+		size_t p0 = 0; /* first pair of bus stops in the current batch */
+		for(size_t p1 = 0; p1 <= state.pairs.size(); p1++) {
+			if(p1 < state.pairs.size() && (q.empty() ||
+					q.size() + state.nbuildings(state.pairs[p1].s1) * state.nbuildings(state.pairs[p1].s2) <= batch_size)) {
+				const stop_pair& p = state.pairs[p1];
+				for(size_t i1 = 0; i1 < state.nbuildings(p.s1); i1++)
+					for(size_t i2 = 0; i2 < state.nbuildings(p.s2); i2++)
+						q.push_back(std::make_pair(state.get_building(p.s1,i1).mid,state.get_building(p.s2,i2).mid));
+				continue;
+			}
+			/* process the current batch */
+			d.resize(q.size());
+			state.get_dists(q.data(),q.size(),d.data());
+			size_t k = 0;
+			for(;p0 < p1;p0++) {
+				const stop_pair& p = state.pairs[p0];
+				size_t n1 = state.nbuildings(p.s1);
+				size_t n2 = state.nbuildings(p.s2);
+				start_.push_back(comb_.size());
+				for(uint32_t i1 = 0; i1 < n1; i1++) {
+					const building_t& b1 = state.get_building(p.s1,i1);
+					for(uint32_t i2 = 0; i2 < n2; i2++) {
+						const building_t& b2 = state.get_building(p.s2,i2);
+						double dist = b1.dist + b2.dist + d[k++];
+						if(dist <= max_dist) comb_.push_back(comb_t{i1,i2});
+					}
 				}
-				map_size = st.st_size;
+				frac.push_back( (comb_.size() - start_.back()) / ((double)n1 * (double)n2) );
 			}
-			if(map_size != 16 + sizeof(double)*n*n) {
-				fprintf(stderr,"distances::open_dists(): unexpected file size!\n");
-				ids.clear();
-				close(f);
-				f = -1;
-				return false;
+			q.clear();
+			if(p1 < state.pairs.size()) p1--; /* add this pair to the next batch */
+		}
+		start_.push_back(comb_.size());
+		start.set(start_);
+		comb.set(comb_);
+	}
+};
+
+/* data that depends on the maximum distance: building combinations within
+ * it and the distribution of pairs of bus stops and hours to sample from */
+struct max_dist_sampler {
+	double max_dist;
+	bool use_building_pairs;
+	building_pairs_t building_pairs; /* only used if use_building_pairs == true */
+	array_ref<double> w; /* weights of pairs of bus stops and hours */
+	std::vector<double> w_;
+	alias_table adst; /* distribution to sample from (default) */
+	std::discrete_distribution<size_t> dst; /* distribution to sample from in legacy mode */
+
+	/* create the above based on the original weights
+	 * if there is a maximum distance, find the building combinations
+	 * within it and adjust the weights of each pair of bus stops by the
+	 * fraction of valid combinations -- this way, each trip can be directly
+	 * sampled from the valid combinations, with the same result as
+	 * rejecting the trips that are too long */
+	bool create(double max_dist_, bool legacy, const sampling_state& state) {
+		max_dist = max_dist_;
+		use_building_pairs = (max_dist > 0.0 && !legacy);
+		w_.assign(state.w.begin(),state.w.end());
+		w.set(w_);
+		if(use_building_pairs) {
+			std::vector<double> frac;
+			building_pairs.create(state,max_dist,frac);
+			double wsum = 0.0;
+			double wsum2 = 0.0;
+			size_t empty_pairs = 0;
+			for(size_t i=0;i<state.pairs.size();i++) {
+				if(frac[i] == 0.0) empty_pairs++;
+				for(unsigned int h=0;h<hours;h++) {
+					size_t pos = i*hours + h;
+					wsum += w_[pos];
+					w_[pos] *= frac[i];
+					wsum2 += w_[pos];
+				}
 			}
-			map = mmap(0,map_size,PROT_READ,MAP_SHARED,f,0);
-			if(map == MAP_FAILED) {
-				fprintf(stderr,"distances::open_dists(): error with mmap()!\n");
-				ids.clear();
-				close(f);
-				f = -1;
+			if(wsum2 == 0.0) {
+				fprintf(stderr,"Error: no trips possible within the maximum distance (%g)!\n",max_dist);
 				return false;
 			}
-			
-			uint64_t* tmp = (uint64_t*)map;
-			if(tmp[0] != file_id) {
-				fprintf(stderr,"distances::open_dists(): unexpected file ID!\n");
-				clear();
-				return false;
+			fprintf(stderr,"max. distance %g: %lu valid building combinations, %lu pairs without any; "
+				"acceptance rate of rejection sampling would be %f\n",
+				max_dist,building_pairs.comb.size(),empty_pairs,wsum2/wsum);
+		}
+		if(legacy) dst = std::discrete_distribution<size_t>(w.begin(),w.end());
+		return true;
+	}
+
+	/* memory used by the data created for this maximum distance (if the
+	 * snapshot is used, the data there is not included) */
+	void add_mem_stats(mem_stats& stats) const {
+		stats.add("building combination index",building_pairs.start_);
+		stats.add("building combinations",building_pairs.comb_);
+		stats.add("weights",w_);
+		stats.add("alias table",adst);
+		if(stats.is_enabled() && dst.probabilities().size() > 1)
+			stats.add_bytes("discrete distribution",dst.probabilities().size()*sizeof(double));
+	}
+
+	/* create the alias table, possibly loading it from a file or saving it */
+	bool create_alias(const char* alias_in, const char* alias_out) {
+		uint64_t wh = alias_table::weights_hash(w.begin(),w.end());
+		bool loaded = false;
+		if(alias_in) {
+			FILE* f = fopen(alias_in,"r");
+			if(f) {
+				loaded = adst.read(f,wh);
+				fclose(f);
 			}
-			if(tmp[1] != n) {
-				fprintf(stderr,"distances::open_dists(): unexpected size in file (%lu instead of %lu)!\n",tmp[1],n);
-				clear();
+			if(!loaded) fprintf(stderr,"Cannot load alias table from file %s, creating it now\n",alias_in);
+		}
+		if(!loaded) if(!adst.create(w.begin(),w.end())) {
+			fprintf(stderr,"Error: no trips to sample from!\n");
+			return false;
+		}
+		if(alias_out) {
+			FILE* f = fopen(alias_out,"w");
+			if(!f || !adst.write(f,wh)) {
+				fprintf(stderr,"Error writing alias table to file %s!\n",alias_out);
+				if(f) fclose(f);
 				return false;
 			}
-			
-			matrix = (double*)(map+16);
-			return true;
+			fclose(f);
 		}
-		
-		double get_dist(uint64_t n1, uint64_t n2) {
-			n1 = ids.at(n1);
-			n2 = ids.at(n2);
-			return matrix[n1*n+n2];
+		return true;
+	}
+};
+
+
+/* snapshot of the sampling state in a binary file that can be memory
+ * mapped and used directly
+ *
+ * layout: header, followed by the arrays, each starting at an offset that
+ * is a multiple of 8 bytes (offsets are relative to the start of the file):
+ * 	- information about input files (size, modification time, checksum)
+ * 	- buildings (building_t), start index for each bus stop (uint64_t),
+ * 		pairs of bus stops (stop_pair), weights (double)
+ * 	- distance matrix restricted to the nodes of the buildings (double)
+ * 	- for each maximum distance used when saving: building combinations
+ * 		and alias table */
+struct snapshot {
+	struct input_info {
+		uint64_t size; /* file size */
+		int64_t mtime; /* last modification time (in ns) */
+		uint64_t hash; /* checksum of the contents */
+		uint32_t flags; /* whether this file was given / was a regular file */
+		uint32_t reserved;
+	};
+	struct max_dist_info {
+		double max_dist;
+		uint64_t npairs; /* number of pairs -- start has one more element */
+		uint64_t ncomb;
+		uint64_t off_start;
+		uint64_t off_comb;
+		uint64_t off_w;
+		uint64_t off_alias;
+		uint64_t nalias;
+	};
+	struct header {
+		uint64_t file_id;
+		uint32_t version;
+		uint32_t have_coords;
+		uint64_t file_size;
+		uint64_t n; /* size of the distance matrix */
+		uint64_t nbuildings;
+		uint64_t nstops;
+		uint64_t npairs;
+		uint64_t nmax_dist;
+		uint64_t off_inputs;
+		uint64_t off_buildings;
+		uint64_t off_stop_start;
+		uint64_t off_pairs;
+		uint64_t off_w;
+		uint64_t off_matrix;
+		uint64_t off_max_dist;
+	};
+	static const uint64_t file_id = 0x3c81d07a5e29b6f4UL;
+	static const uint32_t version = 2; /* 2: more input files */
+	static const uint32_t INPUT_GIVEN = 1;
+	static const uint32_t INPUT_REGULAR = 2;
+
+	void* map;
+	size_t map_size;
+
+	snapshot():map(MAP_FAILED),map_size(0) { }
+	~snapshot() { if(map != MAP_FAILED) munmap(map,map_size); }
+
+	/* get information about an input file; the checksum is only calculated
+	 * if hash == true */
+	static bool get_input_info(const char* fn, input_info& info, bool hash) {
+		info.size = 0;
+		info.mtime = 0;
+		info.hash = 0;
+		info.flags = 0;
+		info.reserved = 0;
+		if(!fn) return true;
+		info.flags = INPUT_GIVEN;
+		struct stat st;
+		if(stat(fn,&st)) {
+			fprintf(stderr,"snapshot: cannot stat() file %s!\n",fn);
+			return false;
 		}
-		
-		bool read_dists(read_table2& rt) {
-			clear();
-			std::unordered_map<std::pair<uint64_t,uint64_t>,double,pair_hash> dists;
-			while(rt.read_line()) {
-				uint64_t n1,n2;
-				double d;
-				if(!rt.read(n1,n2,d)) break;
-				dists.insert(std::make_pair(std::make_pair(n1,n2),d));
-				dists.insert(std::make_pair(std::make_pair(n2,n1),d));
-			}
-			if(rt.get_last_error() != T_EOF) {
-				fprintf(stderr,"distances::read_dists(): Error reading distances:\n");
-				rt.write_error(stderr);
+		if(!S_ISREG(st.st_mode)) return true; /* pipes, etc. cannot be checked */
+		info.flags |= INPUT_REGULAR;
+		info.size = st.st_size;
+		info.mtime = st.st_mtim.tv_sec * 1000000000L + st.st_mtim.tv_nsec;
+		if(hash) {
+			int f = ::open(fn,O_RDONLY);
+			if(f == -1) {
+				fprintf(stderr,"snapshot: error opening file %s!\n",fn);
 				return false;
 			}
-			std::vector<uint64_t> nids2;
-	
-			for(const auto& x : dists) {
-				if(ids.count(x.first.first) == 0) {
-					ids[x.first.first] = nids2.size();
-					nids2.push_back(x.first.first);
+			/* 64-bit words are mixed into the hash, the last partial word is padded with zeros */
+			uint64_t h = 0xcbf29ce484222325UL ^ info.size;
+			std::vector<uint64_t> buf(131072);
+			while(true) {
+				ssize_t r = read(f,buf.data(),buf.size()*8);
+				if(r < 0) {
+					fprintf(stderr,"snapshot: error reading file %s!\n",fn);
+					close(f);
+					return false;
 				}
-				if(ids.count(x.first.second) == 0) {
-					ids[x.first.second] = nids2.size();
-					nids2.push_back(x.first.second);
+				if(r == 0) break;
+				if(r % 8) memset(((char*)buf.data()) + r, 0, 8 - r%8);
+				size_t nw = (r + 7) / 8;
+				for(size_t i=0;i<nw;i++) {
+					h ^= buf[i];
+					h *= 0x100000001b3UL;
+					h ^= h >> 29;
+				}
+			}
+			close(f);
+			info.hash = h;
+		}
+		return true;
+	}
+
+	/* write the sampling state and the given samplers to a file */
+	static bool save(const char* fn, const char* const* fns, const sampling_state& state,
+			const std::vector<max_dist_sampler>& samplers) {
+		header h;
+		memset(&h,0,sizeof(header));
+		h.file_id = file_id;
+		h.version = version;
+		h.have_coords = state.have_coords ? 1 : 0;
+		h.nbuildings = state.buildings.size();
+		h.nstops = state.stop_start.size() - 1;
+		h.npairs = state.pairs.size();
+
+		/* only nodes that belong to buildings are kept in the matrix */
+		std::vector<building_t> buildings(state.buildings.begin(),state.buildings.end());
+		std::vector<uint64_t> mids;
+		{
+			flat_hash_map<uint64_t,uint64_t> mids2;
+			for(auto& b : buildings) {
+				auto it = mids2.find(b.mid);
+				if(it == mids2.end()) {
+					it = mids2.insert(std::make_pair(b.mid,mids.size())).first;
+					mids.push_back(b.mid);
 				}
+				b.mid = it->second;
 			}
-			
-			n = nids2.size();
-			matrix = (double*)malloc(sizeof(double)*n*n);
-			if(!matrix) {
-				fprintf(stderr,"distances::read_dists(): Error allocating memory!\n");
-				ids.clear();
+		}
+		h.n = mids.size();
+
+		std::vector<input_info> inputs(IN_NUM);
+		for(unsigned int i=0;i<IN_NUM;i++) if(!get_input_info(fns[i],inputs[i],true)) return false;
+
+		std::vector<max_dist_info> mds;
+		for(const auto& ms : samplers) if(ms.use_building_pairs && ms.adst.size()) {
+			max_dist_info md;
+			memset(&md,0,sizeof(md));
+			md.max_dist = ms.max_dist;
+			md.npairs = h.npairs;
+			md.ncomb = ms.building_pairs.comb.size();
+			md.nalias = ms.adst.size();
+			mds.push_back(md);
+		}
+		h.nmax_dist = mds.size();
+
+		/* calculate offsets */
+		uint64_t off = sizeof(header);
+		auto next_off = [&off](uint64_t size) -> uint64_t {
+			uint64_t r = off;
+			off += size;
+			off = (off + 7) & ~7UL;
+			return r;
+		};
+		h.off_inputs = next_off(sizeof(input_info)*IN_NUM);
+		h.off_max_dist = next_off(sizeof(max_dist_info)*mds.size());
+		h.off_buildings = next_off(sizeof(building_t)*h.nbuildings);
+		h.off_stop_start = next_off(sizeof(uint64_t)*(h.nstops+1));
+		h.off_pairs = next_off(sizeof(stop_pair)*h.npairs);
+		h.off_w = next_off(sizeof(double)*state.w.size());
+		h.off_matrix = next_off(sizeof(double)*h.n*h.n);
+		for(auto& md : mds) {
+			md.off_start = next_off(sizeof(uint64_t)*(md.npairs+1));
+			md.off_comb = next_off(sizeof(building_pairs_t::comb_t)*md.ncomb);
+			md.off_w = next_off(sizeof(double)*state.w.size());
+			md.off_alias = next_off(sizeof(alias_table::entry)*md.nalias);
+		}
+		h.file_size = off;
+
+		FILE* f = fopen(fn,"w");
+		if(!f) {
+			fprintf(stderr,"snapshot::save(): error opening file %s!\n",fn);
+			return false;
+		}
+		bool ret = true;
+		uint64_t pos = 0;
+		auto write_at = [&](uint64_t off1, const void* data, size_t size) {
+			static const char zeros[8] = {0,0,0,0,0,0,0,0};
+			if(!ret) return;
+			if(off1 > pos && fwrite(zeros,1,off1-pos,f) != off1-pos) ret = false;
+			pos = off1;
+			if(size && fwrite(data,1,size,f) != size) ret = false;
+			pos += size;
+		};
+		write_at(0,&h,sizeof(header));
+		write_at(h.off_inputs,inputs.data(),sizeof(input_info)*IN_NUM);
+		write_at(h.off_max_dist,mds.data(),sizeof(max_dist_info)*mds.size());
+		write_at(h.off_buildings,buildings.data(),sizeof(building_t)*h.nbuildings);
+		write_at(h.off_stop_start,state.stop_start.begin(),sizeof(uint64_t)*(h.nstops+1));
+		write_at(h.off_pairs,state.pairs.begin(),sizeof(stop_pair)*h.npairs);
+		write_at(h.off_w,state.w.begin(),sizeof(double)*state.w.size());
+		{
+			std::vector<double> row(h.n);
+			for(uint64_t i=0;i<h.n;i++) {
+				for(uint64_t j=0;j<h.n;j++) row[j] = state.matrix[mids[i]*state.n + mids[j]];
+				write_at(h.off_matrix + i*h.n*sizeof(double),row.data(),sizeof(double)*h.n);
+			}
+		}
+		size_t j = 0;
+		for(const auto& ms : samplers) if(ms.use_building_pairs && ms.adst.size()) {
+			const auto& md = mds[j++];
+			write_at(md.off_start,ms.building_pairs.start.begin(),sizeof(uint64_t)*(md.npairs+1));
+			write_at(md.off_comb,ms.building_pairs.comb.begin(),sizeof(building_pairs_t::comb_t)*md.ncomb);
+			write_at(md.off_w,ms.w.begin(),sizeof(double)*state.w.size());
+			write_at(md.off_alias,ms.adst.data(),sizeof(alias_table::entry)*md.nalias);
+		}
+		write_at(h.file_size,0,0);
+		if(fclose(f)) ret = false;
+		if(!ret) fprintf(stderr,"snapshot::save(): error writing file %s!\n",fn);
+		return ret;
+	}
+
+	const header* get_header() const { return (const header*)map; }
+	template<class T> const T* get(uint64_t off) const { return (const T*)(((const char*)map) + off); }
+
+	/* check that an array of n elements of size sz at offset off is after
+	 * the header, inside the file and aligned to 8 bytes */
+	bool check_array(uint64_t off, uint64_t n, uint64_t sz) const {
+		if(off % 8 || off < sizeof(header) || off > map_size) return false;
+		return sz == 0 || n <= (map_size - off) / sz;
+	}
+
+	/* check that all offsets and indices in the snapshot are valid, so
+	 * that a corrupted file cannot result in reading outside of it */
+	bool check_structure() const {
+		const header* h = get_header();
+		/* limits to avoid overflow below */
+		if(h->nstops >= UINT32_MAX || h->npairs >= map_size || h->n >= ((uint64_t)1) << 32) return false;
+		if(!(check_array(h->off_inputs,IN_NUM,sizeof(input_info)) &&
+				check_array(h->off_max_dist,h->nmax_dist,sizeof(max_dist_info)) &&
+				check_array(h->off_buildings,h->nbuildings,sizeof(building_t)) &&
+				check_array(h->off_stop_start,h->nstops+1,sizeof(uint64_t)) &&
+				check_array(h->off_pairs,h->npairs,sizeof(stop_pair)) &&
+				check_array(h->off_w,h->npairs,hours*sizeof(double)) &&
+				check_array(h->off_matrix,h->n,h->n*sizeof(double)))) return false;
+
+		const uint64_t* stop_start = get<uint64_t>(h->off_stop_start);
+		if(stop_start[0] != 0 || stop_start[h->nstops] != h->nbuildings) return false;
+		for(uint64_t i=0;i<h->nstops;i++) if(stop_start[i] > stop_start[i+1]) return false;
+		const building_t* buildings = get<building_t>(h->off_buildings);
+		for(uint64_t i=0;i<h->nbuildings;i++) if(buildings[i].mid >= h->n) return false;
+		const stop_pair* pairs = get<stop_pair>(h->off_pairs);
+		for(uint64_t i=0;i<h->npairs;i++) if(pairs[i].s1 >= h->nstops || pairs[i].s2 >= h->nstops) return false;
+
+		/* samplers: building combinations for each pair and the alias table */
+		const max_dist_info* mds = get<max_dist_info>(h->off_max_dist);
+		for(uint64_t j=0;j<h->nmax_dist;j++) {
+			const max_dist_info& md = mds[j];
+			if(md.npairs != h->npairs || md.nalias != h->npairs*hours || md.ncomb >= map_size) return false;
+			if(!(check_array(md.off_start,md.npairs+1,sizeof(uint64_t)) &&
+					check_array(md.off_comb,md.ncomb,sizeof(building_pairs_t::comb_t)) &&
+					check_array(md.off_w,md.npairs,hours*sizeof(double)) &&
+					check_array(md.off_alias,md.nalias,sizeof(alias_table::entry)))) return false;
+			const uint64_t* start = get<uint64_t>(md.off_start);
+			const building_pairs_t::comb_t* comb = get<building_pairs_t::comb_t>(md.off_comb);
+			if(start[0] != 0 || start[md.npairs] != md.ncomb) return false;
+			for(uint64_t p=0;p<md.npairs;p++) {
+				if(start[p] > start[p+1]) return false;
+				uint64_t n1 = stop_start[pairs[p].s1+1] - stop_start[pairs[p].s1];
+				uint64_t n2 = stop_start[pairs[p].s2+1] - stop_start[pairs[p].s2];
+				for(uint64_t k=start[p];k<start[p+1];k++) if(comb[k].i1 >= n1 || comb[k].i2 >= n2) return false;
+			}
+			/* pairs that can be selected need to have building combinations */
+			const alias_table::entry* alias = get<alias_table::entry>(md.off_alias);
+			for(uint64_t i=0;i<md.nalias;i++) {
+				uint64_t a = alias[i].alias;
+				if(a >= md.nalias || start[a/hours] == start[a/hours + 1]) return false;
+				if(alias[i].thr > 0 && start[i/hours] == start[i/hours + 1]) return false;
+			}
+		}
+		return true;
+	}
+
+	/* open a snapshot and set up state to use it; input files given in fns
+	 * are compared to the ones used when creating the snapshot */
+	bool open(const char* fn, const char* const* fns, sampling_state& state) {
+		int f = ::open(fn,O_RDONLY | O_CLOEXEC);
+		if(f == -1) {
+			fprintf(stderr,"snapshot::open(): error opening file %s!\n",fn);
+			return false;
+		}
+		struct stat st;
+		if(fstat(f,&st)) {
+			fprintf(stderr,"snapshot::open(): error with stat() on file %s!\n",fn);
+			close(f);
+			return false;
+		}
+		map_size = st.st_size;
+		if(map_size < sizeof(header)) {
+			fprintf(stderr,"snapshot::open(): file %s is too short!\n",fn);
+			close(f);
+			return false;
+		}
+		map = mmap(0,map_size,PROT_READ,MAP_SHARED,f,0);
+		close(f);
+		if(map == MAP_FAILED) {
+			fprintf(stderr,"snapshot::open(): error with mmap()!\n");
+			return false;
+		}
+
+		const header* h = get_header();
+		if(h->file_id != file_id) {
+			fprintf(stderr,"snapshot::open(): unexpected file ID!\n");
+			return false;
+		}
+		if(h->version != version) {
+			fprintf(stderr,"snapshot::open(): unsupported version (%u instead of %u)!\n",h->version,version);
+			return false;
+		}
+		if(h->file_size != map_size) {
+			fprintf(stderr,"snapshot::open(): unexpected file size!\n");
+			return false;
+		}
+		if(!check_structure()) {
+			fprintf(stderr,"snapshot::open(): invalid file structure!\n");
+			return false;
+		}
+
+		/* compare the input files */
+		const input_info* inputs = get<input_info>(h->off_inputs);
+		for(unsigned int i=0;i<IN_NUM;i++) if(fns[i]) {
+			if(!(inputs[i].flags & INPUT_GIVEN)) {
+				fprintf(stderr,"snapshot::open(): input file for %s was not used when creating the snapshot!\n",input_desc[i]);
 				return false;
 			}
-			
-			for(uint64_t i=0;i<n;i++) for(uint64_t j=0;j<n;j++) {
-				double dist = 0.0;
-				if(i != j) dist = dists.at(std::make_pair(nids2[i],nids2[j]));
-				matrix[i*n+j] = dist;
+			if(!(inputs[i].flags & INPUT_REGULAR)) {
+				fprintf(stderr,"snapshot::open(): cannot check input file for %s\n",input_desc[i]);
+				continue;
 			}
-			return true;
+			input_info info;
+			if(!get_input_info(fns[i],info,false)) return false;
+			if(!(info.flags & INPUT_REGULAR)) {
+				fprintf(stderr,"snapshot::open(): cannot check input file %s\n",fns[i]);
+				continue;
+			}
+			if(info.size == inputs[i].size && info.mtime == inputs[i].mtime) continue;
+			/* if the size is the same, the file might have been only touched */
+			if(info.size == inputs[i].size) {
+				if(!get_input_info(fns[i],info,true)) return false;
+				if(info.hash == inputs[i].hash) continue;
+			}
+			fprintf(stderr,"snapshot::open(): input file %s changed since creating the snapshot!\n",fns[i]);
+			return false;
 		}
-		bool read_dists(read_table2&& rt) {
-			return read_dists(rt);
+
+		state.buildings.set(get<building_t>(h->off_buildings),h->nbuildings);
+		state.stop_start.set(get<uint64_t>(h->off_stop_start),h->nstops+1);
+		state.pairs.set(get<stop_pair>(h->off_pairs),h->npairs);
+		state.w.set(get<double>(h->off_w),h->npairs*hours);
+		state.matrix = get<double>(h->off_matrix);
+		state.n = h->n;
+		state.have_coords = h->have_coords;
+		fprintf(stderr,"snapshot loaded: %lu buildings, %lu nodes, %lu pairs\n",h->nbuildings,h->n,h->npairs);
+		return true;
+	}
+
+	/* set up sampler for the given maximum distance if it was saved
+	 * in the snapshot; returns false if not found */
+	bool get_sampler(double max_dist, max_dist_sampler& ms) const {
+		if(map == MAP_FAILED) return false;
+		const header* h = get_header();
+		const max_dist_info* mds = get<max_dist_info>(h->off_max_dist);
+		for(uint64_t i=0;i<h->nmax_dist;i++) if(mds[i].max_dist == max_dist) {
+			const max_dist_info& md = mds[i];
+			ms.max_dist = max_dist;
+			ms.use_building_pairs = true;
+			ms.building_pairs.start.set(get<uint64_t>(md.off_start),md.npairs+1);
+			ms.building_pairs.comb.set(get<building_pairs_t::comb_t>(md.off_comb),md.ncomb);
+			ms.w.set(get<double>(md.off_w),md.npairs*hours);
+			ms.adst.attach(get<alias_table::entry>(md.off_alias),md.nalias);
+			return true;
 		}
+		return false;
+	}
 };
 
-struct busstops_pairs_t {
-	std::unordered_map<uint64_t,uint64_t> busstops_pairs;
-	void set(uint64_t n1, uint64_t n2) { busstops_pairs[n1] = n2; }
-	uint64_t get(uint64_t n1) const {
-		auto it = busstops_pairs.find(n1);
-		if(it != busstops_pairs.cend()) n1 = it->second;
-		return n1;
+
+/* one sampled trip */
+struct trip_t {
+	unsigned int ts; /* start time */
+	unsigned int ts2; /* end time */
+	const building_t* b1; /* start building */
+	const building_t* b2; /* end building */
+	double d3; /* distance between the nodes of the buildings */
+};
+
+/* references to all data needed for sampling trips; this is only read
+ * while sampling, so it can be shared among threads */
+struct trip_sampler {
+	const sampling_state& state;
+	const max_dist_sampler& ms;
+	double v; /* speed, in m/s */
+
+	/* fill in the pair and hour given by x, s seconds in the hour and the
+	 * buildings with index i1 and i2 (distance is set by set_dist()) */
+	void set_trip(size_t x, unsigned int s, size_t i1, size_t i2, trip_t& t) const {
+		unsigned int h = x%hours;
+		const stop_pair& p = state.pairs[x/hours];
+		t.b1 = &(state.get_building(p.s1,i1));
+		t.b2 = &(state.get_building(p.s2,i2));
+		t.ts = h*3600 + s;
+	}
+	/* set the distance between the nodes of the buildings and the end time
+	 * returns false if the trip is longer than the maximum distance */
+	bool set_dist(trip_t& t, double d3) const {
+		t.d3 = d3;
+		double dist = t.b1->dist + t.b2->dist + t.d3;
+		if(ms.max_dist > 0.0) if(dist > ms.max_dist) return false;
+		t.ts2 = t.ts + (unsigned int)round(dist / v);
+		return true;
+	}
+	bool make_trip(size_t x, unsigned int s, size_t i1, size_t i2, trip_t& t) const {
+		set_trip(x,s,i1,i2,t);
+		return set_dist(t,state.get_dist(*t.b1,*t.b2));
+	}
+
+	/* sample one trip using the alias table (and the building pairs within
+	 * the maximum distance if needed); this always results in a valid trip;
+	 * the distance is not looked up here, set_dist() has to be called
+	 * after (so that lookups for many trips can be done together) */
+	template<class RNG> void sample(RNG& rng, trip_t& t) const {
+		size_t x = ms.adst(rng);
+		unsigned int s = uniform_index(rng,3600);
+		size_t p1 = x/hours;
+		size_t i1, i2;
+		if(ms.use_building_pairs) {
+			/* select among the combinations within the maximum distance */
+			const auto& c = ms.building_pairs.get(p1,uniform_index(rng,ms.building_pairs.size(p1)));
+			i1 = c.i1;
+			i2 = c.i2;
+		}
+		else {
+			i1 = uniform_index(rng,state.nbuildings(state.pairs[p1].s1));
+			i2 = uniform_index(rng,state.nbuildings(state.pairs[p1].s2));
+		}
+		set_trip(x,s,i1,i2,t);
+	}
+
+	/* sample one trip as previous versions did: using the standard library
+	 * distributions and rejection sampling for the maximum distance
+	 * returns false if the trip needs to be rejected */
+	template<class RNG> bool sample_legacy(RNG& rng, std::discrete_distribution<size_t>& dst,
+			std::uniform_int_distribution<unsigned int>& hdst, trip_t& t) const {
+		size_t x = dst(rng);
+		unsigned int s = hdst(rng);
+		const stop_pair& p = state.pairs[x/hours];
+		size_t n1 = state.nbuildings(p.s1);
+		size_t n2 = state.nbuildings(p.s2);
+		size_t i1 = 0;
+		size_t i2 = 0;
+		if(n1 > 1) {
+			std::uniform_int_distribution<size_t> tmp(0,n1-1);
+			i1 = tmp(rng);
+		}
+		if(n2 > 1) {
+			std::uniform_int_distribution<size_t> tmp(0,n2-1);
+			i2 = tmp(rng);
+		}
+		return make_trip(x,s,i1,i2,t);
 	}
 };
 
+/* format one trip and add it to the output buffers */
+static void write_trip(unsigned int i, const trip_t& t, std::string& out, std::string* out2) {
+	write_table_append(out,'\t',i,i,t.ts,t.ts2,t.b1->nid,t.b1->dist,t.b2->nid,t.b2->dist,t.d3,t.b1->pc,t.b2->pc);
+	if(out2) write_table_append(*out2,',',i,i,t.ts,t.ts2,t.b1->x,t.b1->y,t.b2->x,t.b2->y);
+}
+
+/* write the contents of an output buffer and clear it */
+static bool flush_buffer(std::string& buf, FILE* f) {
+	if(buf.size() && fwrite(buf.data(),1,buf.size(),f) != buf.size()) return false;
+	buf.clear();
+	return true;
+}
+
+/* generate N trips with the given random seed and write them to fout and
+ * fout2 (if not NULL); returns false on error writing the output */
+static bool generate_trips(const trip_sampler& sampler, unsigned int N, uint64_t seed,
+		bool legacy, unsigned int nthreads, FILE* fout, FILE* fout2) {
+	if(legacy) {
+		/* one random sequence, rejecting trips that are too long */
+		std::mt19937_64 rng(seed);
+		std::discrete_distribution<size_t> dst(sampler.ms.dst);
+		std::uniform_int_distribution<unsigned int> hdst(0,3599);
+		std::string out, out2;
+		for(unsigned int i=0;i<N;) {
+			trip_t t;
+			if(!sampler.sample_legacy(rng,dst,hdst,t)) continue;
+			write_trip(i,t,out,fout2 ? &out2 : 0);
+			i++;
+			if(out.size() > 1048576 || i == N)
+				if(!flush_buffer(out,fout) || (fout2 && !flush_buffer(out2,fout2))) return false;
+		}
+		return true;
+	}
+	
+	/* trip i is generated from its own random stream, given by (seed, i),
+	 * so the result does not depend on how trips are divided among threads;
+	 * trips are processed in blocks, the results of each round are
+	 * written out in order */
+	const unsigned int block_size = 16384;
+	if(nthreads == 0) nthreads = 1;
+	std::vector<std::string> out(nthreads), out2(nthreads);
+	auto sample_block = [&](unsigned int start, unsigned int j) {
+		uint64_t i0 = start + (uint64_t)j*block_size;
+		uint64_t i1 = std::min((uint64_t)N, i0 + block_size);
+		if(i1 <= i0) return;
+		philox4x32 r(seed);
+		std::vector<trip_t> trips(i1 - i0);
+		std::vector<std::pair<size_t,size_t> > q(i1 - i0);
+		std::vector<double> d(i1 - i0);
+		for(uint64_t i=i0;i<i1;i++) {
+			trip_t& t = trips[i - i0];
+			r.set(seed,i);
+			sampler.sample(r,t);
+			q[i - i0] = std::make_pair(t.b1->mid,t.b2->mid);
+		}
+		/* distances are looked up for the whole block at once */
+		sampler.state.get_dists(q.data(),q.size(),d.data());
+		for(uint64_t i=i0;i<i1;i++) {
+			trip_t& t = trips[i - i0];
+			sampler.set_dist(t,d[i - i0]);
+			write_trip(i,t,out[j],fout2 ? &out2[j] : 0);
+		}
+	};
+	for(unsigned int start=0;start<N;start += std::min(N - start, block_size*nthreads)) {
+		std::vector<std::thread> threads;
+		for(unsigned int j=1;j<nthreads;j++) threads.emplace_back(sample_block,start,j);
+		sample_block(start,0);
+		for(auto& t : threads) t.join();
+		for(unsigned int j=0;j<nthreads;j++)
+			if(!flush_buffer(out[j],fout) || (fout2 && !flush_buffer(out2[j],fout2))) return false;
+	}
+	return true;
+}
+
+/* compare the speed of looking up distances one by one and in batches for
+ * nq random pairs of nodes; if the matrix is memory mapped, this is done
+ * both after removing it from memory ("cold") and after reading all of it
+ * ("hot") */
+static void bench_dists(distances& dists, size_t nq, uint64_t seed) {
+	const size_t n = dists.size();
+	if(!n || !nq) return;
+	std::mt19937_64 rng(seed);
+	std::vector<std::pair<uint64_t,uint64_t> > q(nq);
+	for(auto& x : q) x = std::make_pair(dists.get_id(uniform_index(rng,n)),dists.get_id(uniform_index(rng,n)));
+	std::vector<double> res1(nq), res2(nq);
+	const double MB = 1048576.0;
+	
+	auto run = [&](const char* name, bool batch, std::vector<double>& res) {
+		auto t1 = std::chrono::steady_clock::now();
+		if(batch) dists.get_dists(q.data(),nq,res.data());
+		else for(size_t k=0;k<nq;k++) res[k] = dists.get_dist(q[k].first,q[k].second);
+		auto t2 = std::chrono::steady_clock::now();
+		double e = std::chrono::duration<double>(t2 - t1).count();
+		fprintf(stderr,"%-24s %10.3f s, %g lookups / s\n",name,e,nq/e);
+	};
+	auto cold = [&]() {
+		if(!dists.drop_cache()) fprintf(stderr,"Could not remove the distance matrix from memory!\n");
+		fprintf(stderr,"distance matrix: %.1f MB, %.1f MB in memory\n",dists.mapped_size() / MB,dists.mapped_resident() / MB);
+	};
+	
+	fprintf(stderr,"%lu lookups among %lu nodes\n",nq,n);
+	if(dists.mapped_size()) {
+		cold();
+		run("one by one (cold):",false,res1);
+		cold();
+		run("in batches (cold):",true,res2);
+		/* read the whole matrix (one element from each page) */
+		double sum = 0.0;
+		for(size_t i=0;i<n;i++) for(size_t j=0;j<n;j+=512) sum += dists.get_dist_idx(i,j);
+		fprintf(stderr,"distance matrix: %.1f MB in memory (checksum: %g)\n",dists.mapped_resident() / MB,sum);
+	}
+	run("one by one (hot):",false,res1);
+	run("in batches (hot):",true,res2);
+	if(res1 != res2) fprintf(stderr,"Error: results differ!\n");
+}
+
+/* parse a list of parameter values: a comma-separated list of values or
+ * ranges given as start:end or start:end:step (end is included); values
+ * larger than max are an error */
+static uint64_t parse_uint(const char* str, char** end) { return strtoull(str,end,10); }
+static double parse_double(const char* str, char** end) { return strtod(str,end); }
+template<class T>
+static bool parse_values(const char* str, std::vector<T>& res, T (*conv)(const char*, char**), T max) {
+	res.clear();
+	while(true) {
+		char* end;
+		T x = conv(str,&end);
+		if(end == str) return false;
+		if(*end == ':') {
+			str = end + 1;
+			T y = conv(str,&end);
+			if(end == str) return false;
+			T step = 1;
+			if(*end == ':') {
+				str = end + 1;
+				step = conv(str,&end);
+				if(end == str || !(step > 0)) return false;
+			}
+			if(y < x || y > max) return false;
+			/* note: calculate the number of steps first to avoid accumulating errors */
+			uint64_t n = (uint64_t)((y - x) / step + 1e-9);
+			for(uint64_t i=0;i<=n;i++) res.push_back(x + i*step);
+		}
+		else {
+			if(x > max) return false;
+			res.push_back(x);
+		}
+		if(*end == 0) return true;
+		if(*end != ',') return false;
+		str = end + 1;
+	}
+}
+
+/* substitute parameter values in an output file name: %N: number of trips,
+ * %R: maximum distance, %s: random seed, %v: speed (in km/h), %%: '%' */
+static std::string output_fn(const char* tmpl, unsigned int N, double R, uint64_t seed, double v) {
+	std::string res;
+	char buf[64];
+	for(;*tmpl;tmpl++) {
+		if(*tmpl == '%' && tmpl[1]) {
+			tmpl++;
+			switch(*tmpl) {
+				case 'N': snprintf(buf,sizeof(buf),"%u",N); break;
+				case 'R': snprintf(buf,sizeof(buf),"%g",R); break;
+				case 's': snprintf(buf,sizeof(buf),"%lu",seed); break;
+				case 'v': snprintf(buf,sizeof(buf),"%g",v); break;
+				case '%': snprintf(buf,sizeof(buf),"%%"); break;
+				default: snprintf(buf,sizeof(buf),"%%%c",*tmpl); break;
+			}
+			res += buf;
+		}
+		else res += *tmpl;
+	}
+	return res;
+}
+
 int main(int argc, char **argv)
 {
-	char* infn = 0; /* input: aggregated trips */
-	char* dist_fn = 0; /* distances between nodes (not bus stops) */
-	char* buildings_fn = 0; /* matching of buildings to bus stops */
-	char* buildings_nodes_fn = 0; /* matching of buildings to nodes */
-	unsigned int N = 1000; /* generate this many trips */
-	double max_dist = 0.0; /* maximum distance to consider */
-	double v = 5000.0 / 3600.0; /* speed of vehicles (with user), in m/s */
-	char* buildings_coords_fn = 0; /* if set, load building coordinates from this file */
-	char* trip_coords_out = 0; /* save trips with coordinates here */
-	char* dists_ids = 0; /* if given, distances are stored in a binary file already */
-	char* busstops_pairs_fn = 0; /* pairs of bus stops to be considered as same */
-	
-	uint64_t seed = time(0);
+	/* input files, see input_roles above:
+	 * aggregated trips, distances between nodes (not bus stops),
+	 * if IDs are given, distances are stored in a binary file already,
+	 * matching of buildings to bus stops, matching of buildings to nodes,
+	 * building coordinates, pairs of bus stops to be considered as same */
+	const char* fns[IN_NUM] = {0};
+	/* parameters: each of these can be given as a list of values, in this
+	 * case trips are generated for all combinations */
+	std::vector<uint64_t> Ns{1000}; /* generate this many trips */
+	std::vector<double> max_dists{0.0}; /* maximum distance to consider */
+	std::vector<double> vs{5.0}; /* speed of vehicles (with user), in km/h */
+	std::vector<uint64_t> seeds{(uint64_t)time(0)};
+	char* trips_out = 0; /* output file (name template) for trips; stdout if not given */
+	char* trip_coords_out = 0; /* save trips with coordinates here (name template) */
+	bool legacy = false; /* if true, use rejection sampling for the maximum distance and
+		the standard library distributions (reproduces the output of previous versions) */
+	char* alias_in = 0; /* if given, try to load the alias table for sampling from this file */
+	char* alias_out = 0; /* if given, save the alias table to this file */
+	size_t bench_draws = 0; /* if > 0, only run a benchmark of sampling with this many draws */
+	size_t bench_lookups = 0; /* if > 0, only run a benchmark of distance lookups (--bench-dists) */
+	unsigned int nthreads = 1; /* number of threads to use for parsing the distances and for sampling */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	char* save_state = 0; /* save the preprocessed state to this file */
+	char* load_state = 0; /* load the preprocessed state from this file instead of the inputs */
+	const char* day_type = "WEEKDAY"; /* day type to use from the origin-destination data (--od) */
+	char* save_dists = 0; /* save the distance matrix to this file (and the IDs to save_dists_ids) */
+	char* save_dists_ids = 0;
+	network_dist_opts dopts; /* distances calculated on demand (--dist-cache) */
+	stage_timer timer; /* time spent in each stage, reported with --timing */
 	
 	for(int i=1;i<argc;i++) {
-		if(argv[i][0] == '-') switch(argv[i][1]) {
+		if(!strcmp(argv[i],"--save-state")) {
+			save_state = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--load-state")) {
+			load_state = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--edges")) {
+			fns[IN_EDGES] = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--od")) {
+			fns[IN_OD] = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--stops")) {
+			fns[IN_STOPS] = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--day-type")) {
+			day_type = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--save-dists")) {
+			save_dists = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--save-dists-ids")) {
+			save_dists_ids = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--dist-cache")) {
+			/* cache size is given in MB */
+			dopts.cache_size = (size_t)(atof(argv[i+1]) * 1048576.0);
+			if(!dopts.cache_size) dopts.cache_size = 1;
+			i++;
+		}
+		else if(!strcmp(argv[i],"--dist-cache-file")) {
+			dopts.cache_fn = argv[i+1];
+			i++;
+		}
+		else if(!strcmp(argv[i],"--bench-dists")) {
+			bench_lookups = strtoul(argv[i+1],0,10);
+			i++;
+		}
+		else if(!strcmp(argv[i],"--timing")) timer = stage_timer(true);
+		else if(argv[i][0] == '-') switch(argv[i][1]) {
 			case 'i':
-				infn = argv[i+1];
+				fns[IN_TRIPS] = argv[i+1];
 				i++;
 				break;
 			case 'd':
-				dist_fn = argv[i+1];
+				fns[IN_DISTS] = argv[i+1];
 				i++;
 				break;
 			case 'N':
-				N = atoi(argv[i+1]);
+				if(!parse_values(argv[i+1],Ns,parse_uint,(uint64_t)UINT_MAX)) {
+					fprintf(stderr,"Invalid number of trips: %s!\n",argv[i+1]);
+					return 1;
+				}
 				i++;
 				break;
 			case 'D':
-				max_dist = atof(argv[i+1]);
+				if(!parse_values(argv[i+1],max_dists,parse_double,HUGE_VAL)) {
+					fprintf(stderr,"Invalid maximum distance: %s!\n",argv[i+1]);
+					return 1;
+				}
 				i++;
 				break;
 			case 's':
-				seed = strtoul(argv[i+1],0,10);
+				if(!parse_values(argv[i+1],seeds,parse_uint,(uint64_t)UINT64_MAX)) {
+					fprintf(stderr,"Invalid random seed: %s!\n",argv[i+1]);
+					return 1;
+				}
 				i++;
 				break;
 			case 'b':
-				buildings_fn = argv[i+1];
+				fns[IN_BUILDINGS] = argv[i+1];
 				i++;
 				break;
 			case 'n':
-				buildings_nodes_fn = argv[i+1];
+				fns[IN_BUILDINGS_NODES] = argv[i+1];
 				i++;
 				break;
 			case 'v':
-				v = atof(argv[i+1]) / 3.6; /* speed is given by user in km / h */
+				/* speed is given by user in km / h */
+				if(!parse_values(argv[i+1],vs,parse_double,HUGE_VAL)) {
+					fprintf(stderr,"Invalid speed: %s!\n",argv[i+1]);
+					return 1;
+				}
+				i++;
+				break;
+			case 'o':
+				trips_out = argv[i+1];
 				i++;
 				break;
 			case 'B':
-				buildings_coords_fn = argv[i+1];
+				fns[IN_BUILDINGS_COORDS] = argv[i+1];
 				i++;
 				break;
 			case 'c':
@@ -318,11 +1394,33 @@ int main(int argc, char **argv)
 				i++;
 				break;
 			case 'I':
-				dists_ids = argv[i+1];
+				fns[IN_DISTS_IDS] = argv[i+1];
 				i++;
 				break;
 			case 'p':
-				busstops_pairs_fn = argv[i+1];
+				fns[IN_BUSSTOPS_PAIRS] = argv[i+1];
+				i++;
+				break;
+			case 'L':
+				legacy = true;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			case 'A':
+				alias_in = argv[i+1];
+				i++;
+				break;
+			case 'a':
+				alias_out = argv[i+1];
+				i++;
+				break;
+			case 'T':
+				bench_draws = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
 				i++;
 				break;
 			default:
@@ -332,200 +1430,208 @@ int main(int argc, char **argv)
 		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
 	}
 	
-	std::mt19937_64 rng(seed);
+	if(nthreads == 0) nthreads = 1;
+	if(legacy && nthreads > 1) {
+		fprintf(stderr,"Legacy sampling uses only one thread!\n");
+		nthreads = 1;
+	}
 	
-	if(dist_fn == 0 || buildings_fn == 0) {
+	if(!load_state && ((fns[IN_DISTS] == 0 && fns[IN_EDGES] == 0) || fns[IN_BUILDINGS] == 0)) {
 		fprintf(stderr,"Error: missing input files!\n");
 		return 1;
 	}
-	if(trip_coords_out && !buildings_coords_fn) {
-		fprintf(stderr,"Error: no building coordinates file given!\n");
+	if(fns[IN_DISTS] && fns[IN_EDGES]) {
+		fprintf(stderr,"Error: only one of -d and --edges can be given!\n");
 		return 1;
 	}
-	
-	//~ std::unordered_map<std::pair<uint64_t,uint64_t>,double,pair_hash> dists;
-	std::unordered_map<std::pair<uint64_t,uint64_t>,unsigned int,pair_hash> ids;
-	std::vector<std::pair<uint64_t,uint64_t> > pairs;
-	std::vector<double> w;
-	const unsigned int hours = 24;
-	
-	/* match to nodes (via buildings) and the associated distances */
-	std::unordered_map<uint64_t,std::vector<building_node> > nodes;
-	/* building coordinates */
-	std::unordered_map<uint64_t,std::pair<double,double> > building_coords;
-	
-	/* replace bus stop IDs by matched pairs (if given) */
-	busstops_pairs_t busstops_pairs;
-	if(busstops_pairs_fn) {
-		read_table2 rt(busstops_pairs_fn);
-		while(rt.read_line()) {
-			uint64_t n1,n2;
-			if(!rt.read(n1,n2)) break;
-			busstops_pairs.set(n1,n2);
+	if(fns[IN_OD] && (fns[IN_TRIPS] || !fns[IN_STOPS])) {
+		fprintf(stderr,"Error: --od needs a list of bus stops (--stops) and cannot be used together with -i!\n");
+		return 1;
+	}
+	if((save_dists == 0) != (save_dists_ids == 0) || (save_dists && load_state)) {
+		fprintf(stderr,"Error: --save-dists and --save-dists-ids need to be given together (and not with --load-state)!\n");
+		return 1;
+	}
+	if(dopts.cache_size || dopts.cache_fn) {
+		if(!fns[IN_EDGES] || !dopts.cache_size) {
+			fprintf(stderr,"Error: --dist-cache needs the road network (--edges)!\n");
+			return 1;
 		}
-		if(rt.get_last_error() != T_EOF) {
-			fprintf(stderr,"Error reading bus stop pairs:\n");
-			rt.write_error(stderr);
+		if(save_dists || save_state) {
+			fprintf(stderr,"Error: the distance matrix or the state cannot be saved with --dist-cache!\n");
 			return 1;
 		}
+		/* searches only need to go as far as the largest maximum distance */
+		for(double R : max_dists) {
+			if(R <= 0.0) {
+				dopts.max_dist = 0.0;
+				break;
+			}
+			if(R > dopts.max_dist) dopts.max_dist = R;
+		}
 	}
-	
-	/* read distances between nodes */
-	distances dists;
-	
-	if(dists_ids) {
-		if(!dists.open_dists(dist_fn,dists_ids)) return 1;
+	if(trip_coords_out && !fns[IN_BUILDINGS_COORDS] && !load_state) {
+		fprintf(stderr,"Error: no building coordinates file given!\n");
+		return 1;
 	}
-	else if(!dists.read_dists(read_table2(dist_fn))) return 1;
-	
-	
-	
-	/* read match between bus stops, buildings and network nodes */
-	{
-		std::unordered_map<uint64_t,std::pair<uint64_t,double> > buildings_nodes;
-		{
-			read_table2 rt(buildings_nodes_fn);
-			rt.set_delim(',');
-			rt.read_line(); /* skip header */
-			while(rt.read_line()) {
-				uint64_t id,nid;
-				double dist;
-				if(!rt.read(id,nid,dist)) break;
-				buildings_nodes[id] = std::make_pair(nid,dist);
-			}
-			if(rt.get_last_error() != T_EOF) {
-				fprintf(stderr,"Error reading building data:\n");
-				rt.write_error(stderr);
-				return 1;
-			}
+	size_t ncomb = Ns.size() * max_dists.size() * seeds.size() * vs.size();
+	if(ncomb > 1) {
+		if(!trips_out) {
+			fprintf(stderr,"Error: output file name template (-o) needed for multiple parameter combinations!\n");
+			return 1;
 		}
-		{
-			read_table2 rt(buildings_fn);
-			rt.set_delim(',');
-			rt.read_line(); /* skip header */
-			while(rt.read_line()) {
-				building_node n1;
-				uint64_t sid;
-				if(!rt.read(n1.pc,sid)) break;
-				/* replace bus stop ID if it has a pair */
-				sid = busstops_pairs.get(sid);
-				const auto& tmp = buildings_nodes.at(n1.pc);
-				n1.nid = tmp.first;
-				n1.dist = tmp.second;
-				nodes[sid].push_back(n1);
-			}
-			if(rt.get_last_error() != T_EOF) {
-				fprintf(stderr,"Error reading building data:\n");
-				rt.write_error(stderr);
+		if(alias_in || alias_out || bench_draws) {
+			fprintf(stderr,"Error: options -A, -a and -T can only be used with one parameter combination!\n");
+			return 1;
+		}
+		/* check that the output file names are unique */
+		std::set<std::string> fns;
+		for(auto N : Ns) for(double R : max_dists) for(auto seed : seeds) for(double v : vs) {
+			if(!fns.insert(output_fn(trips_out,N,R,seed,v)).second ||
+					(trip_coords_out && !fns.insert(output_fn(trip_coords_out,N,R,seed,v)).second)) {
+				fprintf(stderr,"Error: output file names are not unique for all parameter combinations!\n");
 				return 1;
 			}
 		}
 	}
 	
-	/* read bus trip data */
-	{
-		read_table2 rt(infn,stdin);
-		unsigned int nids = 0;
-		unsigned int lines = 0;
-		while(rt.read_line()) {
-			unsigned int h;
-			uint64_t n1,n2;
-			unsigned int cnt;
-			size_t id;
-			if(!rt.read(read_bounds(h,0U,23U),n1,n2,cnt)) break;
-			/* replace bus stop IDs if any of them has a pair */
-			n1 = busstops_pairs.get(n1);
-			n2 = busstops_pairs.get(n2);
-			
-			/* check if both bus stops have associated buildings */
-			if(nodes.count(n1) == 0 || nodes.count(n2) == 0) continue;
-			
-			auto p = std::make_pair(n1,n2);
-			auto it = ids.find(p);
-			if(it == ids.end()) {
-				id = nids;
-				ids.insert(std::make_pair(p,id));
-				pairs.push_back(p);
-				w.insert(w.end(),hours,0.0);
-				nids++;
-			}
-			else id = it->second;
-			size_t pos = id*hours + h;
-			w[pos] += cnt; /* it's possible that a "pair" has multiple entries */
-			lines++;
-		}
-		if(rt.get_last_error() != T_EOF) {
-			fprintf(stderr,"Error reading trips:\n");
-			rt.write_error(stderr);
+	sampling_state state;
+	snapshot snap;
+	if(load_state) {
+		if(!snap.open(load_state,fns,state)) return 1;
+	}
+	else if(!read_inputs(fns,state,nthreads,day_type,dopts,timer)) return 1;
+	if(load_state) timer.stage("loading the snapshot");
+	if(save_dists) {
+		if(!state.dists.save_dists(save_dists,save_dists_ids)) return 1;
+		timer.stage("saving the distances");
+	}
+	state.add_mem_stats(stats);
+	if(load_state) stats.add_mapped("snapshot",snap.map,snap.map_size);
+	stats.report(load_state ? "loading the snapshot" : "reading the inputs");
+	if(bench_lookups) {
+		if(load_state) {
+			fprintf(stderr,"Error: --bench-dists needs the distances, not a snapshot!\n");
 			return 1;
 		}
-		fprintf(stderr,"%u records read, %u pairs\n",lines,nids);
+		bench_dists(state.dists,bench_lookups,seeds[0]);
+		return 0;
+	}
+	if(trip_coords_out && !state.check_coords()) {
+		fprintf(stderr,"Error: building coordinates are not available!\n");
+		return 1;
 	}
 	
-	/* read building coordinates (if needed) */
-	if(buildings_coords_fn && trip_coords_out) {
-		read_table2 rt(buildings_coords_fn);
-		rt.set_delim(',');
-		rt.read_line();
-		while(rt.read_line()) {
-			std::pair<double,double> c;
-			uint64_t id;
-			if(!rt.read(read_bounds_coords(c),id)) break;
-			building_coords[id] = c;
+	/* data depending on the maximum distance is created once for each value
+	 * (or used directly from the snapshot if it was saved there) */
+	std::vector<max_dist_sampler> samplers(max_dists.size());
+	for(size_t j=0;j<max_dists.size();j++) {
+		if(!legacy && !alias_in && snap.get_sampler(max_dists[j],samplers[j])) {
+			if(alias_out && !samplers[j].create_alias(0,alias_out)) return 1;
+			continue;
 		}
+		if(!samplers[j].create(max_dists[j],legacy,state)) return 1;
+		if(!legacy) if(!samplers[j].create_alias(alias_in,alias_out)) return 1;
 	}
+	for(const auto& ms : samplers) ms.add_mem_stats(stats);
+	stats.report("creating the samplers");
+	timer.stage("creating the samplers");
 	
-	std::discrete_distribution<size_t> dst(w.cbegin(),w.cend());
-	std::uniform_int_distribution<unsigned int> hdst(0,3599);
-	
-	FILE* fout = stdout;
-	FILE* fout2 = 0;
-	if(trip_coords_out) {
-		fout2 = fopen(trip_coords_out,"w");
-		if(!fout2) {
-			fprintf(stderr,"Error opening output file %s!\n",trip_coords_out);
+	if(save_state) {
+		if(load_state) {
+			fprintf(stderr,"Error: cannot save the state when loading it from a snapshot!\n");
 			return 1;
 		}
+		if(!snapshot::save(save_state,fns,state,samplers)) return 1;
+		timer.stage("saving the state");
 	}
-	for(unsigned int i=0;i<N;) {
-		size_t x = dst(rng);
-		unsigned int h = x%hours;
-		unsigned int p1 = x/hours;
-		unsigned int ts = h*3600 + hdst(rng);
-		auto p = pairs[p1];
-		
-		const auto& n1 = nodes.at(p.first);
-		const auto& n2 = nodes.at(p.second);
-		
-		/* select random building and corresponding node */
-		size_t i1 = 0;
-		size_t i2 = 0;
-		if(n1.size() > 1) {
-			std::uniform_int_distribution<size_t> tmp(0,n1.size()-1);
-			i1 = tmp(rng);
-		}
-		if(n2.size() > 1) {
-			std::uniform_int_distribution<size_t> tmp(0,n2.size()-1);
-			i2 = tmp(rng);
+	
+	if(bench_draws) {
+		/* compare the speed of the two methods of sampling */
+		const auto& ms = samplers[0];
+		std::mt19937_64 rng(seeds[0]);
+		std::discrete_distribution<size_t> dst(ms.w.begin(),ms.w.end());
+		alias_table adst(ms.w.begin(),ms.w.end());
+		size_t sum = 0;
+		auto t1 = std::chrono::steady_clock::now();
+		for(size_t i=0;i<bench_draws;i++) sum += dst(rng);
+		auto t2 = std::chrono::steady_clock::now();
+		for(size_t i=0;i<bench_draws;i++) sum += adst(rng);
+		auto t3 = std::chrono::steady_clock::now();
+		double e1 = std::chrono::duration<double>(t2 - t1).count();
+		double e2 = std::chrono::duration<double>(t3 - t2).count();
+		fprintf(stderr,"%lu weights, %lu draws (checksum: %lu)\n",ms.w.size(),bench_draws,sum);
+		fprintf(stderr,"std::discrete_distribution: %f s, %g draws / s\n",e1,bench_draws/e1);
+		fprintf(stderr,"alias_table: %f s, %g draws / s\n",e2,bench_draws/e2);
+		return 0;
+	}
+	
+	/* generate trips for one parameter combination, using nthreads1 threads */
+	auto run = [&](unsigned int N, size_t j, uint64_t seed, double vkmh, unsigned int nthreads1) -> bool {
+		FILE* fout = stdout;
+		FILE* fout2 = 0;
+		std::string fn;
+		if(trips_out) {
+			fn = output_fn(trips_out,N,max_dists[j],seed,vkmh);
+			fout = fopen(fn.c_str(),"w");
+			if(!fout) {
+				fprintf(stderr,"Error opening output file %s!\n",fn.c_str());
+				return false;
+			}
 		}
-		
-		double d1 = n1[i1].dist;
-		double d2 = n2[i2].dist;
-		double d3 = dists.get_dist(n1[i1].nid,n2[i2].nid);
-		double dist = d1+d2+d3;
-		if(max_dist > 0.0) if(dist > max_dist) continue;
-		
-		unsigned int ts2 = ts + (unsigned int)round(dist / v);
-		
-		fprintf(fout,"%u\t%u\t%u\t%u\t%lu\t%f\t%lu\t%f\t%f\t%lu\t%lu\n",i,i,ts,ts2,n1[i1].nid,d1,n2[i2].nid,d2,d3,n1[i1].pc,n2[i2].pc);
-		if(fout2) {
-			const auto& c1 = building_coords.at(n1[i1].pc);
-			const auto& c2 = building_coords.at(n2[i2].pc);
-			fprintf(fout2,"%u,%u,%u,%u,%f,%f,%f,%f\n",i,i,ts,ts2,c1.first,c1.second,c2.first,c2.second);
+		if(trip_coords_out) {
+			std::string fn2 = output_fn(trip_coords_out,N,max_dists[j],seed,vkmh);
+			fout2 = fopen(fn2.c_str(),"w");
+			if(!fout2) {
+				fprintf(stderr,"Error opening output file %s!\n",fn2.c_str());
+				if(trips_out) fclose(fout);
+				return false;
+			}
 		}
-		i++;
+		double v = vkmh / 3.6; /* speed is given by user in km / h */
+		trip_sampler sampler{state,samplers[j],v};
+		bool ret = generate_trips(sampler,N,seed,legacy,nthreads1,fout,fout2);
+		if(!ret) fprintf(stderr,"Error writing output!\n");
+		if(fout2) fclose(fout2);
+		if(trips_out) fclose(fout);
+		return ret;
+	};
+	
+	if(ncomb == 1) {
+		if(!run(Ns[0],0,seeds[0],vs[0],nthreads)) return 1;
+		stats.report("generating the trips");
+		timer.stage("generating the trips");
+		state.dists.report_cache();
+		timer.report();
+		return 0;
 	}
 	
+	/* parameter sweep: each combination is processed by one thread, threads
+	 * take the next combination from a shared counter; all loaded data is
+	 * shared (read-only) */
+	std::atomic<size_t> next(0);
+	std::atomic<bool> error(false);
+	auto worker = [&]() {
+		while(!error) {
+			size_t k = next++;
+			if(k >= ncomb) break;
+			size_t k1 = k;
+			size_t iv = k1 % vs.size(); k1 /= vs.size();
+			size_t is = k1 % seeds.size(); k1 /= seeds.size();
+			size_t iN = k1 % Ns.size(); k1 /= Ns.size();
+			if(!run(Ns[iN],k1,seeds[is],vs[iv],1)) error = true;
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int j=1;j<nthreads && j<ncomb;j++) threads.emplace_back(worker);
+	worker();
+	for(auto& t : threads) t.join();
+	if(error) return 1;
+	fprintf(stderr,"%lu parameter combinations processed\n",ncomb);
+	stats.report("generating the trips");
+	timer.stage("generating the trips");
+	state.dists.report_cache();
+	timer.report();
+	
 	return 0;
 }
-
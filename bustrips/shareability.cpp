@@ -0,0 +1,418 @@
+/*
+ * shareability.cpp -- build the shareability network of trips: two trips
+ * 	are connected if one vehicle can serve both of them together, with
+ * 	both passengers arriving at most a given time later than if they
+ * 	traveled alone
+ * 
+ * trips are read in the format of sample_trips3 or the bike trip files
+ * (trip ID, other ID, start time, end time, start node, start distance,
+ * end node, ...; only the start time and the nodes are used); travel times
+ * between nodes are calculated from the distances (see distances.h) and
+ * the vehicle speed
+ * 
+ * for trips i and j with ts_i <= ts_j, the vehicle can pick up either of
+ * them first, and drop off either of them first (4 possible orders); it
+ * starts at the first pickup at its start time and waits if it arrives at
+ * the second pickup before its start time; an order is feasible if both
+ * trips are dropped off at most max_delay seconds later than the direct
+ * trip would arrive
+ * 
+ * trips are processed in the order of their start time; for trip i, only
+ * trips j starting before i could be dropped off need to be considered
+ * (ts_j <= ts_i + t_i + max_delay); among these, pairs are first filtered
+ * with lower bounds on the distances among their start and end nodes,
+ * based on the triangle inequality with the distances to a few landmark
+ * nodes (chosen as far from each other as possible, -L, default 8);
+ * distances are only looked up for the pairs that remain; this helps most
+ * if distances are calculated on demand (--edges with --dist-cache) or the
+ * distance matrix is large; with a small matrix, -L 0 can be faster;
+ * trips are processed in parallel (-t)
+ * 
+ * output is a binary edge list (-b): a header (file ID, number of trips,
+ * number of edges), the trip IDs (uint64_t, in the order of the input
+ * file), then the edges as pairs of indices into the trips (uint32_t, the
+ * smaller index first); edges are ordered by the start time of the
+ * earlier trip; with -o, the edges are written as pairs of trip IDs in text
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include "read_table.h"
+#include "write_table.h"
+#include "mem_stats.h"
+#include "network.h"
+#include "distances.h"
+#include "bike_trips.h"
+#include "stage_timer.h"
+#include "trip_inputs.h"
+
+
+/* one trip, with the indices of its nodes */
+struct share_trip {
+	double ts; /* start time */
+	double t; /* travel time of the direct trip */
+	uint32_t o, d; /* indices of the start and end nodes in the distance matrix */
+	uint32_t idx; /* index of the trip in the input */
+};
+
+/* 8 floats, processed together with SIMD instructions (GCC extension) */
+typedef float share_v8f __attribute__((vector_size(32)));
+typedef int32_t share_v8i __attribute__((vector_size(32)));
+
+/* parameters and data shared by the threads */
+struct share_params {
+	const distances& dists;
+	double v; /* speed, in m/s */
+	double max_delay; /* in seconds */
+	/* number of landmarks, rounded up to a multiple of 8 (extra ones
+	 * have all distances as 0) */
+	unsigned int nl;
+	/* distance of the start and end nodes of each trip from the landmarks
+	 * (nl values for each, in the same order as the trips); NaN if there
+	 * is no path, these are skipped in the comparisons */
+	std::vector<float> lm;
+	
+	/* lower bounds on the distances between the start and end nodes of
+	 * trips i and j (indices in the sorted trips), returned as travel
+	 * times in lb: o_i -> o_j, o_j -> d_i, o_i -> d_j and d_i -> d_j */
+	void lower_bounds(size_t i, size_t j, double* lb) const {
+		const float* oi = lm.data() + 2*i*nl;
+		const float* di = oi + nl;
+		const float* oj = lm.data() + 2*j*nl;
+		const float* dj = oj + nl;
+		share_v8f m[4];
+		for(unsigned int k=0;k<4;k++) m[k] = share_v8f{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+		for(unsigned int l=0;l<nl;l+=8) {
+			share_v8f x[4];
+			memcpy(x,oi+l,sizeof(share_v8f));
+			memcpy(x+1,di+l,sizeof(share_v8f));
+			memcpy(x+2,oj+l,sizeof(share_v8f));
+			memcpy(x+3,dj+l,sizeof(share_v8f));
+			share_v8f z[4] = {x[0] - x[2], x[2] - x[1], x[0] - x[3], x[1] - x[3]};
+			for(unsigned int k=0;k<4;k++) {
+				z[k] = (z[k] < 0.0f) ? -z[k] : z[k];
+				m[k] = (z[k] > m[k]) ? z[k] : m[k]; /* false for NaN */
+			}
+		}
+		for(unsigned int k=0;k<4;k++) {
+			/* maximum of the 8 elements: compare with the elements shifted by 4, 2 and 1 */
+			share_v8f y = __builtin_shuffle(m[k],share_v8i{4, 5, 6, 7, 0, 1, 2, 3});
+			m[k] = (y > m[k]) ? y : m[k];
+			y = __builtin_shuffle(m[k],share_v8i{2, 3, 0, 1, 6, 7, 4, 5});
+			m[k] = (y > m[k]) ? y : m[k];
+			y = __builtin_shuffle(m[k],share_v8i{1, 0, 3, 2, 5, 4, 7, 6});
+			m[k] = (y > m[k]) ? y : m[k];
+			/* distances are stored as float, allow for their rounding */
+			lb[k] = (m[k][0] * (1.0 - 1e-6) - 1e-3) / v;
+		}
+	}
+};
+
+/* check if the vehicle can serve two trips in a given order: after picking
+ * up the second passenger at time t, it takes t1 time to drop off the first
+ * one (with deadline dl1), then t2 more to drop off the other (deadline dl2) */
+static inline bool share_order(double t, double t1, double dl1, double t2, double dl2) {
+	t += t1;
+	return (t <= dl1) & (t + t2 <= dl2); /* no branches, these are hard to predict */
+}
+
+/* counts of pairs processed in each step */
+struct share_counts {
+	uint64_t candidates = 0; /* pairs in the time window */
+	uint64_t pruned = 0; /* pairs filtered by the lower bounds */
+	uint64_t edges = 0; /* feasible pairs */
+	void add(const share_counts& c) {
+		candidates += c.candidates;
+		pruned += c.pruned;
+		edges += c.edges;
+	}
+};
+
+/* find the pairs of trips that can be shared with trip i (the trips
+ * are sorted by start time); the pairs found are added to edges */
+static void share_trip_pairs(const share_params& p, const std::vector<share_trip>& trips, size_t i,
+		std::vector<std::pair<uint32_t,uint32_t> >& edges, share_counts& cnt) {
+	const share_trip& a = trips[i];
+	double dla = a.ts + a.t + p.max_delay; /* latest arrival of a */
+	/* b has to be picked up before a is dropped off */
+	for(size_t j=i+1;j<trips.size() && trips[j].ts <= dla;j++) {
+		const share_trip& b = trips[j];
+		cnt.candidates++;
+		double dlb = b.ts + b.t + p.max_delay;
+		/* possible orders: o_a, o_b, d_a, d_b (A); o_a, o_b, d_b, d_a (B);
+		 * o_b, o_a, d_b, d_a (C); o_b, o_a, d_a, d_b (D); first check them
+		 * with lower bounds on the travel times between the start and end
+		 * nodes of the two trips (from the landmarks, or 0 if these are
+		 * not used); the time from start to end of the same trip is known */
+		double lb[4] = {0.0, 0.0, 0.0, 0.0};
+		if(p.nl) p.lower_bounds(i,j,lb);
+		double pa = std::max(a.ts + lb[0],b.ts); /* earliest pickup of b after a */
+		double pb = std::max(b.ts + lb[0],a.ts); /* and of a after b */
+		bool possible[4] = { share_order(pa,lb[1],dla,lb[3],dlb), share_order(pa,b.t,dlb,lb[3],dla),
+			share_order(pb,lb[2],dlb,lb[3],dla), share_order(pb,a.t,dla,lb[3],dlb) };
+		if(!(possible[0] | possible[1] | possible[2] | possible[3])) {
+			cnt.pruned++;
+			continue;
+		}
+		
+		/* check the possible orders with the actual travel times (only
+		 * looked up when needed) */
+		double tt[6] = {NAN, NAN, NAN, NAN, NAN, NAN};
+		auto travel_time = [&](unsigned int k, uint32_t x, uint32_t y) {
+			if(std::isnan(tt[k])) tt[k] = p.dists.get_dist_idx(x,y) / p.v;
+			return tt[k];
+		};
+		bool ok = false;
+		if(possible[0] || possible[1]) {
+			double t = std::max(a.ts + travel_time(0,a.o,b.o),b.ts);
+			ok = (possible[0] && share_order(t,travel_time(1,b.o,a.d),dla,travel_time(2,a.d,b.d),dlb)) ||
+				(possible[1] && share_order(t,b.t,dlb,travel_time(3,b.d,a.d),dla));
+		}
+		if(!ok && (possible[2] || possible[3])) {
+			double t = std::max(b.ts + travel_time(4,b.o,a.o),a.ts);
+			ok = (possible[2] && share_order(t,travel_time(5,a.o,b.d),dlb,travel_time(3,b.d,a.d),dla)) ||
+				(possible[3] && share_order(t,a.t,dla,travel_time(2,a.d,b.d),dlb));
+		}
+		if(ok) {
+			edges.push_back(std::make_pair(std::min(a.idx,b.idx),std::max(a.idx,b.idx)));
+			cnt.edges++;
+		}
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	trip_inputs inputs; /* trips, distances (-i, -d, -I, --edges, --dist-cache) and --timing */
+	const char* out_fn = 0; /* text output */
+	const char* binary_fn = 0; /* binary output */
+	double vkmh = 20.0; /* speed of the vehicle, in km/h */
+	double max_delay = 300.0; /* maximum delay, in seconds */
+	unsigned int nl = 8; /* number of landmarks */
+	unsigned int nthreads = std::thread::hardware_concurrency(); /* number of threads to use */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(inputs.parse_option(argv,i)) continue;
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'o':
+				out_fn = argv[i+1];
+				i++;
+				break;
+			case 'b':
+				binary_fn = argv[i+1];
+				i++;
+				break;
+			case 'v':
+				vkmh = atof(argv[i+1]);
+				i++;
+				break;
+			case 'T':
+				max_delay = atof(argv[i+1]);
+				i++;
+				break;
+			case 'L':
+				nl = atoi(argv[i+1]);
+				i++;
+				break;
+			case 't':
+				nthreads = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!inputs.check()) return 1;
+	if(!out_fn && !binary_fn) {
+		fprintf(stderr,"Error: no output file given!\n");
+		return 1;
+	}
+	if(!(vkmh > 0.0) || max_delay < 0.0) {
+		fprintf(stderr,"Error: invalid speed or delay!\n");
+		return 1;
+	}
+	if(nthreads == 0) nthreads = 1;
+	stage_timer timer(inputs.timing);
+	
+	/* read the trips */
+	std::vector<bike_trip> trips_in;
+	if(!inputs.read_trips(nthreads,UINT32_MAX,trips_in)) return 1;
+	size_t n = trips_in.size();
+	timer.stage("reading the trips");
+	
+	/* distances among the nodes of the trips */
+	distances dists;
+	if(!inputs.read_dists(trips_in,nthreads,dists)) return 1;
+	timer.stage("reading the distances");
+	
+	/* trips sorted by start time, with node indices */
+	std::vector<share_trip> trips(n);
+	std::vector<uint32_t> nodes; /* indices of nodes used by the trips */
+	for(size_t i=0;i<n;i++) {
+		share_trip& t = trips[i];
+		t.ts = trips_in[i].start_ts;
+		t.o = dists.get_index(trips_in[i].start_node);
+		t.d = dists.get_index(trips_in[i].end_node);
+		t.idx = i;
+		nodes.push_back(t.o);
+		nodes.push_back(t.d);
+	}
+	std::sort(nodes.begin(),nodes.end());
+	nodes.erase(std::unique(nodes.begin(),nodes.end()),nodes.end());
+	std::vector<uint64_t> trip_ids(n);
+	for(size_t i=0;i<n;i++) trip_ids[i] = trips_in[i].trip_id;
+	trips_in.clear();
+	trips_in.shrink_to_fit();
+	
+	share_params p{dists, vkmh / 3.6, max_delay, 0, std::vector<float>()};
+	{
+		/* travel times of the trips */
+		std::vector<std::pair<size_t,size_t> > q(n);
+		std::vector<double> d(n);
+		for(size_t i=0;i<n;i++) q[i] = std::make_pair(trips[i].o,trips[i].d);
+		dists.get_dists_idx(q.data(),n,d.data());
+		for(size_t i=0;i<n;i++) trips[i].t = d[i] / p.v;
+	}
+	std::stable_sort(trips.begin(),trips.end(),[](const share_trip& a, const share_trip& b) { return a.ts < b.ts; });
+	
+	/* landmarks: each is the node farthest from the ones chosen before
+	 * (the first is the one farthest from an arbitrary node) */
+	if(nl > nodes.size()) nl = nodes.size();
+	if(nl) {
+		size_t nn = nodes.size();
+		std::vector<double> lm(nn*nl); /* distances of all nodes from the landmarks */
+		std::vector<double> mind(nn,INFINITY), row(nn);
+		std::vector<std::pair<size_t,size_t> > q(nn);
+		size_t cur = 0;
+		for(unsigned int l=0;l<=nl;l++) {
+			for(size_t i=0;i<nn;i++) q[i] = std::make_pair(nodes[cur],nodes[i]);
+			dists.get_dists_idx(q.data(),nn,row.data());
+			if(l > 0) for(size_t i=0;i<nn;i++) {
+				lm[i*nl + (l-1)] = row[i];
+				mind[i] = std::min(mind[i],row[i]);
+			}
+			else mind = row;
+			size_t next = cur;
+			for(size_t i=0;i<nn;i++) if(mind[i] < INFINITY && (mind[next] == INFINITY || mind[i] > mind[next])) next = i;
+			cur = next;
+		}
+		p.nl = 8*((nl + 7) / 8);
+		p.lm.resize(2*n*p.nl,0.0f);
+		for(size_t k=0;k<2*n;k++) {
+			uint32_t x = (k % 2) ? trips[k/2].d : trips[k/2].o;
+			size_t i = std::lower_bound(nodes.begin(),nodes.end(),x) - nodes.begin();
+			for(unsigned int l=0;l<nl;l++) {
+				double y = lm[i*nl + l];
+				p.lm[k*p.nl + l] = (y < INFINITY) ? (float)y : NAN;
+			}
+		}
+	}
+	timer.stage("preparing the trips");
+	stats.add("trips",trips);
+	stats.add("trip IDs",trip_ids);
+	stats.add("landmark distances",p.lm);
+	dists.add_mem_stats(stats);
+	stats.report("preparing the trips");
+	
+	/* find the pairs in parallel, in blocks of trips */
+	const size_t block = 256;
+	size_t nblocks = (n + block - 1) / block;
+	std::vector<std::vector<std::pair<uint32_t,uint32_t> > > edges(nblocks);
+	std::vector<share_counts> counts(nthreads);
+	std::atomic<size_t> next(0);
+	auto worker = [&](unsigned int k) {
+		while(true) {
+			size_t b = next++;
+			if(b >= nblocks) break;
+			for(size_t i=b*block;i<std::min(n,(b+1)*block);i++) share_trip_pairs(p,trips,i,edges[b],counts[k]);
+		}
+	};
+	std::vector<std::thread> threads;
+	for(unsigned int k=1;k<nthreads && k<nblocks;k++) threads.emplace_back(worker,k);
+	worker(0);
+	for(auto& t : threads) t.join();
+	share_counts cnt;
+	for(const auto& c : counts) cnt.add(c);
+	fprintf(stderr,"%lu pairs in the time window, %lu filtered by the lower bounds, %lu edges\n",
+		cnt.candidates,cnt.pruned,cnt.edges);
+	timer.stage("finding the pairs");
+	stats.add("trips",trips);
+	stats.add("trip IDs",trip_ids);
+	stats.add("landmark distances",p.lm);
+	stats.add("edges",edges);
+	dists.add_mem_stats(stats);
+	stats.report("finding the pairs");
+	
+	/* write the output */
+	if(binary_fn) {
+		const uint64_t file_id = 0x5ac7e2d4190b38f6UL;
+		uint64_t header[3] = {file_id, n, cnt.edges};
+		write_table w(binary_fn);
+		w.write_data(header,sizeof(header));
+		w.write_data(trip_ids.data(),n*sizeof(uint64_t));
+		for(const auto& e : edges) w.write_data(e.data(),e.size()*sizeof(std::pair<uint32_t,uint32_t>));
+		if(!w.close()) {
+			fprintf(stderr,"Error writing file %s!\n",binary_fn);
+			return 1;
+		}
+	}
+	if(out_fn) {
+		write_table w(out_fn);
+		for(const auto& e : edges) for(const auto& x : e) w.write_row(trip_ids[x.first],trip_ids[x.second]);
+		if(!w.close()) {
+			fprintf(stderr,"Error writing file %s!\n",out_fn);
+			return 1;
+		}
+	}
+	timer.stage("writing the output");
+	timer.report();
+	dists.report_cache();
+	return 0;
+}
+
@@ -0,0 +1,104 @@
+/*  -*- C++ -*-
+ * stage_timer.h -- simple report of the time spent in each stage of a
+ * 	program
+ * 
+ * stage_timer records the wall clock and CPU time (of all threads of the
+ * process) elapsed since the end of the previous stage (or creating the
+ * timer) each time a stage is finished; the report lists these with the
+ * share of each stage in the total; if not enabled, nothing is recorded
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef STAGE_TIMER_H
+#define STAGE_TIMER_H
+
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+
+class stage_timer {
+	protected:
+		struct item {
+			std::string name;
+			double wall; /* elapsed time in seconds */
+			double cpu; /* CPU time used by the process in seconds */
+		};
+		std::vector<item> items;
+		std::chrono::steady_clock::time_point last;
+		double last_cpu;
+		bool enabled;
+		
+		static double cpu_time() {
+			struct timespec ts;
+			if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID,&ts)) return 0.0;
+			return ts.tv_sec + ts.tv_nsec * 1e-9;
+		}
+	
+	public:
+		explicit stage_timer(bool enabled_ = false):last(std::chrono::steady_clock::now()),
+			last_cpu(cpu_time()),enabled(enabled_) { }
+		bool is_enabled() const { return enabled; }
+		
+		/* finish the current stage and start a new one */
+		void stage(const char* name) {
+			if(!enabled) return;
+			auto now = std::chrono::steady_clock::now();
+			double cpu = cpu_time();
+			items.push_back(item{name,std::chrono::duration<double>(now - last).count(),cpu - last_cpu});
+			last = now;
+			last_cpu = cpu;
+		}
+		
+		/* write the time spent in each stage */
+		void report(FILE* f = stderr) const {
+			if(!enabled) return;
+			double total = 0.0;
+			double total_cpu = 0.0;
+			for(const item& x : items) {
+				total += x.wall;
+				total_cpu += x.cpu;
+			}
+			fprintf(f,"time spent in each stage:\n");
+			for(const item& x : items)
+				fprintf(f,"\t%-32s %10.3f s %5.1f%% (CPU: %.3f s)\n",x.name.c_str(),x.wall,
+					total > 0.0 ? 100.0 * x.wall / total : 0.0,x.cpu);
+			fprintf(f,"\t%-32s %10.3f s        (CPU: %.3f s)\n","total",total,total_cpu);
+		}
+};
+
+#endif
+
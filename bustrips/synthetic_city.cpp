@@ -0,0 +1,518 @@
+/*
+ * synthetic_city.cpp -- generate a synthetic road network with buildings,
+ * 	bus stops and bus trips, in the formats used by the other programs
+ * 	here, e.g. to test how they scale with the size of the input
+ * 
+ * nodes are on a grid with the given spacing (-g, in meters) and are
+ * connected to their neighbors; with -m planar (the default), nodes are
+ * moved randomly (by at most -j times the spacing in both directions), a
+ * fraction of the edges is removed (-r, keeping the network connected)
+ * and a diagonal edge is added in a fraction of the cells (-q); with
+ * -m grid, the network is a regular grid; edge lengths are the distances
+ * between the nodes; coordinates are calculated around a given point
+ * (-c lon,lat, by default in Singapore)
+ * 
+ * buildings are placed uniformly at random and matched to the nearest
+ * node; bus stops are placed in the middle of blocks of -S x -S grid
+ * points and serve the buildings in their block; bus trips
+ * are generated for each origin stop among -k destination stops, with a
+ * distance that follows an exponential distribution (with mean -L
+ * meters); the number of trips per stop per day (-d) is multiplied by a
+ * random factor (lognormal) and distributed among the hours following a
+ * typical weekday profile, with Poisson noise
+ * 
+ * output files are created with the prefix given by -o:
+ *   prefix_edges.dat -- edges (node IDs, distance), as toa_payoh_paths_edges.dat
+ *   prefix_nodes.dat -- node IDs and coordinates, as osm/sg_osm_nodes.dat
+ *   prefix_buildings.csv -- building coordinates, as
+ *     toa_payoh_buildings_osm_center_filtered.csv (-B for sample_trips3)
+ *   prefix_buildings_nodes.csv -- buildings matched to nodes, as
+ *     toa_payoh_buildings_osm_center_nodes.csv (-n for sample_trips3)
+ *   prefix_buildings_busstops.csv -- buildings matched to bus stops, as
+ *     toa_payoh_buildings_osm_center_busstops.csv (-b for sample_trips3)
+ *   prefix_busstops.csv -- bus stop codes and coordinates, as
+ *     busstops_toa_payoh.csv (-s for extract_trips)
+ *   prefix_busstops_nodes.dat -- bus stops matched to nodes, as
+ *     busstops_all_nodes.dat (-p for nodes_distances)
+ *   prefix_od.dat -- weekday trips by hour and pair of bus stops, as
+ *     the output of extract_trips (-i for sample_trips3)
+ *   prefix_od_raw.csv -- (only with -R) the same trips in the format of
+ *     the LTA DataMall origin-destination data (-i for extract_trips),
+ *     with the same weekday trips, and weekend trips as well
+ * 
+ * node and building IDs are scrambled (so that they are not consecutive,
+ * similarly to OSM IDs); bus stop codes are consecutive from 10000; the
+ * output only depends on the parameters and the random seed (-s)
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <utility>
+#include "write_table.h"
+#include "mem_stats.h"
+#include "philox.h"
+
+
+/* relative number of weekday bus trips in each hour */
+static const double hour_profile[24] = {0.3, 0.05, 0.02, 0.02, 0.1, 0.8, 2.5, 4.2,
+	3.6, 2.4, 2.0, 2.1, 2.4, 2.3, 2.2, 2.4, 2.9, 3.9, 3.8, 2.7, 1.9, 1.6, 1.2, 0.7};
+/* number of weekend trips relative to weekdays (with the same profile) */
+static const double weekend_factor = 0.5;
+
+/* random streams used for the different parts of the output (with the
+ * stop index added for the trips) */
+enum : uint64_t { stream_nodes = 1, stream_edges = 2, stream_stops = 3,
+	stream_buildings = 4, stream_trips = 1UL << 32 };
+
+/* unique IDs from consecutive indices: multiplication by an odd number is
+ * a bijection modulo 2^40 */
+static inline uint64_t scramble_id(uint64_t i, uint64_t mul) {
+	return ((i * mul) & ((((uint64_t)1) << 40) - 1)) + 1;
+}
+static const uint64_t node_id_mul = 0x9E3779B97F4A7C15UL;
+static const uint64_t building_id_mul = 0xC2B2AE3D27D4EB4FUL;
+static const uint64_t first_stop_code = 10000;
+
+/* conversion of coordinates in meters (relative to the center) to
+ * longitude and latitude (equirectangular projection) */
+struct synth_coords {
+	double lon0, lat0;
+	double dlat; /* degrees per meter */
+	double dlon;
+	synth_coords(double lon, double lat):lon0(lon),lat0(lat) {
+		dlat = 180.0 / (M_PI * 6371000.0);
+		dlon = dlat / cos(lat * M_PI / 180.0);
+	}
+	double lon(double x) const { return lon0 + x*dlon; }
+	double lat(double y) const { return lat0 + y*dlat; }
+};
+
+/* union-find to keep track of the connected components while removing edges */
+struct synth_components {
+	std::vector<uint32_t> parent;
+	explicit synth_components(uint32_t n):parent(n) {
+		for(uint32_t i=0;i<n;i++) parent[i] = i;
+	}
+	uint32_t find(uint32_t i) {
+		while(parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+	/* join the components of i and j; returns false if they were already the same */
+	bool join(uint32_t i, uint32_t j) {
+		i = find(i);
+		j = find(j);
+		if(i == j) return false;
+		parent[i] = j;
+		return true;
+	}
+	size_t memory_usage() const { return mem_size(parent); }
+};
+
+/* output file name */
+static std::string synth_fn(const char* prefix, const char* name) {
+	return std::string(prefix) + name;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char* prefix = 0; /* prefix of the output files */
+	uint64_t nnodes = 10000; /* number of nodes (rounded up to a full grid) */
+	uint64_t width = 0; /* number of nodes in one row (default: square grid) */
+	double spacing = 25.0; /* grid spacing, in meters */
+	bool planar = true; /* if false, the network is a regular grid */
+	double jitter = 0.3; /* maximum displacement of nodes, relative to the spacing */
+	double remove_frac = 0.1; /* fraction of edges removed */
+	double diag_frac = 0.25; /* fraction of cells with a diagonal edge */
+	double lon0 = 103.85; /* coordinates of the center */
+	double lat0 = 1.35;
+	double buildings_per_node = 0.11;
+	uint64_t stop_step = 10; /* one bus stop for each stop_step x stop_step nodes */
+	unsigned int ndest = 20; /* number of destinations for each bus stop */
+	double trip_len = 1500.0; /* mean distance between the bus stops of trips, in meters */
+	double stop_trips = 2000.0; /* mean number of trips starting at a bus stop */
+	uint64_t seed = 1;
+	bool raw_od = false; /* write the trips also in the original format */
+	mem_stats stats; /* memory usage of the main data structures, reported with -M */
+	for(int i=1;i<argc;i++) {
+		if(argv[i][0] == '-') switch(argv[i][1]) {
+			case 'o':
+				prefix = argv[i+1];
+				i++;
+				break;
+			case 'n':
+				nnodes = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'w':
+				width = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'g':
+				spacing = atof(argv[i+1]);
+				i++;
+				break;
+			case 'm':
+				if(!strcmp(argv[i+1],"grid")) planar = false;
+				else if(!strcmp(argv[i+1],"planar")) planar = true;
+				else {
+					fprintf(stderr,"Unknown network type: %s!\n",argv[i+1]);
+					return 1;
+				}
+				i++;
+				break;
+			case 'j':
+				jitter = atof(argv[i+1]);
+				i++;
+				break;
+			case 'r':
+				remove_frac = atof(argv[i+1]);
+				i++;
+				break;
+			case 'q':
+				diag_frac = atof(argv[i+1]);
+				i++;
+				break;
+			case 'c':
+				if(sscanf(argv[i+1],"%lf,%lf",&lon0,&lat0) != 2) {
+					fprintf(stderr,"Invalid coordinates: %s!\n",argv[i+1]);
+					return 1;
+				}
+				i++;
+				break;
+			case 'b':
+				buildings_per_node = atof(argv[i+1]);
+				i++;
+				break;
+			case 'S':
+				stop_step = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'k':
+				ndest = atoi(argv[i+1]);
+				i++;
+				break;
+			case 'L':
+				trip_len = atof(argv[i+1]);
+				i++;
+				break;
+			case 'd':
+				stop_trips = atof(argv[i+1]);
+				i++;
+				break;
+			case 's':
+				seed = strtoul(argv[i+1],0,10);
+				i++;
+				break;
+			case 'R':
+				raw_od = true;
+				break;
+			case 'M':
+				stats = mem_stats(true);
+				break;
+			default:
+				fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+				break;
+		}
+		else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+	}
+	
+	if(!prefix) {
+		fprintf(stderr,"Error: no output prefix given!\n");
+		return 1;
+	}
+	if(nnodes < 4 || !(spacing > 0.0) || stop_step == 0 || !(trip_len > 0.0) || stop_trips < 0.0 ||
+			buildings_per_node < 0.0 || remove_frac < 0.0 || remove_frac > 1.0 || diag_frac < 0.0 || diag_frac > 1.0) {
+		fprintf(stderr,"Error: invalid parameters!\n");
+		return 1;
+	}
+	if(planar && (jitter < 0.0 || jitter >= 0.5)) {
+		fprintf(stderr,"Error: node displacement has to be less than half of the spacing!\n");
+		return 1;
+	}
+	if(!planar) jitter = 0.0;
+	
+	if(width == 0) width = (uint64_t)ceil(sqrt((double)nnodes));
+	const uint64_t w = width;
+	const uint64_t h = (nnodes + w - 1) / w;
+	if(w < 2 || h < 2 || w*h >= (uint64_t)UINT32_MAX) {
+		fprintf(stderr,"Error: invalid network size!\n");
+		return 1;
+	}
+	const uint32_t n = w*h;
+	const synth_coords coords(lon0,lat0);
+	/* position of a grid point (in meters, relative to the center) */
+	auto grid_x = [&](double gx) { return (gx - 0.5*(w-1)) * spacing; };
+	auto grid_y = [&](double gy) { return (gy - 0.5*(h-1)) * spacing; };
+	/* grid point closest to a position */
+	auto grid_node = [&](double x, double y) -> uint32_t {
+		double gx = round(x / spacing + 0.5*(w-1));
+		double gy = round(y / spacing + 0.5*(h-1));
+		gx = std::min(std::max(gx,0.0),(double)(w-1));
+		gy = std::min(std::max(gy,0.0),(double)(h-1));
+		return (uint32_t)gy * w + (uint32_t)gx;
+	};
+	std::uniform_real_distribution<double> uniform(0.0,1.0);
+	
+	/* 1. nodes */
+	std::vector<double> x(n), y(n);
+	{
+		philox4x32 r(seed,stream_nodes);
+		for(uint32_t i=0;i<n;i++) {
+			x[i] = grid_x(i % w);
+			y[i] = grid_y(i / w);
+			if(jitter > 0.0) {
+				x[i] += (2.0*uniform(r) - 1.0) * jitter * spacing;
+				y[i] += (2.0*uniform(r) - 1.0) * jitter * spacing;
+			}
+		}
+		write_table out(synth_fn(prefix,"_nodes.dat").c_str());
+		for(uint32_t i=0;i<n;i++) out.write_row(scramble_id(i,node_id_mul),coords.lon(x[i]),coords.lat(y[i]));
+		if(!out.close()) {
+			fprintf(stderr,"Error writing the nodes!\n");
+			return 1;
+		}
+	}
+	stats.add_bytes("nodes",mem_size(x) + mem_size(y));
+	/* node closest to a position: nodes are moved by less than half of the
+	 * spacing, so it is at most two rows or columns from the closest grid point */
+	auto nearest_node = [&](double px, double py) -> uint32_t {
+		uint32_t i = grid_node(px,py);
+		int64_t gx = i % w;
+		int64_t gy = i / w;
+		uint32_t best = i;
+		double dbest = hypot(px - x[i],py - y[i]);
+		if(jitter > 0.0) for(int64_t b=std::max(gy-2,(int64_t)0);b<=std::min(gy+2,(int64_t)h-1);b++)
+			for(int64_t a=std::max(gx-2,(int64_t)0);a<=std::min(gx+2,(int64_t)w-1);a++) {
+				uint32_t j = b*w + a;
+				double d = hypot(px - x[j],py - y[j]);
+				if(d < dbest) {
+					dbest = d;
+					best = j;
+				}
+			}
+		return best;
+	};
+	
+	/* 2. edges: edge 2*i connects node i to its right neighbor, edge 2*i+1
+	 * to the one above it; removed edges that connect separate components
+	 * are added back (in random order) */
+	uint64_t nedges = 0;
+	{
+		philox4x32 r(seed,stream_edges);
+		std::vector<char> keep(2*(size_t)n,0);
+		synth_components comp(n);
+		std::vector<uint64_t> removed;
+		for(uint32_t i=0;i<n;i++) for(unsigned int k=0;k<2;k++) {
+			uint32_t j = k ? (i + w) : (i + 1);
+			if(k ? (i / w == h - 1) : (i % w == w - 1)) continue;
+			if(!planar || uniform(r) >= remove_frac) {
+				keep[2*(size_t)i + k] = 1;
+				comp.join(i,j);
+			}
+			else removed.push_back(2*(size_t)i + k);
+		}
+		std::shuffle(removed.begin(),removed.end(),r);
+		for(uint64_t e : removed) {
+			uint32_t i = e / 2;
+			if(comp.join(i,(e % 2) ? (i + w) : (i + 1))) keep[e] = 1;
+		}
+		stats.add_bytes("edges",mem_size(keep) + mem_size(removed));
+		stats.add("components",comp);
+		
+		write_table out(synth_fn(prefix,"_edges.dat").c_str());
+		auto write_edge = [&](uint32_t i, uint32_t j) {
+			out.write_row(scramble_id(i,node_id_mul),scramble_id(j,node_id_mul),hypot(x[i] - x[j],y[i] - y[j]));
+			nedges++;
+		};
+		for(uint32_t i=0;i<n;i++) {
+			if(keep[2*(size_t)i]) write_edge(i,i+1);
+			if(keep[2*(size_t)i + 1]) write_edge(i,i+w);
+			/* diagonal in the cell above and to the right of node i */
+			if(planar && i % w != w - 1 && i / w != h - 1 && uniform(r) < diag_frac) {
+				if(uniform(r) < 0.5) write_edge(i,i+w+1);
+				else write_edge(i+1,i+w);
+			}
+		}
+		if(!out.close()) {
+			fprintf(stderr,"Error writing the edges!\n");
+			return 1;
+		}
+	}
+	stats.report("generating the network");
+	
+	/* 3. bus stops, in the middle of stop_step x stop_step blocks of nodes */
+	const uint64_t sw = (w + stop_step - 1) / stop_step;
+	const uint64_t sh = (h + stop_step - 1) / stop_step;
+	const uint64_t nstops = sw*sh;
+	if(nstops > 65535) fprintf(stderr,"Warning: %lu bus stops, extract_trips can use at most 65535!\n",nstops);
+	std::vector<double> sx(nstops), sy(nstops);
+	{
+		philox4x32 r(seed,stream_stops);
+		write_table out(synth_fn(prefix,"_busstops.csv").c_str());
+		write_table out2(synth_fn(prefix,"_busstops_nodes.dat").c_str());
+		out.set_delim(',');
+		out.write_row("BusStopCode","Latitude","Longitude");
+		for(uint64_t s=0;s<nstops;s++) {
+			uint64_t a = (s % sw) * stop_step;
+			uint64_t b = (s / sw) * stop_step;
+			sx[s] = grid_x(a + 0.5*(std::min(stop_step,w - a) - 1));
+			sy[s] = grid_y(b + 0.5*(std::min(stop_step,h - b) - 1));
+			if(jitter > 0.0) {
+				sx[s] += (2.0*uniform(r) - 1.0) * jitter * spacing;
+				sy[s] += (2.0*uniform(r) - 1.0) * jitter * spacing;
+			}
+			uint32_t i = nearest_node(sx[s],sy[s]);
+			out.write_row(first_stop_code + s,coords.lat(sy[s]),coords.lon(sx[s]));
+			out2.write_row(first_stop_code + s,scramble_id(i,node_id_mul),hypot(sx[s] - x[i],sy[s] - y[i]));
+		}
+		if(!out.close() || !out2.close()) {
+			fprintf(stderr,"Error writing the bus stops!\n");
+			return 1;
+		}
+	}
+	stats.add_bytes("bus stops",mem_size(sx) + mem_size(sy));
+	
+	/* 4. buildings, matched to the closest node and the bus stop of its block */
+	const uint64_t nbuildings = (uint64_t)llround(n * buildings_per_node);
+	{
+		philox4x32 r(seed,stream_buildings);
+		write_table out(synth_fn(prefix,"_buildings.csv").c_str());
+		write_table out_nodes(synth_fn(prefix,"_buildings_nodes.csv").c_str());
+		write_table out_stops(synth_fn(prefix,"_buildings_busstops.csv").c_str());
+		out.set_delim(',');
+		out_nodes.set_delim(',');
+		out_stops.set_delim(',');
+		out.write_row("X","Y","osmid","amenity","building","id");
+		out_nodes.write_row("InputID","TargetID","Distance");
+		out_stops.write_row("InputID","TargetID","Distance");
+		for(uint64_t k=0;k<nbuildings;k++) {
+			double bx = grid_x(uniform(r)*w - 0.5);
+			double by = grid_y(uniform(r)*h - 0.5);
+			uint32_t i = nearest_node(bx,by);
+			uint32_t g = grid_node(bx,by);
+			uint64_t s = ((g / w) / stop_step) * sw + (g % w) / stop_step;
+			uint64_t id = scramble_id(k,building_id_mul);
+			out.write_row(coords.lon(bx),coords.lat(by),id,"","yes",1);
+			out_nodes.write_row(id,scramble_id(i,node_id_mul),hypot(bx - x[i],by - y[i]));
+			out_stops.write_row(id,first_stop_code + s,hypot(bx - sx[s],by - sy[s]));
+		}
+		if(!out.close() || !out_nodes.close() || !out_stops.close()) {
+			fprintf(stderr,"Error writing the buildings!\n");
+			return 1;
+		}
+	}
+	
+	/* 5. trips: destinations of each stop are drawn at a random distance
+	 * and direction (repeated if this is outside the area or at the same
+	 * stop); trips of the same pair are combined */
+	uint64_t ntrips = 0;
+	uint64_t nrecords = 0;
+	{
+		double total_profile = 0.0;
+		for(double p : hour_profile) total_profile += p;
+		const double sigma = 0.5; /* of the lognormal factor of the number of trips of each stop */
+		std::normal_distribution<double> normal(0.0,1.0);
+		std::exponential_distribution<double> dist(1.0 / trip_len);
+		write_table out(synth_fn(prefix,"_od.dat").c_str(),true);
+		std::string raw_fn = synth_fn(prefix,"_od_raw.csv");
+		write_table out_raw(raw_od ? raw_fn.c_str() : 0,(FILE*)0,true);
+		out_raw.set_delim(',');
+		if(raw_od) out_raw.write_row("YEAR_MONTH","DAY_TYPE","TIME_PER_HOUR","PT_TYPE","ORIGIN_PT_CODE",
+			"DESTINATION_PT_CODE","TOTAL_TRIPS");
+		std::vector<uint64_t> dest;
+		philox4x32 r(seed,stream_trips);
+		for(uint64_t s=0;s<nstops;s++) {
+			r.set(seed,stream_trips + s);
+			double trips = stop_trips * exp(sigma*normal(r) - 0.5*sigma*sigma);
+			dest.clear();
+			for(unsigned int k=0;k<ndest;k++) for(unsigned int tries=0;tries<10;tries++) {
+				double d = dist(r);
+				double a = 2.0 * M_PI * uniform(r);
+				double dx = sx[s] + d*cos(a);
+				double dy = sy[s] + d*sin(a);
+				double gx = round(dx / spacing + 0.5*(w-1));
+				double gy = round(dy / spacing + 0.5*(h-1));
+				if(gx < 0.0 || gy < 0.0 || gx >= w || gy >= h) continue;
+				uint64_t s2 = ((uint64_t)gy / stop_step) * sw + (uint64_t)gx / stop_step;
+				if(s2 == s) continue;
+				dest.push_back(s2);
+				break;
+			}
+			if(dest.empty()) continue;
+			std::sort(dest.begin(),dest.end());
+			for(size_t k=0;k<dest.size();) {
+				size_t k2 = k;
+				for(;k2<dest.size() && dest[k2] == dest[k];k2++);
+				double pair_trips = trips * (k2 - k) / dest.size();
+				for(unsigned int hr=0;hr<24;hr++) {
+					double m = pair_trips * hour_profile[hr] / total_profile;
+					unsigned int cnt = std::poisson_distribution<unsigned int>(m)(r);
+					unsigned int cnt2 = std::poisson_distribution<unsigned int>(m * weekend_factor)(r);
+					if(cnt) {
+						out.write_row(hr,first_stop_code + s,first_stop_code + dest[k],cnt);
+						ntrips += cnt;
+						nrecords++;
+					}
+					if(raw_od) {
+						if(cnt) out_raw.write_row("2019-01","WEEKDAY",hr,"BUS",first_stop_code + s,first_stop_code + dest[k],cnt);
+						if(cnt2) out_raw.write_row("2019-01","WEEKENDS/HOLIDAY",hr,"BUS",first_stop_code + s,first_stop_code + dest[k],cnt2);
+					}
+				}
+				k = k2;
+			}
+		}
+		stats.add_bytes("output buffers",out.memory_usage() + out_raw.memory_usage());
+		if(!out.close() || (raw_od && !out_raw.close())) {
+			fprintf(stderr,"Error writing the trips!\n");
+			return 1;
+		}
+	}
+	stats.report("generating the buildings and trips");
+	
+	fprintf(stderr,"%u nodes (%lu x %lu), %lu edges, %lu bus stops, %lu buildings, %lu trips (%lu records)\n",
+		n,w,h,nedges,nstops,nbuildings,ntrips,nrecords);
+	return 0;
+}
+
@@ -0,0 +1,166 @@
+/*  -*- C++ -*-
+ * trip_inputs.h -- options and reading of the inputs shared by the
+ * 	programs working on generated or bike trips (shareability, min_fleet
+ * 	and fleet_sim)
+ * 
+ * trips are read from a store created by bike_store or a TSV file in the
+ * bike trip format (-i, stdin if not given, see bike_trips.h); distances
+ * among their nodes are read from a matrix (-d with the IDs in -I), a list
+ * of distances (-d) or calculated from the road network (--edges), either
+ * all at once or on demand with a cache of rows of the given size in MB
+ * (--dist-cache, see distances.h); --timing reports the time spent in
+ * each stage
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+
+#ifndef TRIP_INPUTS_H
+#define TRIP_INPUTS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <utility>
+#include "read_table.h"
+#include "network.h"
+#include "distances.h"
+#include "bike_trips.h"
+
+
+struct trip_inputs {
+	const char* trips_fn; /* trips (stdin if not given) */
+	const char* dists_fn; /* distances: list or matrix */
+	const char* dists_ids_fn; /* IDs for the distance matrix */
+	const char* edges_fn; /* road network to calculate the distances */
+	size_t cache_size; /* if > 0, distances are calculated on demand with a cache of this size */
+	bool timing; /* report the time spent in each stage */
+	
+	trip_inputs():trips_fn(0),dists_fn(0),dists_ids_fn(0),edges_fn(0),cache_size(0),timing(false) { }
+	
+	/* parse one of the options above in argv[i] (advancing i past its
+	 * value); all options starting with "--" are handled here (unknown ones
+	 * are reported); returns false if argv[i] is not one of these */
+	bool parse_option(char** argv, int& i) {
+		if(argv[i][0] != '-') return false;
+		if(argv[i][1] == '-') {
+			if(!strcmp(argv[i],"--edges")) {
+				edges_fn = argv[i+1];
+				i++;
+			}
+			else if(!strcmp(argv[i],"--dist-cache")) {
+				cache_size = (size_t)(atof(argv[i+1]) * 1048576.0);
+				i++;
+			}
+			else if(!strcmp(argv[i],"--timing")) timing = true;
+			else fprintf(stderr,"Unknown parameter: %s!\n",argv[i]);
+			return true;
+		}
+		switch(argv[i][1]) {
+			case 'i':
+				trips_fn = argv[i+1];
+				break;
+			case 'd':
+				dists_fn = argv[i+1];
+				break;
+			case 'I':
+				dists_ids_fn = argv[i+1];
+				break;
+			default:
+				return false;
+		}
+		i++;
+		return true;
+	}
+	
+	/* check that the distances are given in some way */
+	bool check() const {
+		if(!dists_fn && !edges_fn) {
+			fprintf(stderr,"Error: no distances or road network given!\n");
+			return false;
+		}
+		return true;
+	}
+	
+	/* read the trips (from a store or a TSV file); at most max_trips - 1
+	 * trips are allowed */
+	bool read_trips(unsigned int nthreads, size_t max_trips, std::vector<bike_trip>& trips) const {
+		if(trips_fn && bike_trips_store::is_store(trips_fn)) {
+			bike_trips_store st;
+			if(!st.open(trips_fn)) return false;
+			st.read(trips);
+		}
+		else if(!read_bike_trips(trips_fn,stdin,nthreads,trips)) return false;
+		if(trips.size() >= max_trips) {
+			fprintf(stderr,"Error: too many trips!\n");
+			return false;
+		}
+		fprintf(stderr,"%lu trips read\n",trips.size());
+		return true;
+	}
+	
+	/* read or calculate the distances among the nodes of the trips; when
+	 * calculated from the network, only the nodes of the trips are used as
+	 * sources and targets; all nodes have to be found */
+	bool read_dists(const std::vector<bike_trip>& trips, unsigned int nthreads, distances& dists) const {
+		if(dists_ids_fn) {
+			if(!dists.open_dists(dists_fn,dists_ids_fn)) return false;
+		}
+		else if(dists_fn) {
+			if(!dists.read_dists(read_table_parallel(dists_fn,0,nthreads))) return false;
+		}
+		else {
+			network net;
+			if(!net.read_edges(edges_fn,0,nthreads)) return false;
+			net.freeze();
+			std::vector<uint64_t> nids;
+			nids.reserve(2*trips.size());
+			for(const bike_trip& t : trips) {
+				nids.push_back(t.start_node);
+				nids.push_back(t.end_node);
+			}
+			if(cache_size) {
+				if(!dists.open_network(std::move(net),nids,0.0,cache_size,0)) return false;
+			}
+			else if(!dists.compute_dists(net,nids,nthreads)) return false;
+		}
+		for(const bike_trip& t : trips) if(!dists.has_node(t.start_node) || !dists.has_node(t.end_node)) {
+			fprintf(stderr,"Error: nodes of trip %lu not found among the distances!\n",t.trip_id);
+			return false;
+		}
+		return true;
+	}
+};
+
+#endif
+
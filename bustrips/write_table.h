@@ -0,0 +1,373 @@
+/*  -*- C++ -*-
+ * write_table.h -- fast buffered output of numeric data as text tables,
+ * 	the counterpart of read_table.h
+ * 
+ * numbers are formatted directly into a large buffer instead of calling
+ * fprintf() for each row; the result is the same as with the "%lu" / "%ld"
+ * (or "%u" / "%d") and "%f" formats, i.e. doubles are written with six
+ * digits after the decimal point, rounded exactly as printf() does (round
+ * to nearest, ties to even, using the exact binary value); numbers that
+ * are very large in magnitude, infinities and NaNs are given to snprintf()
+ * 
+ * the output buffer can be written in a background thread, overlapping
+ * formatting with the actual writing (only useful for large outputs)
+ * 
+ * requires C++11 and a compiler with support for 128-bit integers
+ * (GCC or clang on 64-bit platforms); assumes that the "C" locale and the
+ * default rounding mode are used
+ * 
+ * Copyright 2026 Daniel Kondor <kondor.dani@gmail.com>
+ * 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ * * Neither the name of the  nor the names of its
+ *   contributors may be used to endorse or promote products derived from
+ *   this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * 
+ */
+
+#ifndef WRITE_TABLE_H
+#define WRITE_TABLE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* default size of the output buffer */
+#define WRITE_TABLE_BUFFER_SIZE 4194304UL
+
+
+/* two-digit pairs used for formatting integers */
+static const char write_table_digits[201] =
+	"0001020304050607080910111213141516171819"
+	"2021222324252627282930313233343536373839"
+	"4041424344454647484950515253545556575859"
+	"6061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+/* write the decimal digits of x to p, return the end of the output
+ * (no terminating zero is written) */
+static inline char* write_table_format_uint(char* p, uint64_t x) {
+	char tmp[20];
+	char* end = tmp + 20;
+	char* c = end;
+	while(x >= 100) {
+		unsigned int i = 2*(unsigned int)(x % 100);
+		x /= 100;
+		*(--c) = write_table_digits[i+1];
+		*(--c) = write_table_digits[i];
+	}
+	if(x >= 10) {
+		unsigned int i = 2*(unsigned int)x;
+		*(--c) = write_table_digits[i+1];
+		*(--c) = write_table_digits[i];
+	}
+	else *(--c) = '0' + (char)x;
+	memcpy(p,c,end-c);
+	return p + (end-c);
+}
+
+static inline char* write_table_format_int(char* p, int64_t x) {
+	if(x < 0) {
+		*p = '-';
+		return write_table_format_uint(p+1,-(uint64_t)x);
+	}
+	return write_table_format_uint(p,(uint64_t)x);
+}
+
+/* write x in the same format as printf("%f") would; numbers up to 2^64
+ * in magnitude are converted exactly, by computing the rounded value of
+ * x * 10^6 as an integer, others are given to snprintf() */
+static inline char* write_table_format_double(char* p, double x) {
+	uint64_t bits;
+	memcpy(&bits,&x,sizeof(double));
+	unsigned int be = (unsigned int)(bits >> 52) & 0x7ffU;
+	uint64_t m = bits & ((1ULL << 52) - 1ULL);
+	int e = (int)be - 1075;
+	if(be == 0) e = -1074; /* subnormal */
+	else m |= (1ULL << 52);
+	/* x = m * 2^e */
+	if(be == 0x7ffU || e > 11) return p + sprintf(p,"%f",x);
+	
+	uint64_t ip; /* integer part */
+	uint32_t fp = 0; /* fractional part * 10^6 */
+	if(e >= 0) ip = m << e;
+	else {
+		__uint128_t y = (__uint128_t)m * 1000000U; /* < 2^73 */
+		__uint128_t q = 0;
+		unsigned int k = -e;
+		if(k < 75) {
+			q = y >> k;
+			__uint128_t rem = y - (q << k);
+			__uint128_t half = ((__uint128_t)1) << (k-1);
+			if(rem > half || (rem == half && (q & 1U))) q++;
+		}
+		/* else y < 2^(k-1), so x * 10^6 rounds to zero */
+		ip = (uint64_t)(q / 1000000U);
+		fp = (uint32_t)(q % 1000000U);
+	}
+	if(bits >> 63) *(p++) = '-';
+	p = write_table_format_uint(p,ip);
+	*(p++) = '.';
+	for(int i=4;i>=0;i-=2) {
+		unsigned int j = 2*(fp % 100);
+		fp /= 100;
+		p[i+1] = write_table_digits[j+1];
+		p[i] = write_table_digits[j];
+	}
+	return p + 6;
+}
+
+
+/* maximum length of a field (used to reserve space in the buffer) */
+static inline size_t write_table_max_len(double x) {
+	/* "%f" of DBL_MAX has 309 digits before the decimal point */
+	return (x < 1e19 && x > -1e19) ? 28 : 320;
+}
+static inline size_t write_table_max_len(const char* str) { return strlen(str); }
+static inline size_t write_table_max_len(const std::string& str) { return str.size(); }
+template<class T>
+static inline typename std::enable_if<std::is_integral<T>::value, size_t>::type
+write_table_max_len(T) { return 21; }
+
+/* format one field at p, return the end of the output */
+static inline char* write_table_format(char* p, double x) { return write_table_format_double(p,x); }
+static inline char* write_table_format(char* p, const char* str) {
+	size_t len = strlen(str);
+	memcpy(p,str,len);
+	return p + len;
+}
+static inline char* write_table_format(char* p, const std::string& str) {
+	memcpy(p,str.data(),str.size());
+	return p + str.size();
+}
+template<class T>
+static inline typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, char*>::type
+write_table_format(char* p, T x) { return write_table_format_int(p,x); }
+template<class T>
+static inline typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value, char*>::type
+write_table_format(char* p, T x) { return write_table_format_uint(p,x); }
+
+
+/* space needed to format a row with the given fields (including the
+ * delimiters and the newline) */
+template<class T>
+static inline size_t write_table_row_len(const T& x) { return write_table_max_len(x) + 1; }
+template<class T, class... Ts>
+static inline size_t write_table_row_len(const T& x, const Ts&... rest) {
+	return write_table_max_len(x) + 1 + write_table_row_len(rest...);
+}
+
+/* format a row at p, separating fields by delim and terminating it with
+ * a newline; p should have at least write_table_row_len() space;
+ * returns the end of the output */
+template<class T>
+static inline char* write_table_row(char* p, char, const T& x) {
+	p = write_table_format(p,x);
+	*(p++) = '\n';
+	return p;
+}
+template<class T, class... Ts>
+static inline char* write_table_row(char* p, char delim, const T& x, const Ts&... rest) {
+	p = write_table_format(p,x);
+	*(p++) = delim;
+	return write_table_row(p,delim,rest...);
+}
+
+/* format a row and append it to a string */
+template<class... Ts>
+static inline void write_table_append(std::string& out, char delim, const Ts&... vals) {
+	size_t len = out.size();
+	out.resize(len + write_table_row_len(vals...));
+	char* p = &out[len];
+	char* end = write_table_row(p,delim,vals...);
+	out.resize(len + (end - p));
+}
+
+
+/* buffered writer of text tables; usage:
+
+write_table w(stdout); // or write_table w(fn); -- optionally use a writer thread:
+	// write_table w(stdout,true);
+w.set_delim(','); // default delimiter is a tab
+for(...) w.write_row(id1,id2,d); // same as fprintf(f,"%lu,%lu,%f\n",id1,id2,d);
+if(!w.close()) { // handle error
+	fprintf(stderr,"Error writing output!\n");
+}
+
+ * binary data can be also written with write_data()
+ * the output file is not closed if it was given by the caller (only flushed) */
+struct write_table {
+	protected:
+		FILE* f;
+		bool own_file; /* true if f was opened by us */
+		bool err;
+		char delim;
+		std::vector<char> buf;
+		size_t pos;
+		
+		/* writer thread: it writes out pending, while the next part of the
+		 * output is collected in buf */
+		std::thread writer;
+		std::mutex m;
+		std::condition_variable cv;
+		std::vector<char> pending;
+		size_t pending_len;
+		bool has_pending;
+		bool stop;
+		bool write_err; /* error in the writer thread */
+		
+		void writer_thread() {
+			std::unique_lock<std::mutex> lock(m);
+			while(true) {
+				while(!has_pending && !stop) cv.wait(lock);
+				if(!has_pending) break;
+				lock.unlock();
+				bool res = (fwrite(pending.data(),1,pending_len,f) == pending_len);
+				lock.lock();
+				if(!res) write_err = true;
+				has_pending = false;
+				cv.notify_all();
+			}
+		}
+		
+		void init(bool use_thread, size_t buf_size) {
+			buf.resize(buf_size);
+			if(f && use_thread) {
+				pending.resize(buf_size);
+				writer = std::thread(&write_table::writer_thread,this);
+			}
+		}
+		
+		/* write out the contents of the buffer */
+		bool write_buffer() {
+			if(!pos) return !err;
+			if(writer.joinable()) {
+				std::unique_lock<std::mutex> lock(m);
+				while(has_pending) cv.wait(lock);
+				if(write_err) err = true;
+				if(pending.size() < buf.size()) pending.resize(buf.size());
+				buf.swap(pending);
+				pending_len = pos;
+				has_pending = true;
+				cv.notify_all();
+			}
+			else if(fwrite(buf.data(),1,pos,f) != pos) err = true;
+			pos = 0;
+			return !err;
+		}
+		
+		/* make sure there is space for len more bytes in the buffer */
+		bool reserve(size_t len) {
+			if(!f || err) return false;
+			if(pos + len > buf.size()) {
+				if(!write_buffer()) return false;
+				if(len > buf.size()) buf.resize(len);
+			}
+			return true;
+		}
+	
+	public:
+		explicit write_table(FILE* f_, bool use_thread = false, size_t buf_size = WRITE_TABLE_BUFFER_SIZE):
+			f(f_),own_file(false),err(f_ == 0),delim('\t'),pos(0),pending_len(0),has_pending(false),stop(false),write_err(false) {
+			init(use_thread,buf_size);
+		}
+		explicit write_table(const char* fn, bool use_thread = false, size_t buf_size = WRITE_TABLE_BUFFER_SIZE):
+			f(fopen(fn,"w")),own_file(true),err(false),delim('\t'),pos(0),pending_len(0),has_pending(false),stop(false),write_err(false) {
+			err = (f == 0);
+			init(use_thread,buf_size);
+		}
+		/* open the given file or use f_ if fn == 0 */
+		write_table(const char* fn, FILE* f_, bool use_thread = false, size_t buf_size = WRITE_TABLE_BUFFER_SIZE):
+			f(fn ? fopen(fn,"w") : f_),own_file(fn != 0),err(false),delim('\t'),pos(0),pending_len(0),has_pending(false),stop(false),write_err(false) {
+			err = (f == 0);
+			init(use_thread,buf_size);
+		}
+		~write_table() { close(); }
+		
+		void set_delim(char delim_) { delim = delim_; }
+		char get_delim() const { return delim; }
+		/* true if there was an error opening or writing the output */
+		bool error() const { return err; }
+		/* memory allocated for the buffers */
+		size_t memory_usage() const { return buf.capacity() + pending.capacity(); }
+		
+		/* write one row (with the fields separated by the delimiter) */
+		template<class... Ts>
+		bool write_row(const Ts&... vals) {
+			if(!reserve(write_table_row_len(vals...))) return false;
+			pos = write_table_row(buf.data() + pos,delim,vals...) - buf.data();
+			return true;
+		}
+		
+		/* write raw data */
+		bool write_data(const void* data, size_t len) {
+			if(!reserve(len)) return false;
+			memcpy(buf.data() + pos,data,len);
+			pos += len;
+			return true;
+		}
+		
+		/* write out all data in the buffer and flush the output file */
+		bool flush() {
+			if(!f) return false;
+			write_buffer();
+			if(writer.joinable()) {
+				std::unique_lock<std::mutex> lock(m);
+				while(has_pending) cv.wait(lock);
+				if(write_err) err = true;
+			}
+			if(fflush(f)) err = true;
+			return !err;
+		}
+		
+		/* flush all output, stop the writer thread and close the output file
+		 * if it was opened by us; returns false if there was any error */
+		bool close() {
+			if(!f) return !err;
+			flush();
+			if(writer.joinable()) {
+				{
+					std::unique_lock<std::mutex> lock(m);
+					stop = true;
+					cv.notify_all();
+				}
+				writer.join();
+			}
+			if(own_file && fclose(f)) err = true;
+			f = 0;
+			return !err;
+		}
+};
+
+#endif
+